@@ -32,7 +32,10 @@ fh_print_help()
          "  -h, --help          print this help text\n"
          "  -i, --interactive   force REPL\n"
          "  -n, --nodes         print the AST\n"
-         "  -t, --tokens        print tokens\n");
+         "  -t, --tokens        print tokens\n"
+         "  -m, --max-heap MB   limit the heap to MB megabytes\n"
+         "  -s, --gc-step-us US limit incremental GC steps to US microseconds\n"
+         "                      (default 1000, 0 collects all at once)\n");
 }
 
 void
@@ -0,0 +1,478 @@
+/*
+ * compile.c -- Bytecode compiler
+ *
+ * Copyright (c) 2012-2017 Nick Reynolds
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "vm.h"
+
+/* The compiler follows the AST walker node for node, down to the order in
+ * which operands are evaluated, and leaves anything it doesn't know to it.
+ */
+
+typedef struct {
+  js_code *code;
+  int depth;                          // of the operand stack, so far
+  int loop;                           // the innermost loop, or -1
+} compiler;
+
+#define FH_OPCODE_EFFECT(op, effect) effect,
+
+static const int effects[] = {
+  FH_OPCODES(FH_OPCODE_EFFECT)
+};
+
+static void compile_exp(compiler *, ast_node *);
+static void compile_stmt(compiler *, ast_node *);
+
+
+// ----------------------------------------------------------------------------
+// Emitting Instructions
+// ----------------------------------------------------------------------------
+
+static int
+emit(compiler *c, js_opcode op, int arg, ast_node *node)
+{
+  js_code *code = c->code;
+  if (code->count == code->cap) {
+    code->cap *= 2;
+    code->instrs = realloc(code->instrs, code->cap * sizeof(js_instr));
+  }
+  code->instrs[code->count] = (js_instr){op, arg, node};
+
+  c->depth += op == OP_CALL ? -arg : effects[op];
+  if (c->depth > (int)code->max_depth) code->max_depth = c->depth;
+  return code->count++;
+}
+
+static int
+here(compiler *c)
+{
+  return c->code->count;
+}
+
+// Point a jump emitted earlier at the next instruction.
+static void
+patch(compiler *c, int jump)
+{
+  c->code->instrs[jump].arg = here(c);
+}
+
+static int
+new_loop(compiler *c)
+{
+  js_code *code = c->code;
+  code->loops = realloc(code->loops, (code->num_loops + 1) * sizeof(js_loop));
+  return code->num_loops++;
+}
+
+static void
+each_item(compiler *c, ast_node *list, void (*compile)(compiler *, ast_node *))
+{
+  unsigned i;
+  for (i = 0; i < list->count; i++) compile(c, list->items[i]);
+}
+
+
+// ----------------------------------------------------------------------------
+// Expressions
+// ----------------------------------------------------------------------------
+
+static void
+compile_fallback(compiler *c, ast_node *node)
+{
+  emit(c, OP_EVAL, 0, node);
+}
+
+static js_opcode
+binary_opcode(enum ast_op op)
+{
+  switch (op) {
+    case OPR_ADD:       return OP_ADD;
+    case OPR_SUB:       return OP_SUB;
+    case OPR_MUL:       return OP_MUL;
+    case OPR_DIV:       return OP_DIV;
+    case OPR_MOD:       return OP_MOD;
+    case OPR_LT:        return OP_LT;
+    case OPR_GT:        return OP_GT;
+    case OPR_LE:        return OP_LE;
+    case OPR_GE:        return OP_GE;
+    case OPR_EQ:        return OP_EQ;
+    case OPR_NE:        return OP_NE;
+    case OPR_STRICT_EQ: return OP_STRICT_EQ;
+    case OPR_STRICT_NE: return OP_STRICT_NE;
+    default:            return OP_BINARY;
+  }
+}
+
+static void
+compile_binary(compiler *c, ast_node *node)
+{
+  // Logical operators short-circuit, leaving the deciding operand.
+  if (node->op == OPR_AND || node->op == OPR_OR) {
+    compile_exp(c, node->e1);
+    int jump = emit(c, node->op == OPR_AND ? OP_AND : OP_OR, 0, node);
+    compile_exp(c, node->e2);
+    patch(c, jump);
+    return;
+  }
+
+  compile_exp(c, node->e1);
+  compile_exp(c, node->e2);
+  emit(c, binary_opcode(node->op), 0, node);
+}
+
+static void
+compile_unary(compiler *c, ast_node *node)
+{
+  enum ast_op op = node->op;
+
+  // Increments and decrements of a variable; those of a member are left to
+  // the AST walker.
+  if (op == OPR_INC || op == OPR_DEC) {
+    if (node->e1->type != NODE_IDENT) {
+      compile_fallback(c, node);
+      return;
+    }
+    int prefix = node->sub_type == NODE_UNARY_PRE;
+    emit(c, OP_INC_VAR, prefix | (op == OPR_DEC) << 1, node);
+    return;
+  }
+
+  if (node->sub_type != NODE_UNARY_PRE ||
+      !(op == OPR_NOT || op == OPR_PLUS || op == OPR_NEG || op == OPR_BIT_NOT)) {
+    compile_fallback(c, node);
+    return;
+  }
+
+  compile_exp(c, node->e1);
+  emit(c, op == OPR_NOT ? OP_NOT : OP_UNARY, 0, node);
+}
+
+static void
+compile_member(compiler *c, ast_node *node)
+{
+  if (!node->val && node->e1->type != NODE_IDENT) {
+    compile_fallback(c, node);
+    return;
+  }
+
+  compile_exp(c, node->e2);
+  if (!node->val)
+    emit(c, OP_GET_NAMED, 0, node);
+  else {
+    compile_exp(c, node->e1);
+    emit(c, OP_GET_MEMBER, 0, node);
+  }
+}
+
+static void
+compile_assign(compiler *c, ast_node *node)
+{
+  ast_node *lhs = node->e1;
+
+  // Comma expressions are parsed as assignments too.
+  if (node->op == OPR_COMMA) {
+    compile_exp(c, node->e1);
+    emit(c, OP_POP, 0, node);
+    compile_exp(c, node->e2);
+    return;
+  }
+
+  bool member = lhs->type == NODE_MEMBER &&
+    (lhs->val || lhs->e1->type == NODE_IDENT);
+  if (!(member || lhs->type == NODE_IDENT)) {
+    compile_fallback(c, node);
+    return;
+  }
+
+  // The value is evaluated before the reference it's assigned to.
+  compile_exp(c, node->e2);
+  if (member) {
+    // `o.x = v` keeps its name in the node, rather than pushing a new string.
+    compile_exp(c, lhs->e2);
+    if (lhs->val) {
+      compile_exp(c, lhs->e1);
+      emit(c, OP_PUT_MEMBER, 0, node);
+    }
+    else
+      emit(c, OP_PUT_NAMED, 0, node);
+  }
+  else if (node->op == OPR_ASSIGN)
+    emit(c, OP_SET_VAR, 0, lhs);
+  else
+    emit(c, OP_ASSIGN_VAR, 0, node);
+}
+
+static void
+compile_call(compiler *c, ast_node *node)
+{
+  // `f(x).y` and `f(x)[y]` are parsed as calls too.
+  if (node->e2->type != NODE_ARG_LST) {
+    compile_fallback(c, node);
+    return;
+  }
+
+  compile_exp(c, node->e1);
+  emit(c, OP_CALLEE, 0, node);
+  each_item(c, node->e2, compile_exp);
+  emit(c, OP_CALL, node->e2->count, node);
+}
+
+static void
+compile_cond(compiler *c, ast_node *node)
+{
+  compile_exp(c, node->e1);
+  int jump_else = emit(c, OP_JUMP_IF_FALSE, 0, node);
+  compile_exp(c, node->e2);
+  int jump_end = emit(c, OP_JUMP, 0, node);
+  c->depth--;
+  patch(c, jump_else);
+  compile_exp(c, node->e3);
+  patch(c, jump_end);
+}
+
+static void
+compile_exp(compiler *c, ast_node *node)
+{
+  if (!node) {
+    emit(c, OP_UNDEF, 0, node);
+    return;
+  }
+
+  switch (node->type) {
+    case NODE_BOOL:     emit(c, OP_BOOL, 0, node); break;
+    case NODE_STR:      emit(c, OP_STR, 0, node); break;
+    case NODE_NUM:      emit(c, OP_NUM, 0, node); break;
+    case NODE_NULL:     emit(c, OP_NULL, 0, node); break;
+    case NODE_FUNC:     emit(c, OP_FUNC, 0, node); break;
+    case NODE_IDENT:    emit(c, OP_GET_VAR, 0, node); break;
+    case NODE_MEMBER:   compile_member(c, node); break;
+    case NODE_ASGN:     compile_assign(c, node); break;
+    case NODE_CALL:     compile_call(c, node); break;
+    case NODE_TERN:     compile_cond(c, node); break;
+    case NODE_EXP:
+      if (node->sub_type == NODE_UNARY_PRE || node->sub_type == NODE_UNARY_POST)
+        compile_unary(c, node);
+      else
+        compile_binary(c, node);
+      break;
+    default:            compile_fallback(c, node);
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Statements
+// ----------------------------------------------------------------------------
+
+static void
+compile_exec(compiler *c, ast_node *node)
+{
+  emit(c, OP_EXEC, c->loop, node);
+}
+
+static void
+compile_undef_result(compiler *c)
+{
+  emit(c, OP_UNDEF, 0, NULL);
+  emit(c, OP_RESULT, 0, NULL);
+}
+
+// Declarations have been hoisted by the time their list is compiled, which
+// leaves their initializers as assignments.
+static void
+compile_var(compiler *c, ast_node *node)
+{
+  if (node->type != NODE_VAR_DEC) {
+    compile_fallback(c, node);
+    emit(c, OP_POP, 0, node);
+  }
+  else if (node->e2) {
+    compile_exp(c, node->e2);
+    emit(c, OP_SET_VAR, 0, node->e1);
+    emit(c, OP_POP, 0, node);
+  }
+}
+
+static void
+compile_vars(compiler *c, ast_node *node)
+{
+  if (node->type == NODE_VAR_DEC_LST)
+    each_item(c, node, compile_var);
+  else
+    compile_var(c, node);
+}
+
+static void
+compile_if(compiler *c, ast_node *node)
+{
+  compile_exp(c, node->e1);
+  int jump_else = emit(c, OP_JUMP_IF_FALSE, 0, node);
+  compile_stmt(c, node->e2);
+  int jump_end = emit(c, OP_JUMP, 0, node);
+  patch(c, jump_else);
+  if (node->e3)
+    compile_stmt(c, node->e3);
+  else
+    compile_undef_result(c);
+  patch(c, jump_end);
+}
+
+// Compile a loop's body, with break and continue bound to the loop.
+static void
+compile_body(compiler *c, ast_node *body, int loop)
+{
+  int outer = c->loop;
+  c->loop = loop;
+  compile_stmt(c, body);
+  c->loop = outer;
+}
+
+static void
+compile_while(compiler *c, ast_node *node)
+{
+  int loop = new_loop(c);
+  compile_undef_result(c);
+
+  int top = here(c);
+  compile_exp(c, node->e1);
+  int jump_end = emit(c, OP_JUMP_IF_FALSE, 0, node);
+  compile_body(c, node->e2, loop);
+  emit(c, OP_JUMP, top, node);
+  patch(c, jump_end);
+
+  c->code->loops[loop] = (js_loop){here(c), top};
+}
+
+static void
+compile_for(compiler *c, ast_node *node)
+{
+  ast_node *exp_grp = node->e1;
+  int loop = new_loop(c), jump_end = -1;
+
+  if (exp_grp->e1) {
+    enum ast_node_type type = exp_grp->e1->type;
+    if (type == NODE_VAR_DEC_LST || type == NODE_VAR_DEC)
+      compile_vars(c, exp_grp->e1);
+    else {
+      compile_exp(c, exp_grp->e1);
+      emit(c, OP_POP, 0, node);
+    }
+  }
+  compile_undef_result(c);
+
+  int top = here(c);
+  if (exp_grp->e2) {
+    compile_exp(c, exp_grp->e2);
+    jump_end = emit(c, OP_JUMP_IF_FALSE, 0, node);
+  }
+  compile_body(c, node->e2, loop);
+
+  int next = here(c);
+  if (exp_grp->e3) {
+    compile_exp(c, exp_grp->e3);
+    emit(c, OP_POP, 0, node);
+  }
+  emit(c, OP_JUMP, top, node);
+  if (jump_end >= 0) patch(c, jump_end);
+
+  c->code->loops[loop] = (js_loop){here(c), next};
+}
+
+// Whether a node is an expression compile_exp handles itself.
+static bool
+compiled_exp(ast_node *node)
+{
+  switch (node->type) {
+    case NODE_BOOL: case NODE_STR: case NODE_NUM: case NODE_NULL:
+    case NODE_FUNC: case NODE_IDENT: case NODE_MEMBER: case NODE_ASGN:
+    case NODE_CALL: case NODE_TERN: case NODE_EXP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void
+compile_stmt(compiler *c, ast_node *node)
+{
+  if (!node) {
+    compile_undef_result(c);
+    return;
+  }
+
+  switch (node->type) {
+    case NODE_SRC_LST:
+    case NODE_STMT_LST:
+      if (!node->count)
+        compile_undef_result(c);
+      each_item(c, node, compile_stmt);
+      break;
+    case NODE_BLOCK:
+      compile_stmt(c, node->e1);
+      break;
+    case NODE_EXP_STMT:
+      compile_exp(c, node->e1);
+      emit(c, OP_RESULT, 0, node);
+      break;
+    case NODE_VAR_STMT:
+      compile_vars(c, node->e1);
+      compile_undef_result(c);
+      break;
+    case NODE_EMPT_STMT:
+      compile_undef_result(c);
+      break;
+    case NODE_IF:       compile_if(c, node); break;
+    case NODE_WHILE:    compile_while(c, node); break;
+    case NODE_FOR:      compile_for(c, node); break;
+    case NODE_RETURN:
+      compile_exp(c, node->e1);
+      emit(c, OP_RETURN, 0, node);
+      break;
+    case NODE_BREAK:
+    case NODE_CONT:
+      if (c->loop < 0)
+        compile_exec(c, node);
+      else
+        emit(c, node->type == NODE_BREAK ? OP_BREAK : OP_CONTINUE, c->loop, node);
+      break;
+    default:
+      if (compiled_exp(node)) {
+        compile_exp(c, node);
+        emit(c, OP_RESULT, 0, node);
+      }
+      else
+        compile_exec(c, node);
+  }
+}
+
+/* Compile a source list: a program or a function's body. */
+js_code *
+fh_compile(ast_node *node)
+{
+  js_code *code = malloc(sizeof(js_code));
+  code->cap = 16;
+  code->count = 0;
+  code->instrs = malloc(code->cap * sizeof(js_instr));
+  code->loops = NULL;
+  code->num_loops = 0;
+  code->max_depth = 0;
+
+  compiler c = {code, 0, -1};
+  compile_stmt(&c, node);
+  emit(&c, OP_END, 0, node);
+  return code;
+}
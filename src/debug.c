@@ -64,23 +64,23 @@ debug_arr(FILE *stream, js_val *arr, int indent)
   fprintf(stream, "[ ");
 
   bool first = true;
-  js_prop *prop;
+  js_val *val;
   unsigned long i;
 
   for (i = 0; i < arr->object.length; i++) {
-    prop = fh_get_prop(arr, JSNUMKEY(i)->string.ptr);
+    val = fh_get_elem(arr, i);
 
     if (!first)
       fprintf(stream, ", ");
     else
       first = false;
 
-    if (!prop) continue;
+    if (!val) continue;
 
-    if (prop->circular)
+    if (val == arr)
       cfprintf(stream, ANSI_BLUE, "[Circular]");
     else
-      fh_debug(stream, prop->ptr, 0, false);
+      fh_debug(stream, val, 0, false);
   }
 
   fprintf(stream, " ]");
@@ -89,26 +89,26 @@ debug_arr(FILE *stream, js_val *arr, int indent)
 static void
 debug_num(FILE *stream, js_val *num)
 {
-  if (num->number.is_nan)
+  if (IS_NAN(num))
     cfprintf(stream, ANSI_ORANGE, "NaN");
-  else if (num->number.is_inf)
-    cfprintf(stream, ANSI_ORANGE, "%sInfinity", num->number.is_neg ? "-" : "");
+  else if (IS_INF(num))
+    cfprintf(stream, ANSI_ORANGE, "%sInfinity", NUMVAL(num) < 0 ? "-" : "");
   else {
     char *fmt = "%f";
-    if (fmod(num->number.val, 1) == 0)
+    if (fmod(NUMVAL(num), 1) == 0)
       fmt = "%.0f";
-    if (fabs(num->number.val) > 1e21)
+    if (fabs(NUMVAL(num)) > 1e21)
       fmt = "%g";
-    cfprintf(stream, ANSI_ORANGE, fmt, num->number.val);
+    cfprintf(stream, ANSI_ORANGE, fmt, NUMVAL(num));
   }
 }
 
 void
 fh_debug(FILE *stream, js_val *val, int indent, bool newline)
 {
-  switch (val->type) {
+  switch (fh_type(val)) {
     case T_BOOLEAN:
-      fprintf(stream, "%s", !val->boolean.val ? "false" : "true");
+      fprintf(stream, "%s", !BOOLVAL(val) ? "false" : "true");
       break;
     case T_NUMBER:
       debug_num(stream, val);
@@ -131,7 +131,7 @@ fh_debug(FILE *stream, js_val *val, int indent, bool newline)
       else if (IS_FUNC(val))
         cfprintf(stream, ANSI_BLUE, "[Function]");
       else if (IS_DATE(val))
-        fprintf(stream, "[Date %ld]", (long)val->object.primitive->number.val);
+        fprintf(stream, "[Date %ld]", (long)NUMVAL(val->object.primitive));
       else
         debug_obj(stream, val, indent, false);
       break;
@@ -143,9 +143,9 @@ fh_debug(FILE *stream, js_val *val, int indent, bool newline)
 void
 fh_debug_verbose(FILE *stream, js_val *val, int indent)
 {
-  switch (val->type) {
+  switch (fh_type(val)) {
     case T_BOOLEAN:
-      fprintf(stream, "Boolean: (%s)", !val->boolean.val ? "false" : "true");
+      fprintf(stream, "Boolean: (%s)", !BOOLVAL(val) ? "false" : "true");
       break;
     case T_NUMBER:
       debug_num(stream, val);
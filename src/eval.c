@@ -24,6 +24,8 @@
 #include "nodes.h"
 #include "str.h"
 #include "gc.h"
+#include "vm.h"
+#include "frame.h"
 
 
 // ----------------------------------------------------------------------------
@@ -34,8 +36,8 @@ static js_val *
 eval_each(js_val *ctx, ast_node *node)
 {
   js_val *result = JSUNDEF();
-  node_rewind(node);
-  while (!node->visited) result = fh_eval(ctx, node_pop(node));
+  unsigned i;
+  for (i = 0; i < node->count; i++) result = fh_eval(ctx, node->items[i]);
   return result;
 }
 
@@ -68,40 +70,75 @@ member_parent(js_val *ctx, ast_node *member)
 }
 
 static js_val *
-member_child(js_val *ctx, ast_node *member)
+member_key(js_val *ctx, ast_node *member)
 {
   // In `x.foo` we'll take 'foo' literally, in `x[foo]` we need to eval 'foo'.
   // This distinction is stored as 0/1 in the val slot.
   return member->val ?
-    TO_STR(fh_eval(ctx, member->e1)) :
+    fh_eval(ctx, member->e1) :
     str_from_node(ctx, member->e1);
 }
 
+static js_val *
+member_child(js_val *ctx, ast_node *member)
+{
+  return TO_STR(member_key(ctx, member));
+}
+
+// Whether a key is a number that's also an array index.
+static bool
+key_index(js_val *key, unsigned long *index)
+{
+  if (!IS_NUM(key)) return false;
+  double d = NUMVAL(key);
+  if (!(d >= 0 && d < ARRAY_INDEX_MAX) || d != (unsigned long)d) return false;
+  *index = d;
+  return true;
+}
+
+// Set an element, growing an array's length to fit.
+static void
+set_index(js_val *arr, unsigned long i, js_val *val)
+{
+  fh_set_index(arr, i, val);
+  if (IS_ARR(arr) && i >= arr->object.length)
+    fh_set_len(arr, i + 1);
+}
+
 static js_val *
 member_exp(js_val *ctx, ast_node *member)
 {
   js_val *parent = member_parent(ctx, member);
-  js_val *child_name = member_child(ctx, member);
-
-  // Handle array-like string character access.
-  if (IS_STR(parent) && member->e1->type == NODE_NUM) {
-    int i = member->e1->val, len = parent->string.length;
-    if (i < len && i >= 0) {
-      char *str = malloc(sizeof(char) + 1);
-      str[1] = '\0';
-      sprintf(str, "%c", parent->string.ptr[i]);
-      return JSSTR(str);
-    }
-    return JSUNDEF();
+
+  // `x.foo` goes through the node's inline cache.
+  if (!member->val && member->e1->type == NODE_IDENT)
+    return fh_get_proto_cached(parent, member->e1->sval, &member->ic);
+
+  return fh_get_member(parent, member_key(ctx, member));
+}
+
+/* Look up `parent[key]`, once both are evaluated. */
+js_val *
+fh_get_member(js_val *parent, js_val *key)
+{
+  // `x[i]` reads elements and string chars by number. Missing elements still
+  // go by name, since the prototype chain may have something there.
+  js_val *elem;
+  unsigned long i;
+  if (key_index(key, &i)) {
+    if (IS_STR(parent))
+      return fh_get_index(parent, i);
+    if ((elem = fh_get_elem(parent, i)))
+      return elem;
   }
 
-  return fh_get_proto(parent, child_name->string.ptr);
+  return fh_get_proto(parent, TO_STR(key)->string.ptr);
 }
 
 static js_val *
 ident(js_val *ctx, ast_node *id)
 {
-  js_prop *prop = fh_get_prop_rec(ctx, id->sval);
+  js_prop *prop = fh_get_local(ctx, id->sval, id->slot, &id->ic);
   if (!prop) {
     eval_state *state = fh_new_state(id->line, id->column);
     fh_push_state(state);
@@ -115,8 +152,13 @@ put(js_val *ctx, ast_node *ref, js_val *val)
 {
   char *key;
   if (ref->type == NODE_MEMBER) {
-    ctx = member_parent(ctx, ref);
-    key = member_child(ctx, ref)->string.ptr;
+    js_val *obj = member_parent(ctx, ref);
+    fh_put_member(obj, member_key(ctx, ref), val, OPR_ASSIGN);
+    return;
+  }
+  else if (ref->type == NODE_IDENT) {
+    fh_set_local(ctx, ref->sval, ref->slot, val, &ref->ic);
+    return;
   }
   else if (ref->sval)
     key = ref->sval;
@@ -134,107 +176,67 @@ put(js_val *ctx, ast_node *ref, js_val *val)
 static js_val *
 add_op(js_val *a, js_val *b)
 {
+  if (IS_NUM(a) && IS_NUM(b))
+    return JSNUM(NUMVAL(a) + NUMVAL(b));
+
   a = fh_to_primitive(a, T_NUMBER);
   b = fh_to_primitive(b, T_NUMBER);
 
   if (IS_STR(a) || IS_STR(b))
     return JSSTR(fh_str_concat(TO_STR(a)->string.ptr, TO_STR(b)->string.ptr));
 
-  if (!IS_NUM(a) || !IS_NUM(b))
-    return add_op(TO_NUM(a), TO_NUM(b));
-
-  if (IS_NAN(a) || IS_NAN(b))
-    return JSNAN();
-
-  if (IS_INF(a) && IS_INF(b)) {
-    if (a->number.is_neg != b->number.is_neg) return JSNAN();
-    if (a->number.is_neg) return JSNINF();
-    return JSINF();
-  }
-
-  if (IS_INF(a)) return a;
-  if (IS_INF(b)) return b;
-
-  return JSNUM(a->number.val + b->number.val);
+  double x = NUMVAL(TO_NUM(a));
+  return JSNUM(x + NUMVAL(TO_NUM(b)));
 }
 
+// Numbers are plain IEEE doubles, so NaN and the infinities take care of
+// themselves in the arithmetic below.
+
 static js_val *
 sub_op(js_val *a, js_val *b)
 {
-  // a - b  <==>  a + (-b)
-  return add_op(TO_NUM(a), JSNUM(-1 * TO_NUM(b)->number.val));
+  double x = NUMVAL(TO_NUM(a));
+  return JSNUM(x - NUMVAL(TO_NUM(b)));
 }
 
 static js_val *
 mul_op(js_val *a, js_val *b)
 {
-  a = TO_NUM(a), b = TO_NUM(b);
-
-  if (IS_NAN(a) || IS_NAN(b)) return JSNAN();
-  if (IS_INF(a) || IS_INF(b)) {
-    if (IS_INF(a) && IS_INF(b))
-      return a->number.is_neg == b->number.is_neg ? JSINF() : JSNINF();
-
-    js_val *fin = IS_INF(a) ? b : a;
-    js_val *inf = IS_INF(a) ? a : b;
-
-    if (fin->number.val == 0) return JSNAN();
-    return (fin->number.val < 0) == inf->number.is_neg ? JSINF() : JSNINF();
-  }
-
-  return JSNUM(a->number.val * b->number.val);
+  double x = NUMVAL(TO_NUM(a));
+  return JSNUM(x * NUMVAL(TO_NUM(b)));
 }
 
 static js_val *
 div_op(js_val *a, js_val *b)
 {
-  a = TO_NUM(a), b = TO_NUM(b);
-
-  if (IS_NAN(a) || IS_NAN(b)) return JSNAN();
-  if (IS_INF(a) && IS_INF(b)) return JSNAN();
-  if (IS_INF(a))
-    return a->number.is_neg ? JSNINF() : JSINF();
-
-  if (T_BOTH(a, b, T_NUMBER)) {
-    if (a->number.is_nan || b->number.is_nan) return JSNAN();
-    if (a->number.is_inf || b->number.is_inf) return JSNAN();
-    // Division by 0 yields Infinity
-    if (b->number.val == 0) return JSINF();
-    return JSNUM(a->number.val / b->number.val);
-  }
-  return div_op(TO_NUM(a), TO_NUM(b));
+  double x = NUMVAL(TO_NUM(a));
+  return JSNUM(x / NUMVAL(TO_NUM(b)));
 }
 
 static js_val *
 mod_op(js_val *a, js_val *b)
 {
-  if (T_BOTH(a, b, T_NUMBER)) {
-    if (a->number.is_nan || b->number.is_nan) return JSNAN();
-    if (a->number.is_inf || b->number.is_inf) return JSNAN();
-    return JSNUM(fmod(a->number.val, b->number.val));
-  }
-  return mod_op(TO_NUM(a), TO_NUM(b));
+  double x = NUMVAL(TO_NUM(a));
+  return JSNUM(fmod(x, NUMVAL(TO_NUM(b))));
 }
 
 static js_val *
 eq_op(js_val *a, js_val *b, bool strict)
 {
+  js_type type = fh_type(a);
+
   // Strict equality on different types is always false
-  if (a->type != b->type && strict) return JSBOOL(0);
+  if (type != fh_type(b) && strict) return JSBOOL(0);
 
   // Same type
-  if (a->type == b->type) {
+  if (type == fh_type(b)) {
     if (IS_UNDEF(a) || IS_NULL(a)) return JSBOOL(1);
-    if (IS_NUM(a)) {
-      if (IS_NAN(a) || IS_NAN(b)) return JSBOOL(0);
-      if (a->number.val == b->number.val) return JSBOOL(1);
-      return JSBOOL(0);
-    }
+    // NaN is unequal to everything, itself included.
+    if (IS_NUM(a))
+      return JSBOOL(NUMVAL(a) == NUMVAL(b));
     if (IS_STR(a))
       return JSBOOL(STREQ(a->string.ptr, b->string.ptr));
-    if (IS_BOOL(a))
-      return JSBOOL(a->boolean.val == b->boolean.val);
-    // Functions & Objects (must be same ref)
+    // Booleans, Functions & Objects (must be same ref)
     return JSBOOL(a == b);
   }
 
@@ -267,7 +269,7 @@ static js_val *
 neq_op(js_val *a, js_val *b, bool strict)
 {
   // Invert the result of eq_op
-  return JSBOOL(!eq_op(a, b, strict)->boolean.val);
+  return JSBOOL(!BOOLVAL(eq_op(a, b, strict)));
 }
 
 static js_val *
@@ -293,12 +295,7 @@ abstr_rel_comp(js_val *a, js_val *b, bool left_first)
   a = TO_NUM(a), b = TO_NUM(b);
 
   if (IS_NAN(a) || IS_NAN(b)) return JSUNDEF();
-  if (a->number.val == b->number.val) return JSBOOL(0);
-  if (IS_INF(a) && !a->number.is_neg) return JSBOOL(0);
-  if (IS_INF(b) && !b->number.is_neg) return JSBOOL(1);
-  if (IS_INF(b) && b->number.is_neg) return JSBOOL(0);
-  if (IS_INF(a) && a->number.is_neg) return JSBOOL(1);
-  return JSBOOL(a->number.val < b->number.val);
+  return JSBOOL(NUMVAL(a) < NUMVAL(b));
 }
 
 static js_val *
@@ -307,7 +304,7 @@ lt_op(js_val *a, js_val *b, bool or_equal)
   js_val *res;
   if (or_equal) {
     res = abstr_rel_comp(b, a, false);
-    return JSBOOL(!(IS_UNDEF(res) || res->boolean.val));
+    return JSBOOL(!(IS_UNDEF(res) || BOOLVAL(res)));
   }
   res = abstr_rel_comp(a, b, true);
   return IS_UNDEF(res) ? JSBOOL(0): res;
@@ -319,7 +316,7 @@ gt_op(js_val *a, js_val *b, bool or_equal)
   js_val *res;
   if (or_equal) {
     res = abstr_rel_comp(a, b, true);
-    return JSBOOL(!(IS_UNDEF(res) || res->boolean.val));
+    return JSBOOL(!(IS_UNDEF(res) || BOOLVAL(res)));
   }
   res = abstr_rel_comp(b, a, false);
   return IS_UNDEF(res) ? JSBOOL(0): res;
@@ -330,7 +327,7 @@ and_exp(js_val *ctx, ast_node *a, ast_node *b)
 {
   // && operator returns the first false value, or the second true value.
   js_val *aval = fh_eval(ctx, a);
-  if (TO_BOOL(aval)->boolean.val) return fh_eval(ctx, b);
+  if (BOOLVAL(TO_BOOL(aval))) return fh_eval(ctx, b);
   return aval;
 }
 
@@ -339,7 +336,7 @@ or_exp(js_val *ctx, ast_node *a, ast_node *b)
 {
   // || returns the first true value, or the second false value.
   js_val *aval = fh_eval(ctx, a);
-  if (TO_BOOL(aval)->boolean.val) return aval;
+  if (BOOLVAL(TO_BOOL(aval))) return aval;
   return fh_eval(ctx, b);
 }
 
@@ -357,7 +354,9 @@ delete_op(js_val *ctx, ast_node *node)
     name = str_from_node(ctx, node->e1);
   }
 
-  js_prop *prop = fh_get_prop(env, name->string.ptr);
+  js_prop view, *prop = fh_get_prop(env, name->string.ptr, &view);
+  if (!prop)
+    return JSBOOL(1);
   if (!prop->configurable)
     return JSBOOL(0);
   return JSBOOL(fh_del_prop(env, name->string.ptr));
@@ -368,63 +367,105 @@ delete_op(js_val *ctx, ast_node *node)
 // Declaration & Assignment
 // ----------------------------------------------------------------------------
 
-static void
-assign(js_val *obj, char *name, js_val *val, char *op)
+/* Assign to a variable, returning the value assigned. A compound assignment
+ * applies its operator to the variable's current value first.
+ */
+js_val *
+fh_assign(js_val *ctx, ast_node *id, js_val *val, enum ast_op op)
+{
+  if (op != OPR_ASSIGN) {
+    js_prop *prop = fh_get_local(ctx, id->sval, id->slot, &id->ic);
+    val = fh_bin_op(op, prop ? prop->ptr : JSUNDEF(), val);
+  }
+  fh_set_local(ctx, id->sval, id->slot, val, &id->ic);
+  return val;
+}
+
+// Assign to a named prop, through the given cache if there is one.
+static js_val *
+put_named(js_val *obj, char *name, js_val *val, js_ic **ic)
 {
-  if (STREQ(op, "=")) {
+  // Assigning an array's length truncates or extends it.
+  if (IS_ARR(obj) && STREQ(name, fh->names.length)) {
+    double len = NUMVAL(TO_NUM(val));
+    if (!(len >= 0 && len < pow(2, 32) && fmod(len, 1) == 0))
+      fh_throw(fh->callstack, fh_new_error(E_RANGE, "Invalid array length"));
+    fh_set_len(obj, len);
+    return val;
+  }
+
+  // Set the array length.
+  unsigned long i;
+  if (IS_ARR(obj) && fh_array_index(name, &i) && i >= obj->object.length)
+    fh_set_len(obj, i + 1);
+
+  if (!IS_OBJ(obj))
+    return val;
+  if (ic)
+    fh_set_rec_cached(obj, name, val, ic);
+  else
     fh_set_rec(obj, name, val);
-    return;
+  return val;
+}
+
+/* Assign to `obj[key]`, once all three are evaluated. */
+js_val *
+fh_put_member(js_val *obj, js_val *key, js_val *val, enum ast_op op)
+{
+  // Members are read through the prototype chain.
+  if (op != OPR_ASSIGN)
+    val = fh_bin_op(op, fh_get_member(obj, key), val);
+
+  // `a[i] = x` goes straight to an array's elements, or a typed array's bytes.
+  unsigned long i;
+  if ((IS_ARR(obj) || IS_TYPED(obj)) && key_index(key, &i)) {
+    set_index(obj, i, val);
+    return val;
   }
+  return put_named(obj, TO_STR(key)->string.ptr, val, NULL);
+}
 
-  // Handle other assignment operators
-  js_val *cur = fh_get_rec(obj, name);
-  if (STREQ(op, "+=")) fh_set_rec(obj, name, add_op(cur, val));
-  if (STREQ(op, "-=")) fh_set_rec(obj, name, sub_op(cur, val));
-  if (STREQ(op, "*=")) fh_set_rec(obj, name, mul_op(cur, val));
-  if (STREQ(op, "/=")) fh_set_rec(obj, name, div_op(cur, val));
+/* Assign to `obj.name`, where `member` is the (non-computed) member
+ * expression and `ic` the assignment's own cache. A compound assignment reads
+ * through the member's cache, as `OP_GET_NAMED` does.
+ */
+js_val *
+fh_put_named(js_val *obj, ast_node *member, js_val *val, enum ast_op op,
+             js_ic **ic)
+{
+  char *name = member->e1->sval;
+  if (op != OPR_ASSIGN)
+    val = fh_bin_op(op, fh_get_proto_cached(obj, name, &member->ic), val);
+  return put_named(obj, name, val, ic);
 }
 
 static js_val *
 assign_exp(js_val *ctx, ast_node *node)
 {
+  if (node->op == OPR_COMMA) {
+    fh_eval(ctx, node->e1);
+    return fh_eval(ctx, node->e2);
+  }
+
   js_val *val = fh_eval(ctx, node->e2);
-  char *key = node->e1->sval;
 
   if (node->e1->type == NODE_MEMBER) {
-    js_val *old_ctx = ctx;
-    ctx = member_parent(old_ctx, node->e1);
-    key = member_child(old_ctx, node->e1)->string.ptr;
-
-    // Set the array length.
-    if (IS_ARR(ctx)) {
-      char *err;
-      unsigned long val = strtod(key, &err);
-      if (*err == 0 && val >= ctx->object.length)
-          fh_set_len(ctx, val + 1);
-    }
+    js_val *obj = member_parent(ctx, node->e1);
+    if (!node->e1->val && node->e1->e1->type == NODE_IDENT)
+      return fh_put_named(obj, node->e1, val, node->op, &node->ic);
+    return fh_put_member(obj, member_key(ctx, node->e1), val, node->op);
   }
-
   if (IS_OBJ(ctx))
-    assign(ctx, key, val, node->sval);
+    return fh_assign(ctx, node->e1, val, node->op);
   return val;
 }
 
 static js_val *
-var_dec(js_val *ctx, ast_node *node, bool ignore_rval)
+var_dec(js_val *ctx, ast_node *node)
 {
-  // If node->val is set, the variable declaration has already been hoisted and
-  // should not be touched.
-  if (!node->val) {
-    if (node->e2 == NULL || ignore_rval)
-      fh_set_prop(ctx, node->e1->sval, JSUNDEF(), P_WRITE | P_ENUM);
-    else
-      fh_set_prop(ctx, node->e1->sval, fh_eval(ctx, node->e2), P_WRITE | P_ENUM);
-  }
-  // If it has already been hoisted, we may still need to do the assignment.
-  else if (node->e2) {
-    node->sval = "=";
-    assign_exp(ctx, node);
-  }
+  // The declaration itself has been hoisted (see `hoist`), which leaves the
+  // initializer as an assignment.
+  if (node->e2) assign_exp(ctx, node);
   return JSUNDEF();
 }
 
@@ -437,24 +478,37 @@ static js_val *
 return_stmt(js_val *ctx, ast_node *node)
 {
   js_val *result = node->e1 ? fh_eval(ctx, node->e1) : JSUNDEF();
-  if (IS_FUNC(result))
+  if (IS_FUNC(result)) {
     result->object.scope = ctx;
-  result->signal = S_BREAK;
+    fh_gc_barrier(result, ctx);
+  }
+  fh->signal = S_RETURN;
   return result;
 }
 
+// Control transfers are raised on the global state rather than carried by
+// the value, since immediates have nowhere to put a flag. Statement lists
+// stop at the first pending signal and the enclosing loop, switch or call
+// consumes it.
+
 static js_val *
 break_stmt()
 {
-  js_val *signal = JSNULL();
-  signal->signal = S_BREAK;
-  return signal;
+  fh->signal = S_BREAK;
+  return JSUNDEF();
+}
+
+static js_val *
+cont_stmt()
+{
+  fh->signal = S_CONTINUE;
+  return JSUNDEF();
 }
 
 static js_val *
 if_stmt(js_val *ctx, ast_node *node)
 {
-  if (TO_BOOL(fh_eval(ctx, node->e1))->boolean.val)
+  if (BOOLVAL(TO_BOOL(fh_eval(ctx, node->e1))))
     return fh_eval(ctx, node->e2);
   else if (node->e3 != NULL)
     return fh_eval(ctx, node->e3);
@@ -476,22 +530,24 @@ switch_stmt(js_val *ctx, ast_node *node)
 
   // Check case clauses before and after the default case
   ast_node *clauses, *clauses_lst[] = {clauses_a, clauses_b};
-  int i;
+  unsigned i, j;
   for (i = 0; i < 2; i++) {
     clauses = clauses_lst[i];
     if (clauses) {
-      while (!clauses->visited) {
-        current = node_pop(clauses);
+      for (j = 0; j < clauses->count; j++) {
+        current = clauses->items[j];
         val = fh_eval(ctx, current->e1);
         // Cases fall-through to the next when breaks are omitted.
-        if (matched || eq_op(test, val, true)->boolean.val) {
+        if (matched || BOOLVAL(eq_op(test, val, true))) {
           matched = true;
           if (!current->e2) continue;
           result = fh_eval(ctx, current->e2);
-          if (result->signal == S_BREAK) {
-            result->signal = S_NONE;
+          if (fh->signal == S_BREAK) {
+            fh->signal = S_NONE;
             return result;
           }
+          if (fh->signal != S_NONE)
+            return result;
         }
       }
     }
@@ -501,8 +557,8 @@ switch_stmt(js_val *ctx, ast_node *node)
   // anything yet.
   if (defaultclause && !matched) {
     result = fh_eval(ctx, defaultclause->e2);
-    if (result->signal == S_BREAK)
-      result->signal = S_NONE;
+    if (fh->signal == S_BREAK)
+      fh->signal = S_NONE;
     return result;
   }
 
@@ -514,72 +570,62 @@ switch_stmt(js_val *ctx, ast_node *node)
 // Source & Statement Lists
 // ----------------------------------------------------------------------------
 
+/* Declare what a source list hoists in the scope it runs in. Functions are
+ * bound afresh, but vars are only added as undefined if the scope doesn't
+ * have them yet, so they don't clobber params or functions of the same name.
+ */
 static void
-func_dec_scan(js_val *ctx, ast_node *node)
-{
-  // Sweep for function declarations
-  ast_node *child;
-  while (!node->visited) {
-    child = node_pop(node);
-    if (child->type == NODE_FUNC) {
-      char *name = str_from_node(ctx, child->e3)->string.ptr;
-      fh_set_prop(ctx, name, JSFUNC(child), P_WRITE | P_ENUM);
-    }
-  }
-  node_rewind(node);
-}
-
-static void
-var_dec_scan(js_val *ctx, ast_node *node)
+hoist(js_val *ctx, ast_node *node)
 {
-  // Sweep for variable declarations
-
-  // Don't touch functions (stay within our current scope)
-  if (node->type == NODE_FUNC) return;
-
-  // Declare the variable and possibly convert it to an assignment
-  if (node->type == NODE_VAR_DEC) {
-    var_dec(ctx, node, true);    // true to ignore rhs
-    node->val = 1;               // Signals that it has been hoisted
+  if (!node->decls) node->decls = fh_declare(node);
+  js_decls *decls = node->decls;
+  js_prop view;
+  unsigned i;
+  for (i = 0; i < decls->num_funcs; i++) {
+    ast_node *func = decls->funcs[i];
+    fh_set_prop(ctx, func->e3->sval, JSFUNC(func), P_WRITE | P_ENUM);
+  }
+  for (i = 0; i < decls->num_vars; i++) {
+    if (!fh_get_prop(ctx, decls->vars[i], &view))
+      fh_set_prop(ctx, decls->vars[i], JSUNDEF(), P_WRITE | P_ENUM);
   }
-
-  // Recurse sub nodes, will hit the whole tree.
-  if (node->e1) var_dec_scan(ctx, node->e1);
-  if (node->e2) var_dec_scan(ctx, node->e2);
-  if (node->e3) var_dec_scan(ctx, node->e3);
 }
 
 static js_val *
 stmt_lst(js_val *ctx, ast_node *node)
 {
   js_val *result = NULL;
-  ast_node *child;
-  node_rewind(node);
-  while (!node->visited) {
-    child = node_pop(node);
-
-    if (child->type == NODE_RETURN)
-      return return_stmt(ctx, child);
-    if (child->type == NODE_BREAK)
-      return break_stmt();
-    if (child->type == NODE_CONT)
-      return JSUNDEF();
-
-    // Break signals bubble up as special values with a signal flag.
-    result = fh_eval(ctx, child);
-    if (result->signal == S_BREAK)
+  size_t scope = fh_open_scope();
+  unsigned i;
+  for (i = 0; i < node->count; i++) {
+    // Each statement drops the values the one before it left rooted.
+    fh_close_scope(scope);
+
+    // Break, continue and return bubble up until something consumes them.
+    result = fh_eval(ctx, node->items[i]);
+    if (fh->signal != S_NONE)
       return result;
   }
   return result ? result : JSUNDEF();
 }
 
+// Run a source list whose declarations are already in place.
 static js_val *
-src_lst(js_val *ctx, ast_node *node)
+run_src(js_val *ctx, ast_node *node)
 {
-  func_dec_scan(ctx, node);
-  var_dec_scan(ctx, node);
-
+  if (!node) return JSUNDEF();
+#ifdef FH_NO_VM
   return stmt_lst(ctx, node);
+#else
+  return fh_run(ctx, node);
+#endif
+}
+
+static js_val *
+src_lst(js_val *ctx, ast_node *node)
+{
+  hoist(ctx, node);
+  return run_src(ctx, node);
 }
 
 
@@ -592,19 +638,25 @@ obj_lit(js_val *ctx, ast_node *node)
 {
   js_val *obj = JSOBJ();
   obj->object.parent = ctx;
+  fh_gc_barrier(obj, ctx);
   if (node->e1 != NULL) fh_eval(obj, node->e1);
   return obj;
 }
 
+static void
+obj_prop(js_val *obj, ast_node *node)
+{
+  fh_set_key(obj, fh_atom_key(node->e1->sval), fh_eval(obj, node->e2));
+}
+
 static js_val *
 arr_lit(js_val *ctx, ast_node *node)
 {
   js_val *arr = JSARR();
   if (node->e1 != NULL) {
-    int i = 0;
-    while (!node->e1->visited) {
-      fh_set(arr, JSNUMKEY(i++)->string.ptr, fh_eval(ctx, node_pop(node->e1)));
-    }
+    unsigned i;
+    for (i = 0; i < node->e1->count; i++)
+      fh_set_index(arr, i, fh_eval(ctx, node->e1->items[i]));
     fh_set_len(arr, i);
   }
   return arr;
@@ -615,60 +667,88 @@ arr_lit(js_val *ctx, ast_node *node)
 // Iteration Constructs
 // ----------------------------------------------------------------------------
 
-static void
+// Consume the signal raised by a loop body. Returns true if the loop should
+// stop; a pending return is left in place for the enclosing call.
+static bool
+loop_exit()
+{
+  switch (fh->signal) {
+    case S_BREAK:
+      fh->signal = S_NONE;
+      return true;
+    case S_CONTINUE:
+      fh->signal = S_NONE;
+      return false;
+    case S_RETURN:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Loops drop what each iteration rooted, keeping only the latest result.
+
+static js_val *
 while_stmt(js_val *ctx, ast_node *cnd, ast_node *stmt)
 {
-  js_val *result;
+  js_val *result = JSUNDEF();
+  size_t scope = fh_open_scope();
 
-  while (TO_BOOL(fh_eval(ctx, cnd))->boolean.val) {
+  while (BOOLVAL(TO_BOOL(fh_eval(ctx, cnd)))) {
     result = fh_eval(ctx, stmt);
-    if (result->signal == S_BREAK) break;
+    if (loop_exit()) break;
+    fh_escape(scope, result);
   }
+  return result;
 }
 
-static void
+static js_val *
 for_stmt(js_val *ctx, ast_node *exp_grp, ast_node *stmt)
 {
-  js_val *result;
+  js_val *result = JSUNDEF();
 
   if (exp_grp->e1)
     fh_eval(ctx, exp_grp->e1);
 
-  while (TO_BOOL(exp_grp->e2 ? fh_eval(ctx, exp_grp->e2) : JSBOOL(1))->boolean.val) {
+  size_t scope = fh_open_scope();
+  while (BOOLVAL(TO_BOOL(exp_grp->e2 ? fh_eval(ctx, exp_grp->e2) : JSBOOL(1)))) {
     result = fh_eval(ctx, stmt);
-    if (result->signal == S_BREAK) break;
+    if (loop_exit()) break;
+    fh_escape(scope, result);
     if (exp_grp->e3)
       fh_eval(ctx, exp_grp->e3);
   }
+  return result;
 }
 
-static void
+static js_val *
 forin_stmt(js_val *ctx, ast_node *node)
 {
-  js_val *result, *obj, *env, *name;
+  js_val *result = JSUNDEF(), *obj, *env = ctx, *name = NULL, *key;
+  ast_node *lhs = node->e1->type == NODE_VAR_DEC ? node->e1->e1 : node->e1;
 
   obj = fh_eval(ctx, node->e2);
-  env = ctx;
 
-  if (node->e1->type == NODE_MEMBER) {
-    env = member_parent(ctx, node->e1);
-    name = member_child(ctx, node->e1);
+  if (lhs->type == NODE_MEMBER) {
+    env = member_parent(ctx, lhs);
+    name = member_child(ctx, lhs);
   }
-  else
-    name = str_from_node(ctx, node->e1);
-
-  js_prop *p;
-  while (obj != NULL) {
-    OBJ_ITER(obj, p) {
-      if (p->enumerable) {
-        // Assign to name, possibly undeclared assignment.
-        fh_set_rec(env, name->string.ptr, JSSTR(p->name));
-        result = fh_eval(ctx, node->e3);
-        if (result->signal == S_BREAK) break;
-      }
-    }
-    obj = obj->proto;
+  else if (lhs->type != NODE_IDENT)
+    name = str_from_node(ctx, lhs);
+
+  js_enum_iter it = fh_iter_enum(obj);
+  size_t scope = fh_open_scope();
+  while ((key = fh_next_enum(&it))) {
+    // Assign to name, possibly undeclared assignment.
+    if (name)
+      fh_set_rec(env, name->string.ptr, key);
+    else
+      fh_set_local(ctx, lhs->sval, lhs->slot, key, &lhs->ic);
+    result = fh_eval(ctx, node->e3);
+    if (loop_exit()) return result;
+    fh_escape(scope, result);
   }
+  return result;
 }
 
 
@@ -684,20 +764,38 @@ try_stmt(js_val *ctx, ast_node *node)
   state->ctx = ctx;
   fh_push_state(state);
 
+  js_val *result;
+  eval_state *parent = state->parent;
+  size_t scope = fh_open_scope();
+
   // Try
   if (!setjmp(state->jmp))
-    fh_eval(ctx, node->e1);
-  // Catch
+    result = fh_eval(ctx, node->e1);
+  // Catch. A throw skips the close of every handle scope opened since the
+  // try, so whatever they rooted is let go here.
   else {
+    fh_close_scope(scope);
+    fh->signal = S_NONE;
     fh_set(ctx, node->e2->e1->sval, fh_get(ctx, "FH_LAST_ERROR"));
-    fh_eval(ctx, node->e2->e2);
+    result = fh_eval(ctx, node->e2->e2);
   }
 
-  // Finally
-  if (node->e3 && node->e3->e1)
-    fh_eval(ctx, node->e3->e1);
+  // Unwind anything left above us, including our own state.
+  while (fh->callstack && fh->callstack != parent)
+    fh_pop_state();
+
+  // Finally. A break or return inside the finally block overrides whatever
+  // was pending from the try or catch block.
+  if (node->e3 && node->e3->e1) {
+    ctl_signal pending = fh->signal;
+    fh->signal = S_NONE;
+    js_val *final = fh_eval(ctx, node->e3->e1);
+    if (fh->signal != S_NONE)
+      return final;
+    fh->signal = pending;
+  }
 
-  return JSUNDEF();
+  return result;
 }
 
 static js_val *
@@ -716,63 +814,102 @@ throw_stmt(js_val *ctx, ast_node *exp)
 // ----------------------------------------------------------------------------
 
 static js_val *
-setup_call_env(js_val *ctx, js_val *this, js_val *func, js_args *args)
+new_arguments(js_val *func, js_args *args)
 {
+  // Set up the (array-like) arguments object.
   js_val *arguments = JSOBJ();
+  unsigned long i, arglen = ARGLEN(args);
+  fh_set_class(arguments, "Arguments");
+  for (i = 0; i < arglen; i++)
+    fh_set_index(arguments, i, ARG(args, i));
+  fh_set_key(arguments, fh_atom_key(fh->names.callee), func);
+  fh_set_key(arguments, fh_atom_key(fh->names.length), JSNUM(arglen));
+  return arguments;
+}
+
+// Define a call's locals one by one, in a scope that may have some already.
+static js_val *
+setup_scope(js_val *ctx, js_val *this, js_val *func, js_args *args)
+{
+  js_val *arguments = new_arguments(func, args);
   ast_node *func_node = func->object.node;
   js_val *scope = func->object.scope ? func->object.scope : JSOBJ();
 
   scope->object.parent = ctx;
+  fh_gc_barrier(scope, ctx);
 
-  fh_set(scope, "this", this);
-  fh_set(scope, "arguments", arguments);
-
-  // Add the function name as ref to itself (if it has a name)
-  // TODO: Take another look at this. Under what circumstances is the name
-  // set in the function environemnt?
-  if (func_node->sval != NULL)
-    fh_set(scope, func_node->sval, func);
-
-  // Set up the (array-like) arguments object.
-  unsigned long i, arglen = ARGLEN(args);
-  for (i = 0; i < arglen; i++)
-    fh_set(arguments, JSNUMKEY(i)->string.ptr, ARG(args, i));
-  fh_set_class(arguments, "Arguments");
-  fh_set(arguments, "callee", func);
-  fh_set(arguments, "length", JSNUM(arglen));
+  fh_set_key(scope, fh_atom_key(fh->names.this), this);
+  fh_set_key(scope, fh_atom_key(fh->names.arguments), arguments);
 
   // Set up params as locals (if any)
   if (func_node->e1 != NULL) {
     ast_node *params = func_node->e1;
-    node_rewind(params);
+    unsigned i;
     // Go through each param and match it by position with an arg.
-    while (!params->visited) {
-      if (args->arg) {
-        fh_set(scope, node_pop(params)->sval, args->arg);
-        if (args->next)
-          args = args->next;
-        else
-          args->arg = NULL;
-      }
-      else {
-        fh_set(scope, node_pop(params)->sval, JSUNDEF());
-      }
+    for (i = 0; i < params->count; i++) {
+      js_val *arg = args && args->arg ? args->arg : JSUNDEF();
+      fh_set_key(scope, fh_atom_key(params->items[i]->sval), arg);
+      if (args) args = args->next;
     }
   }
+  if (func_node->e2) hoist(scope, func_node->e2);
+
+  // A named function expression's own name, as `fh_resolve` lays it out.
+  if (func_node->val && func_node->e3) {
+    char *name = func_node->e3->sval;
+    js_prop view;
+    if (!fh_get_prop(scope, name, &view)) fh_set_prop(scope, name, func, P_NONE);
+  }
+  return scope;
+}
+
+static js_val *
+setup_call_env(js_val *ctx, js_val *this, js_val *func, js_args *args)
+{
+  ast_node *func_node = func->object.node;
+  if (!func_node->frame) func_node->frame = fh_resolve(func_node);
+  js_frame *frame = func_node->frame;
+
+  // A closure runs in the scope it was returned from (see `return_stmt`).
+  if (func->object.scope || !frame->shape)
+    return setup_scope(ctx, this, func, args);
+
+  // Otherwise the scope starts out with every local in its slot.
+  js_val *scope = JSOBJ();
+  scope->object.parent = ctx;
+  fh_gc_barrier(scope, ctx);
+  fh_init_props(scope, frame->shape, frame->locals);
+
+  fh_set_slot(scope, FRAME_THIS, this);
+  if (frame->arguments >= 0)
+    fh_set_slot(scope, frame->arguments, new_arguments(func, args));
+  if (frame->self >= 0)
+    fh_set_slot(scope, frame->self, func);
+
+  // Match params by position with args.
+  unsigned i;
+  for (i = 0; i < frame->num_params; i++) {
+    fh_set_slot(scope, frame->params[i], args && args->arg ? args->arg : JSUNDEF());
+    if (args) args = args->next;
+  }
+
+  // Vars are in place already, and functions bound over params of their name.
+  if (frame->decls) {
+    for (i = 0; i < frame->decls->num_funcs; i++)
+      fh_set_slot(scope, frame->funcs[i], JSFUNC(frame->decls->funcs[i]));
+  }
   return scope;
 }
 
 static js_args *
 build_args(js_val *ctx, ast_node *args_node)
 {
-  js_args *args = args_new();
-
-  if (args_node->e1 == NULL) return args;
-  if (!args_node->visited) {
-    args->arg = fh_eval(ctx, node_pop(args_node));
-    args->next = args_node->visited ? NULL : build_args(ctx, args_node);
+  js_args *args = args_new(), *tail = args;
+  unsigned i;
+  for (i = 0; i < args_node->count; i++) {
+    if (i) tail = tail->next = args_new();
+    tail->arg = fh_eval(ctx, args_node->items[i]);
   }
-  node_rewind(args_node);
   return args;
 }
 
@@ -785,6 +922,9 @@ call(js_val *ctx, js_val *this, js_val *func, eval_state *state, js_args *args)
   state->ctx = ctx;
   state->this = this;
 
+  // Only the result outlives the call.
+  size_t scope = fh_open_scope();
+
   if (func->object.native) {
     // Native functions are C functions referenced by pointer.
     js_native_function *native = func->object.nativefn;
@@ -792,15 +932,14 @@ call(js_val *ctx, js_val *this, js_val *func, eval_state *state, js_args *args)
     state->caller_info = "(built-in function)";
 
     // new Number, new Boolean, etc. return wrapper objects.
-    // Here we resolve the wrapper to the value it wraps.
-    if (instance && IS_OBJ(instance) && instance->object.primitive)
+    // Here we resolve the wrapper to the value it wraps. Dates keep their
+    // wrapper so that setters can replace the time value.
+    if (instance && IS_OBJ(instance) && instance->object.primitive && !IS_DATE(instance))
       instance = instance->object.primitive;
 
-    return native(instance, args, state);
+    return fh_escape(scope, native(instance, args, state));
   }
 
-  node_rewind(func->object.node);
-
   if (func->object.node->e3 && func->object.node->e3->sval)
     state->caller_info = func->object.node->e3->sval;
   else
@@ -808,7 +947,12 @@ call(js_val *ctx, js_val *this, js_val *func, eval_state *state, js_args *args)
 
   js_val *func_scope = setup_call_env(ctx, this, func, args);
   state->scope = func_scope;
-  return fh_eval(func_scope, func->object.node->e2);
+
+  // Falling off the end of a function body yields undefined.
+  js_val *result = run_src(func_scope, func->object.node->e2);
+  bool returned = fh->signal == S_RETURN;
+  fh->signal = S_NONE;
+  return fh_escape(scope, returned ? result : JSUNDEF());
 }
 
 static js_val *
@@ -822,19 +966,34 @@ call_exp(js_val *ctx, ast_node *node)
   if (node->e2->type != NODE_ARG_LST)
     return fh_get_proto(maybe_func, str_from_node(ctx, node->e2)->string.ptr);
 
+  fh_check_callee(ctx, node, maybe_func);
+  return fh_call_node(ctx, node, maybe_func, build_args(ctx, node->e2));
+}
+
+/* Throw unless the callee of a call expression is a function. */
+void
+fh_check_callee(js_val *ctx, ast_node *node, js_val *func)
+{
+  if (IS_FUNC(func)) return;
+
   eval_state *state = fh_new_state(node->line, node->column);
+  state->ctx = ctx;
+  fh_throw(state, fh_new_error(E_TYPE, "%s is not a function", fh_typeof(func)));
+}
 
+/* Call the function a call expression's callee evaluated to. */
+js_val *
+fh_call_node(js_val *ctx, ast_node *node, js_val *func, js_args *args)
+{
+  eval_state *state = fh_new_state(node->line, node->column);
   state->ctx = ctx;
-  if (!IS_FUNC(maybe_func))
-    fh_throw(state, fh_new_error(E_TYPE, "%s is not a function", fh_typeof(maybe_func)));
-  js_args *args = build_args(ctx, node->e2);
 
   // Check for a bound this (see Function#bind)
-  js_val *this = maybe_func->object.bound_this ?
-    maybe_func->object.bound_this : fh_get(ctx, "this");
+  js_val *this = func->object.bound_this ?
+    func->object.bound_this : fh_get_key(ctx, fh_atom_key(fh->names.this));
 
   fh_push_state(state);
-  js_val *res = call(ctx, this, maybe_func, state, args);
+  js_val *res = call(ctx, this, func, state, args);
   fh_pop_state();
   return res;
 }
@@ -881,7 +1040,7 @@ new_exp(js_val *ctx, ast_node *exp)
   if (!IS_FUNC(ctr))
     fh_throw(state, fh_new_error(E_TYPE, "%s is not a function", fh_typeof(ctr)));
 
-  js_val *res, *obj = JSOBJ(), *proto = fh_get(ctr, "prototype");
+  js_val *res, *obj = JSOBJ(), *proto = fh_get_key(ctr, fh_atom_key(fh->names.prototype));
 
   fh_push_state(state);
   res = call(ctx, obj, ctr, state, args);
@@ -890,8 +1049,10 @@ new_exp(js_val *ctx, ast_node *exp)
 
   // Automatically set the prototype to use the constructor's "prototype"
   // property if valid and the result's proto member appears to be unmodified.
-  if (IS_OBJ(proto) && res->proto == fh->object_proto)
+  if (IS_OBJ(proto) && res->proto == fh->object_proto) {
     res->proto = IS_OBJ(proto) ? proto : fh->object_proto;
+    fh_gc_barrier(res, res->proto);
+  }
 
   return res;
 }
@@ -905,69 +1066,67 @@ static js_val *
 postfix_exp(js_val *ctx, ast_node *node)
 {
   js_val *old_val = TO_NUM(fh_eval(ctx, node->e1));
-  char *op = node->sval;
-  if (STREQ(op, "++")) {
-    put(ctx, node->e1, add_op(old_val, JSNUM(1)));
-    return old_val;
+  switch (node->op) {
+    case OPR_INC: put(ctx, node->e1, add_op(old_val, JSNUM(1))); break;
+    case OPR_DEC: put(ctx, node->e1, sub_op(old_val, JSNUM(1))); break;
+    default: UNREACHABLE();
   }
-  if (STREQ(op, "--")) {
-    put(ctx, node->e1, sub_op(old_val, JSNUM(1)));
-    return old_val;
-  }
-  UNREACHABLE();
+  return old_val;
 }
 
 static js_val *
 prefix_exp(js_val *ctx, ast_node *node)
 {
-  char *op = node->sval;
+  js_val *old_val, *new_val;
+
+  switch (node->op) {
+    case OPR_DELETE:
+      return delete_op(ctx, node);
+    case OPR_TYPEOF:
+      if (node->e1->type == NODE_IDENT)
+        return JSSTR(fh_typeof(fh_get_rec(ctx, node->e1->sval)));
+      return JSSTR(fh_typeof(fh_eval(ctx, node->e1)));
+    case OPR_VOID:
+      fh_eval(ctx, node->e1);
+      return JSUNDEF();
 
-  if (STREQ(op, "delete"))
-    return delete_op(ctx, node);
-  if (STREQ(op, "typeof")) {
-    if (node->e1->type == NODE_IDENT)
-      return JSSTR(fh_typeof(fh_get_rec(ctx, node->e1->sval)));
-    return JSSTR(fh_typeof(fh_eval(ctx, node->e1)));
-  }
-  if (STREQ(op, "void")) {
-    fh_eval(ctx, node->e1);
-    return JSUNDEF();
-  }
-  if (STREQ(op, "+"))
-    return TO_NUM(fh_eval(ctx, node->e1));
-  if (STREQ(op, "!"))
-    return JSBOOL(!TO_BOOL(fh_eval(ctx, node->e1))->boolean.val);
-  if (STREQ(op, "-")) {
-    js_val *x = TO_NUM(fh_eval(ctx, node->e1));
-    if (x->number.is_inf) return JSNINF();
-    if (x->number.is_nan) return JSNAN();
-    return JSNUM(-1 * x->number.val);
-  }
+    // Increment and decrement.
+    // TODO: these need to throw a syntax error for strict references
+    case OPR_INC:
+    case OPR_DEC:
+      old_val = TO_NUM(fh_eval(ctx, node->e1));
+      new_val = node->op == OPR_INC ?
+        add_op(old_val, JSNUM(1)) : sub_op(old_val, JSNUM(1));
+      put(ctx, node->e1, new_val);
+      return new_val;
 
-  js_val *old_val = TO_NUM(fh_eval(ctx, node->e1));
-  js_val *new_val;
-
-  // Increment and decrement.
-  // TODO: these need to throw a syntax error for strict references
-  if (STREQ(op, "++")) {
-    new_val = add_op(old_val, JSNUM(1));
-    put(ctx, node->e1, new_val);
-    return new_val;
-  }
-  if (STREQ(op, "--")) {
-    new_val = sub_op(old_val, JSNUM(1));
-    put(ctx, node->e1, new_val);
-    return new_val;
+    default:
+      return fh_unary_op(node->op, fh_eval(ctx, node->e1));
   }
+}
 
-  // Bitwise NOT
-  if (STREQ(op, "~")) {
-    old_val = fh_to_int32(old_val);
-    int old_val_int32 = (int)old_val->number.val;
-    return JSNUM(~old_val_int32);
-  }
+/* Apply a unary operator that only needs its operand's value. */
+js_val *
+fh_unary_op(enum ast_op op, js_val *x)
+{
+  switch (op) {
+    case OPR_PLUS:
+      return TO_NUM(x);
+    case OPR_NOT:
+      return JSBOOL(!BOOLVAL(TO_BOOL(x)));
+    case OPR_NEG:
+      x = TO_NUM(x);
+      if (IS_INF(x)) return JSNINF();
+      if (IS_NAN(x)) return JSNAN();
+      return JSNUM(-1 * NUMVAL(x));
+
+    // Bitwise NOT
+    case OPR_BIT_NOT:
+      return JSNUM(~(int)NUMVAL(fh_to_int32(TO_NUM(x))));
 
-  UNREACHABLE();
+    default:
+      UNREACHABLE();
+  }
 }
 
 
@@ -978,67 +1137,74 @@ prefix_exp(js_val *ctx, ast_node *node)
 static js_val *
 bin_exp(js_val *ctx, ast_node *node)
 {
-  char *op = node->sval;
-
   // Logical (must short-circuit)
-  if (STREQ(op, "&&")) return and_exp(ctx, node->e1, node->e2);
-  if (STREQ(op, "||")) return or_exp(ctx, node->e1, node->e2);
+  if (node->op == OPR_AND) return and_exp(ctx, node->e1, node->e2);
+  if (node->op == OPR_OR) return or_exp(ctx, node->e1, node->e2);
 
   // At this point, we can safely evaluate both expressions.
   js_val *a = fh_eval(ctx, node->e1);
   js_val *b = fh_eval(ctx, node->e2);
+  return fh_bin_op(node->op, a, b);
+}
 
-  // Arithmetic and string operations
-  if (STREQ(op, "+")) return add_op(a, b);
-  if (STREQ(op, "-")) return sub_op(a, b);
-  if (STREQ(op, "*")) return mul_op(a, b);
-  if (STREQ(op, "/")) return div_op(a, b);
-  if (STREQ(op, "%")) return mod_op(a, b);
-
-  // (In)equality
-  if (STREQ(op, "=="))  return eq_op(a, b, false);
-  if (STREQ(op, "!="))  return neq_op(a, b, false);
-  if (STREQ(op, "===")) return eq_op(a, b, true);
-  if (STREQ(op, "!==")) return neq_op(a, b, true);
-
-  // Relational
-  if (STREQ(op, "<"))  return lt_op(a, b, false);
-  if (STREQ(op, ">"))  return gt_op(a, b, false);
-  if (STREQ(op, "<=")) return lt_op(a, b, true);
-  if (STREQ(op, ">=")) return gt_op(a, b, true);
-  if (STREQ(op, "instanceof")) {
-    if (!IS_FUNC(b)) {
-      char *fmt = "Expecting a function in 'instanceof' check, got %s";
-      fh_throw(NULL, fh_new_error(E_TYPE, fmt, fh_typeof(b)));
-    }
-    return fh_has_instance(b, a);
-  }
-  if (STREQ(op, "in")) {
-    if (!IS_OBJ(b)) {
-      char *fmt = "Expecting an object with 'in' operator, got %s";
-      fh_throw(NULL, fh_new_error(E_TYPE, fmt, fh_typeof(b)));
-    }
-    return fh_has_property(b, TO_STR(a)->string.ptr);
-  }
+/* Apply a binary operator, other than the logical ones, to its operands. */
+js_val *
+fh_bin_op(enum ast_op op, js_val *a, js_val *b)
+{
+  switch (op) {
+    // Arithmetic and string operations
+    case OPR_ADD: return add_op(a, b);
+    case OPR_SUB: return sub_op(a, b);
+    case OPR_MUL: return mul_op(a, b);
+    case OPR_DIV: return div_op(a, b);
+    case OPR_MOD: return mod_op(a, b);
+
+    // (In)equality
+    case OPR_EQ:        return eq_op(a, b, false);
+    case OPR_NE:        return neq_op(a, b, false);
+    case OPR_STRICT_EQ: return eq_op(a, b, true);
+    case OPR_STRICT_NE: return neq_op(a, b, true);
+
+    // Relational
+    case OPR_LT: return lt_op(a, b, false);
+    case OPR_GT: return gt_op(a, b, false);
+    case OPR_LE: return lt_op(a, b, true);
+    case OPR_GE: return gt_op(a, b, true);
+    case OPR_INSTANCEOF:
+      if (!IS_FUNC(b)) {
+        char *fmt = "Expecting a function in 'instanceof' check, got %s";
+        fh_throw(NULL, fh_new_error(E_TYPE, fmt, fh_typeof(b)));
+      }
+      return fh_has_instance(b, a);
+    case OPR_IN:
+      if (!IS_OBJ(b)) {
+        char *fmt = "Expecting an object with 'in' operator, got %s";
+        fh_throw(NULL, fh_new_error(E_TYPE, fmt, fh_typeof(b)));
+      }
+      return fh_has_property(b, TO_STR(a)->string.ptr);
 
-  int a_int32 = fh_to_int32(a)->number.val;
-  int b_int32 = fh_to_int32(b)->number.val;
+    default:
+      break;
+  }
 
-  // Bitwise Logical
-  if (STREQ(op, "&")) return JSNUM(a_int32 & b_int32);
-  if (STREQ(op, "^")) return JSNUM(a_int32 ^ b_int32);
-  if (STREQ(op, "|")) return JSNUM(a_int32 | b_int32);
+  int a_int32 = NUMVAL(fh_to_int32(a));
+  int b_int32 = NUMVAL(fh_to_int32(b));
+  unsigned shift_cnt = (unsigned)NUMVAL(fh_to_uint32(b)) & 0x1F;
 
-  unsigned a_uint32 = fh_to_uint32(a)->number.val;
-  unsigned b_uint32 = fh_to_uint32(b)->number.val;
-  unsigned shift_cnt = b_uint32 & 0x1F;
+  switch (op) {
+    // Bitwise Logical
+    case OPR_BIT_AND: return JSNUM(a_int32 & b_int32);
+    case OPR_BIT_XOR: return JSNUM(a_int32 ^ b_int32);
+    case OPR_BIT_OR:  return JSNUM(a_int32 | b_int32);
 
-  // Bitwise Shift
-  if (STREQ(op, "<<")) return JSNUM(a_int32 << shift_cnt);
-  if (STREQ(op, ">>")) return JSNUM(a_int32 >> shift_cnt);
-  if (STREQ(op, ">>>")) return JSNUM(a_uint32 >> shift_cnt);
+    // Bitwise Shift
+    case OPR_LSHIFT:  return JSNUM(a_int32 << shift_cnt);
+    case OPR_RSHIFT:  return JSNUM(a_int32 >> shift_cnt);
+    case OPR_URSHIFT: return JSNUM((unsigned)NUMVAL(fh_to_uint32(a)) >> shift_cnt);
 
-  UNREACHABLE();
+    default:
+      UNREACHABLE();
+  }
 }
 
 
@@ -1064,8 +1230,8 @@ base_exp(js_val *ctx, ast_node *node)
 // Evaluation
 // ----------------------------------------------------------------------------
 
-js_val *
-fh_eval(js_val *ctx, ast_node *node)
+static js_val *
+eval_node(js_val *ctx, ast_node *node)
 {
   if (!node) return JSUNDEF();
 
@@ -1089,8 +1255,9 @@ fh_eval(js_val *ctx, ast_node *node)
     case NODE_SWITCH_STMT: return switch_stmt(ctx, node);
     case NODE_ASGN:        return assign_exp(ctx, node);
     case NODE_RETURN:      return return_stmt(ctx, node);
-    case NODE_VAR_DEC:     return var_dec(ctx, node, false);
+    case NODE_VAR_DEC:     return var_dec(ctx, node);
     case NODE_BREAK:       return break_stmt();
+    case NODE_CONT:        return cont_stmt();
     case NODE_TRY_STMT:    return try_stmt(ctx, node);
     case NODE_THROW:       return throw_stmt(ctx, node->e1);
     case NODE_IF:          return if_stmt(ctx, node);
@@ -1101,10 +1268,11 @@ fh_eval(js_val *ctx, ast_node *node)
     case NODE_VAR_DEC_LST: return eval_each(ctx, node);
     case NODE_PROP_LST:    return eval_each(ctx, node);
 
-    case NODE_PROP:        fh_set(ctx, node->e1->sval, fh_eval(ctx, node->e2)); break;
-    case NODE_WHILE:       while_stmt(ctx, node->e1, node->e2); break;
-    case NODE_FOR:         for_stmt(ctx, node->e1, node->e2); break;
-    case NODE_FORIN:       forin_stmt(ctx, node); break;
+    case NODE_WHILE:       return while_stmt(ctx, node->e1, node->e2);
+    case NODE_FOR:         return for_stmt(ctx, node->e1, node->e2);
+    case NODE_FORIN:       return forin_stmt(ctx, node);
+
+    case NODE_PROP:        obj_prop(ctx, node); break;
     case NODE_EMPT_STMT:   break;
 
     default:
@@ -1117,3 +1285,11 @@ fh_eval(js_val *ctx, ast_node *node)
 
   return JSUNDEF();
 }
+
+js_val *
+fh_eval(js_val *ctx, ast_node *node)
+{
+  // Callers hold the result in C locals, so it stays rooted until the
+  // enclosing handle scope is closed.
+  return fh_root(eval_node(ctx, node));
+}
@@ -23,12 +23,22 @@
 #include "nodes.h"
 #include "args.h"
 
-#define T_BOTH(a,b,t)     ((a)->type == (t) && (b)->type == (t))
-#define T_XOR(a,b,t1,t2)  (((a)->type == (t1) && (b)->type == (t2)) || \
-                           ((a)->type == (t2) && (b)->type == (t1)))
+#define T_BOTH(a,b,t)     (fh_type(a) == (t) && fh_type(b) == (t))
+#define T_XOR(a,b,t1,t2)  ((fh_type(a) == (t1) && fh_type(b) == (t2)) || \
+                           (fh_type(a) == (t2) && fh_type(b) == (t1)))
 
 js_val * fh_eval(js_val *, ast_node *);
 js_val * fh_call(js_val *, js_val *, js_val *, js_args *);
 js_val * fh_eq(js_val *, js_val *, bool);
 
+// Steps of evaluation shared with the bytecode VM (see vm.c).
+js_val * fh_bin_op(enum ast_op, js_val *, js_val *);
+js_val * fh_unary_op(enum ast_op, js_val *);
+js_val * fh_get_member(js_val *, js_val *);
+js_val * fh_put_member(js_val *, js_val *, js_val *, enum ast_op);
+js_val * fh_put_named(js_val *, ast_node *, js_val *, enum ast_op, js_ic **);
+js_val * fh_assign(js_val *, ast_node *, js_val *, enum ast_op);
+void fh_check_callee(js_val *, ast_node *, js_val *);
+js_val * fh_call_node(js_val *, ast_node *, js_val *, js_args *);
+
 #endif
@@ -17,6 +17,7 @@
  */
 
 #include <math.h>
+#include <stddef.h>
 
 #include "flathead.h"
 #include "props.h"
@@ -34,38 +35,38 @@
 js_val *
 fh_new_val(js_type type)
 {
-  js_val *val = fh_malloc(true);
+  js_val *val = fh_malloc(type);
 
+  // A reused cell still holds whatever its last occupant left there, which
+  // the GC would follow unless every constructor overwrote all of it.
+  memset(&val->number, 0, fh_cell_size(type) - offsetof(js_val, number));
+
+  val->shape = fh->empty_shape;
   val->map = NULL;
   val->type = type;
-  val->signal = S_NONE;
   val->proto = NULL;
-  val->marked = false;
+  // Values created while a collection is marking are born black (and so
+  // old), so they survive it.
+  val->marked = fh->gc_state == GC_STATE_MARK;
+  val->old = val->marked;
   val->flagged = false;
+  val->remembered = false;
 
-  return val;
+  return fh_root(val);
 }
 
+#ifndef FH_NAN_BOXING
 js_val *
-fh_new_number(double x, bool is_nan, bool is_inf, bool is_neg)
+fh_new_number(double x)
 {
   js_val *val = fh_new_val(T_NUMBER);
 
-  if (isnan(x))
-    is_nan = true;
-  if (isinf(x)) {
-    is_inf = true;
-    is_neg = x < 0;
-  }
-
   val->number.val = x;
-  val->number.is_nan = is_nan;
-  val->number.is_inf = is_inf;
-  val->number.is_neg = is_neg;
-  val->proto = fh_try_get_proto("Number");
+  val->proto = fh->number_proto;
 
   return val;
 }
+#endif
 
 js_val *
 fh_new_string(char *x)
@@ -76,18 +77,7 @@ fh_new_string(char *x)
   val->string.ptr[strlen(x)] = '\0';
   strcpy(val->string.ptr, x);
   fh_set_len(val, strlen(x));
-  val->proto = fh_try_get_proto("String");
-
-  return val;
-}
-
-js_val *
-fh_new_boolean(bool x)
-{
-  js_val *val = fh_new_val(T_BOOLEAN);
-
-  val->boolean.val = x;
-  val->proto = fh_try_get_proto("Boolean");
+  val->proto = fh->string_proto;
 
   return val;
 }
@@ -107,6 +97,10 @@ fh_new_object()
   val->object.scope = NULL;
   val->object.instance = NULL;
   val->object.node = NULL;
+  val->object.elements = NULL;
+  val->object.capacity = 0;
+  val->object.sparse = false;
+  val->object.binary = NULL;
   val->proto = fh->object_proto;
 
   return val;
@@ -147,7 +141,7 @@ fh_new_function(struct ast_node *node)
   val->proto = fh->function_proto;
 
   // Set the function length. Native functions must do this manually.
-  fh_set_len(val, (node && node->e1) ? node_count(node->e1) : 0);
+  fh_set_len(val, (node && node->e1) ? node->e1->count : 0);
 
   return val;
 }
@@ -170,10 +164,11 @@ fh_new_regexp(char *re)
   js_val *val = fh_new_val(T_OBJECT);
 
   val->proto = fh_try_get_proto("RegExp");
+  fh_gc_barrier(val, val->proto);
 
   // Process the trailing options: re = /pattern/[imgy]{0,4}
   int i = strlen(re) - 1;
-  while (re[i] != '/' && i > 0) {
+  while (i > 0 && re[i] != '/') {
     switch (re[i]) {
       case 'g': fh_set(val, "global", JSBOOL(1)); break;
       case 'i': fh_set(val, "ignoreCase", JSBOOL(1)); break;
@@ -196,6 +191,7 @@ fh_new_error(char *name, const char *tpl, ...)
 {
   js_val *val = fh_new_val(T_OBJECT);
   val->proto = fh_try_get_proto("Error");
+  fh_gc_barrier(val, val->proto);
   fh_set_class(val, "Error");
 
   va_list ap;
@@ -219,20 +215,6 @@ fh_new_error(char *name, const char *tpl, ...)
   return val;
 }
 
-js_prop *
-fh_new_prop(js_prop_flags flags)
-{
-  js_prop *prop = malloc(sizeof(js_prop));
-
-  prop->writable = flags & P_WRITE;
-  prop->configurable = flags & P_CONF;
-  prop->enumerable = flags & P_ENUM;
-  prop->circular = false;
-  prop->ptr = NULL;
-
-  return prop;
-}
-
 void
 fh_pop_state()
 {
@@ -277,16 +259,53 @@ fh_new_global_state()
   fh_state *state = malloc(sizeof(fh_state));
 
   state->gc_state = GC_STATE_NONE;
-  memset(state->gc_arenas, 0, sizeof(state->gc_arenas));
+  state->gc_arenas = NULL;
   state->gc_num_arenas = 0;
+  state->gc_arenas_cap = 0;
+  memset(state->gc_alloc_arenas, 0, sizeof(state->gc_alloc_arenas));
+  state->gc_heap_size = 0;
+  state->gc_last_reclaimed = 0;
+  state->gc_total_reclaimed = 0;
+  state->gc_mark_stack = NULL;
+  state->gc_mark_top = 0;
+  state->gc_mark_cap = 0;
+  state->gc_mark_overflow = false;
+  state->gc_roots = NULL;
+  state->gc_roots_top = 0;
+  state->gc_roots_cap = 0;
+  state->gc_minor = false;
+  state->gc_step_allocs = 0;
+  state->gc_sweep_pending = 0;
+  state->gc_sweep_minor = false;
+  state->gc_major_requested = false;
+  memset(state->gc_live, 0, sizeof(state->gc_live));
+  state->gc_steps = 0;
+  state->gc_remembered = NULL;
+  state->gc_remembered_len = 0;
+  state->gc_remembered_cap = 0;
+  state->gc_minor_runs = 0;
+  state->gc_major_runs = 0;
   state->gc_runs = 0;
   state->gc_time = 0;
   state->gc_last_start = 0;
 
   state->global = NULL;
+  state->empty_shape = fh_new_shape(NULL, NULL);
+  state->dict_epoch = 0;
+  state->method_cache = calloc(METHOD_CACHE_SIZE, sizeof(js_method_entry));
+  state->names.length = fh_intern("length");
+  state->names.prototype = fh_intern("prototype");
+  state->names.this = fh_intern("this");
+  state->names.arguments = fh_intern("arguments");
+  state->names.callee = fh_intern("callee");
   state->function_proto = NULL;
   state->object_proto = NULL;
+  state->array_proto = NULL;
+  state->string_proto = NULL;
+  state->number_proto = NULL;
+  state->boolean_proto = NULL;
   state->callstack = NULL;
+  state->signal = S_NONE;
 
   state->script_name = "main";
 
@@ -294,6 +313,8 @@ fh_new_global_state()
   state->opt_print_tokens = false;
   state->opt_print_ast = false;
   state->opt_keep_history_file = true;
+  state->opt_max_heap = 0;
+  state->opt_gc_step_us = GC_STEP_US;
   state->opt_history_filename = ".flathead_history";
 
   return state;
@@ -349,7 +370,7 @@ fh_to_number(js_val *val)
   if (IS_UNDEF(val)) return JSNAN();
   if (IS_NULL(val)) return JSNUM(0);
   if (IS_BOOL(val)) {
-    if (val->boolean.val == 0) return JSNUM(0);
+    if (BOOLVAL(val) == 0) return JSNUM(0);
     return JSNUM(1);
   }
   if (IS_STR(val)) {
@@ -373,17 +394,17 @@ fh_to_int(js_val *val)
   val = fh_to_number(val);
   if (IS_NAN(val))
     return JSNUM(0);
-  if (IS_INF(val) || val->number.val == 0)
+  if (IS_INF(val) || NUMVAL(val) == 0)
     return val;
-  int sign = val->number.val < 0 ? -1 : 1;
-  int_val = sign * floor(fabs(val->number.val));
+  int sign = NUMVAL(val) < 0 ? -1 : 1;
+  int_val = sign * floor(fabs(NUMVAL(val)));
   return JSNUM(int_val);
 }
 
 js_val *
 fh_to_int32(js_val *val)
 {
-  long long int32_bit = fh_to_uint32(val)->number.val;
+  long long int32_bit = NUMVAL(fh_to_uint32(val));
 
   if (int32_bit >= pow(2, 31))
     return JSNUM(int32_bit - pow(2, 32));
@@ -396,11 +417,11 @@ fh_to_uint32(js_val *val)
   long long pos_int, int32_bit;
 
   val = fh_to_number(val);
-  if (IS_NAN(val) || IS_INF(val) || val->number.val == 0)
+  if (IS_NAN(val) || IS_INF(val) || NUMVAL(val) == 0)
     return JSNUM(0);
 
-  int sign = val->number.val < 0 ? -1 : 1;
-  pos_int = sign * floor(fabs(val->number.val));
+  int sign = NUMVAL(val) < 0 ? -1 : 1;
+  pos_int = sign * floor(fabs(NUMVAL(val)));
   int32_bit = fmod(pos_int, pow(2, 32));
 
   return JSNUM(int32_bit);
@@ -412,21 +433,21 @@ fh_to_string(js_val *val)
   if (IS_UNDEF(val)) return JSSTR("undefined");
   if (IS_NULL(val)) return JSSTR("null");
   if (IS_BOOL(val)) {
-    if (val->boolean.val == 1) return JSSTR("true");
+    if (BOOLVAL(val) == 1) return JSSTR("true");
     return JSSTR("false");
   }
   if (IS_NUM(val)) {
     // TODO: check spec
-    if (val->number.is_nan) return JSSTR("NaN");
-    if (val->number.is_inf) return JSSTR("Infinity");
+    if (IS_NAN(val)) return JSSTR("NaN");
+    if (IS_INF(val)) return JSSTR("Infinity");
     char *fmt = "%f";
-    if (fmod(val->number.val, 1) == 0)
+    if (fmod(NUMVAL(val), 1) == 0)
       fmt = "%.0f";
-    if (fabs(val->number.val) > 1e21)
+    if (fabs(NUMVAL(val)) > 1e21)
       fmt = "%g";
-    int size = snprintf(NULL, 0, fmt, val->number.val) + 1;
+    int size = snprintf(NULL, 0, fmt, NUMVAL(val)) + 1;
     char *num = malloc(size);
-    snprintf(num, size, fmt, val->number.val);
+    snprintf(num, size, fmt, NUMVAL(val));
     num[size - 1] = '\0';
     return JSSTR(num);
   }
@@ -446,17 +467,21 @@ fh_to_object(js_val *val)
 
   js_val *obj = JSOBJ();
   obj->object.primitive = val;
+  fh_gc_barrier(obj, val);
   if (IS_BOOL(val)) {
     fh_set_class(obj, "Boolean");
     obj->proto = fh_try_get_proto("Boolean");
+    fh_gc_barrier(obj, obj->proto);
   }
   if (IS_NUM(val)) {
     fh_set_class(obj, "Number");
     obj->proto = fh_try_get_proto("Number");
+    fh_gc_barrier(obj, obj->proto);
   }
   if (IS_STR(val)) {
     fh_set_class(obj, "String");
     obj->proto = fh_try_get_proto("String");
+    fh_gc_barrier(obj, obj->proto);
   }
   return obj;
 }
@@ -467,7 +492,7 @@ fh_to_boolean(js_val *val)
   if (IS_UNDEF(val) || IS_NULL(val))
     return JSBOOL(0);
   if (IS_NUM(val))
-    return JSBOOL(!IS_NAN(val) && val->number.val != 0);
+    return JSBOOL(!IS_NAN(val) && NUMVAL(val) != 0);
   if (IS_STR(val))
     return JSBOOL(val->string.length != 0);
   if (IS_OBJ(val))
@@ -478,7 +503,7 @@ fh_to_boolean(js_val *val)
 js_val *
 fh_cast(js_val *val, js_type type)
 {
-  if (val->type == type) return val;
+  if (fh_type(val) == type) return val;
 
   switch (type) {
     case T_NULL: return JSNULL();
@@ -491,6 +516,85 @@ fh_cast(js_val *val, js_type type)
 }
 
 
+// ----------------------------------------------------------------------------
+// Typed Array Elements
+// ----------------------------------------------------------------------------
+
+// Stores convert the value to a number and then to the element type: integers
+// wrap around modulo their size, except in Uint8ClampedArrays, which round to
+// the nearest integer (ties to even) within 0-255. Bytes are copied in and out
+// since views and DataViews needn't be aligned.
+
+static const unsigned elem_sizes[] = {
+  [TA_NONE] = 1,
+  [TA_INT8] = 1, [TA_UINT8] = 1, [TA_UINT8_CLAMPED] = 1,
+  [TA_INT16] = 2, [TA_UINT16] = 2,
+  [TA_INT32] = 4, [TA_UINT32] = 4,
+  [TA_FLOAT32] = 4, [TA_FLOAT64] = 8
+};
+
+unsigned
+fh_elem_size(js_elem_type type)
+{
+  return elem_sizes[type];
+}
+
+js_val *
+fh_read_elem(js_elem_type type, unsigned char *bytes)
+{
+  int8_t i8; uint8_t u8; int16_t i16; uint16_t u16;
+  int32_t i32; uint32_t u32; float f32; double f64;
+
+  switch (type) {
+    case TA_INT8: memcpy(&i8, bytes, 1); return JSNUM(i8);
+    case TA_NONE:
+    case TA_UINT8:
+    case TA_UINT8_CLAMPED: memcpy(&u8, bytes, 1); return JSNUM(u8);
+    case TA_INT16: memcpy(&i16, bytes, 2); return JSNUM(i16);
+    case TA_UINT16: memcpy(&u16, bytes, 2); return JSNUM(u16);
+    case TA_INT32: memcpy(&i32, bytes, 4); return JSNUM(i32);
+    case TA_UINT32: memcpy(&u32, bytes, 4); return JSNUM(u32);
+    case TA_FLOAT32: memcpy(&f32, bytes, 4); return JSNUM(f32);
+    case TA_FLOAT64: memcpy(&f64, bytes, 8); return JSNUM(f64);
+  }
+  UNREACHABLE();
+  return JSUNDEF();
+}
+
+// The low 32 bits of a number's integer part, as in ToUint32.
+static uint32_t
+wrap_uint32(double d)
+{
+  if (isnan(d) || isinf(d)) return 0;
+  d = fmod(trunc(d), 4294967296.0);
+  return d < 0 ? (uint32_t)(d + 4294967296.0) : (uint32_t)d;
+}
+
+void
+fh_write_elem(js_elem_type type, unsigned char *bytes, js_val *val)
+{
+  double d = NUMVAL(TO_NUM(val));
+  uint32_t bits = wrap_uint32(d);
+  uint8_t u8; uint16_t u16; float f32;
+
+  switch (type) {
+    case TA_NONE:
+    case TA_INT8:
+    case TA_UINT8: u8 = bits; memcpy(bytes, &u8, 1); break;
+    case TA_UINT8_CLAMPED:
+      u8 = isnan(d) || d <= 0 ? 0 : d >= 255 ? 255 : nearbyint(d);
+      memcpy(bytes, &u8, 1);
+      break;
+    case TA_INT16:
+    case TA_UINT16: u16 = bits; memcpy(bytes, &u16, 2); break;
+    case TA_INT32:
+    case TA_UINT32: memcpy(bytes, &bits, 4); break;
+    case TA_FLOAT32: f32 = d; memcpy(bytes, &f32, 4); break;
+    case TA_FLOAT64: memcpy(bytes, &d, 8); break;
+  }
+}
+
+
 // ----------------------------------------------------------------------------
 // Error Handling
 // ----------------------------------------------------------------------------
@@ -504,12 +608,15 @@ fh_throw(eval_state *state, js_val *error)
     if (tmp->catch) {
       fh_set(tmp->ctx, "FH_LAST_ERROR", error);
 
-      // Pop all frames up to and including the catch.
+      // Pop all frames up to and including the catch. The jump target is
+      // copied out first since popping frees the state holding it.
+      jmp_buf jmp;
+      memcpy(jmp, tmp->jmp, sizeof(jmp_buf));
       while (fh->callstack != tmp)
         fh_pop_state();
       fh_pop_state();
 
-      longjmp(tmp->jmp, 1);
+      longjmp(jmp, 1);
       UNREACHABLE();
     }
     tmp = tmp->parent;
@@ -531,6 +638,8 @@ fh_throw(eval_state *state, js_val *error)
   // Catch errors within REPL: clear callstack and start over.
   if (fh->opt_interactive) {
     fh->callstack = NULL;
+    fh->signal = S_NONE;
+    fh_close_scope(0);
     longjmp(fh->repl_jmp, 1);
   }
   exit(1);
@@ -545,7 +654,7 @@ char *
 fh_typeof(js_val *value)
 {
   /* Per Table 20 of the ECMA5 spec: */
-  switch (value->type) {
+  switch (fh_type(value)) {
     case T_OBJECT:
     case T_NULL:
       return IS_FUNC(value) ? "function" : "object";
@@ -600,6 +709,12 @@ fh_try_get_proto(char *type)
     return fh->object_proto;
   if (STREQ(type, "Array") && fh->array_proto)
     return fh->array_proto;
+  if (STREQ(type, "String") && fh->string_proto)
+    return fh->string_proto;
+  if (STREQ(type, "Number") && fh->number_proto)
+    return fh->number_proto;
+  if (STREQ(type, "Boolean") && fh->boolean_proto)
+    return fh->boolean_proto;
 
   js_val *global = fh->global;
   if (global != NULL) {
@@ -610,14 +725,36 @@ fh_try_get_proto(char *type)
   return NULL;
 }
 
+/* Returns the prototype of any value. Immediates don't have a slot to store
+ * one, so we hand back the cached builtin prototype for their type. */
+js_val *
+fh_proto_of(js_val *val)
+{
+  if (IS_HEAP(val)) return val->proto;
+  if (IS_NUM(val)) return fh->number_proto;
+  if (IS_BOOL(val)) return fh->boolean_proto;
+  return NULL;
+}
+
 void
 fh_set_len(js_val *val, unsigned long len)
 {
   if (IS_STR(val))
     val->string.length = len;
-  if (IS_ARR(val))
+  if (IS_ARR(val)) {
+    // Truncating an array drops the elements past its new end.
+    unsigned long i, end = MIN(val->object.length, val->object.capacity);
+    for (i = len; i < end; i++)
+      val->object.elements[i] = NULL;
     val->object.length = len;
-  fh_set_prop(val, "length", JSNUM(len), 0);
+  }
+  // An array's length can be assigned to; a string's or function's can't.
+  // Storing it may allocate a shape, so keep the new number rooted till then.
+  size_t scope = fh_open_scope();
+  js_val *num = fh_root(JSNUM(len));
+  fh_set_prop_key(val, fh_atom_key(fh->names.length), num,
+                  IS_ARR(val) ? P_WRITE : P_NONE);
+  fh_close_scope(scope);
 }
 
 void
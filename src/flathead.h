@@ -26,6 +26,9 @@
 #include <setjmp.h>
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 
 #include "../ext/uthash.h"
 #include "version.h"
@@ -34,35 +37,47 @@
 #define INFINITY       (1.0/0.0)
 #endif
 
-#define MAX_ARENAS     10
+#ifndef NAN
+#define NAN            (0.0/0.0)
+#endif
+
+// NaN-boxing needs 64-bit pointers. Elsewhere numbers are boxed on the heap.
+#if UINTPTR_MAX > 0xFFFFFFFFu && !defined(FH_NO_NAN_BOXING)
+#define FH_NAN_BOXING
+#endif
 
-#define JSBOOL(x)      fh_new_boolean(x)
+#define JSBOOL(x)      ((x) ? FH_TRUE : FH_FALSE)
 #define JSSTR(x)       fh_new_string(x)
-#define JSNULL()       fh_new_val(T_NULL)
-#define JSUNDEF()      fh_new_val(T_UNDEF)
-#define JSNUM(x)       fh_new_number((x),0,0,0)
-#define JSNAN()        fh_new_number(0,1,0,0)
-#define JSINF()        fh_new_number(INFINITY,0,1,0)
-#define JSNINF()       fh_new_number(-INFINITY,0,1,1)
+#define JSNULL()       FH_NULL
+#define JSUNDEF()      FH_UNDEF
+#define JSNUM(x)       fh_new_number(x)
+#define JSNAN()        fh_new_number(NAN)
+#define JSINF()        fh_new_number(INFINITY)
+#define JSNINF()       fh_new_number(-INFINITY)
 #define JSOBJ()        fh_new_object()
 #define JSARR()        fh_new_array()
 #define JSFUNC(x)      fh_new_function(x)
 #define JSNFUNC(x,n)   fh_new_native_function((x),(n))
 #define JSRE(x)        fh_new_regexp(x)
-#define JSNUMKEY(x)    fh_cast(JSNUM(x), T_STRING)
-
-#define IS_STR(x)      ((x)->type == T_STRING)
-#define IS_NUM(x)      ((x)->type == T_NUMBER)
-#define IS_BOOL(x)     ((x)->type == T_BOOLEAN)
-#define IS_NULL(x)     ((x)->type == T_NULL)
-#define IS_UNDEF(x)    ((x)->type == T_UNDEF)
-#define IS_OBJ(x)      ((x)->type == T_OBJECT)
-#define IS_FUNC(x)     ((x)->type == T_OBJECT && STREQ((x)->object.class, "Function"))
-#define IS_ARR(x)      ((x)->type == T_OBJECT && STREQ((x)->object.class, "Array"))
-#define IS_REGEXP(x)   ((x)->type == T_OBJECT && STREQ((x)->object.class, "RegExp"))
-#define IS_DATE(x)     ((x)->type == T_OBJECT && STREQ((x)->object.class, "Date"))
-#define IS_NAN(x)      ((x)->type == T_NUMBER && (x)->number.is_nan)
-#define IS_INF(x)      ((x)->type == T_NUMBER && (x)->number.is_inf)
+
+#define IS_HEAP(x)     ((uintptr_t)(x) > FH_IMM_MAX && !FH_IS_BOXED_NUM(x))
+#define IS_STR(x)      (IS_HEAP(x) && (x)->type == T_STRING)
+#define IS_NUM(x)      fh_is_number(x)
+#define IS_BOOL(x)     ((x) == FH_TRUE || (x) == FH_FALSE)
+#define IS_NULL(x)     ((x) == FH_NULL)
+#define IS_UNDEF(x)    ((x) == FH_UNDEF)
+#define IS_OBJ(x)      (IS_HEAP(x) && (x)->type == T_OBJECT)
+#define IS_FUNC(x)     (IS_OBJ(x) && STREQ((x)->object.class, "Function"))
+#define IS_ARR(x)      (IS_OBJ(x) && STREQ((x)->object.class, "Array"))
+#define IS_REGEXP(x)   (IS_OBJ(x) && STREQ((x)->object.class, "RegExp"))
+#define IS_DATE(x)     (IS_OBJ(x) && STREQ((x)->object.class, "Date"))
+#define IS_TYPED(x)    (IS_OBJ(x) && (x)->object.binary && \
+                        (x)->object.binary->type != TA_NONE)
+#define IS_NAN(x)      (IS_NUM(x) && isnan(NUMVAL(x)))
+#define IS_INF(x)      (IS_NUM(x) && isinf(NUMVAL(x)))
+
+#define NUMVAL(x)      fh_number_value(x)
+#define BOOLVAL(x)     ((x) == FH_TRUE)
 
 #define TO_STR(x)      fh_cast((x),T_STRING)
 #define TO_NUM(x)      fh_cast((x),T_NUMBER)
@@ -85,7 +100,10 @@
 #define ARGLEN(args)   args_len(args)
 
 #define STREQ(a,b)     (strcmp((a),(b)) == 0)
-#define OBJ_ITER(o,p)  js_prop *_tmp; HASH_ITER(hh,(o)->map,(p),_tmp)
+#define OBJ_ITER(o,p)  \
+  for (js_prop_iter _it = fh_iter_props(o); ((p) = fh_next_prop(&_it)); )
+#define MAP_ITER(o,p)  \
+  for (js_prop_iter _it = fh_iter_map(o); ((p) = fh_next_prop(&_it)); )
 
 #define DEF(o,k,v)     fh_set_prop((o),(k),(v),P_BUILTIN)
 #define DEF2(o,k,v,f)  fh_set_prop((o),(k),(v),(f))
@@ -96,6 +114,9 @@
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+// 2^32 - 1, the first number that isn't an array index.
+#define ARRAY_INDEX_MAX 4294967295UL
+
 
 struct js_val;
 struct js_args;
@@ -109,8 +130,17 @@ typedef enum {
   GC_STATE_NONE
 } gc_state;
 
+// Each GC arena holds cells of a single size class.
+typedef enum {
+  GC_CELL_SMALL,    // strings and number boxes
+  GC_CELL_OBJECT,
+  GC_NUM_CELL_CLASSES
+} gc_cell_class;
+
 typedef enum {
   S_BREAK = 1,
+  S_CONTINUE,
+  S_RETURN,
   S_NOOP,
   S_NONE
 } ctl_signal;
@@ -136,8 +166,32 @@ typedef enum {
 
 typedef struct {
   gc_state gc_state;
-  struct gc_arena *gc_arenas[MAX_ARENAS];
+  struct gc_arena **gc_arenas;        // grows as the heap does
   int gc_num_arenas;
+  int gc_arenas_cap;
+  struct gc_arena *gc_alloc_arenas[GC_NUM_CELL_CLASSES]; // arenas in use
+  size_t gc_heap_size;                // bytes held by all arenas
+  size_t gc_last_reclaimed;           // bytes freed by the last sweep
+  size_t gc_total_reclaimed;
+  struct js_val **gc_mark_stack;      // values marked but not yet scanned
+  size_t gc_mark_top;
+  size_t gc_mark_cap;
+  bool gc_mark_overflow;
+  struct js_val **gc_roots;           // values held by C code (see gc.h)
+  size_t gc_roots_top;
+  size_t gc_roots_cap;
+  bool gc_minor;                      // collecting the young generation only
+  int gc_step_allocs;                 // allocations since the last step
+  int gc_sweep_pending;               // arenas left to sweep
+  bool gc_sweep_minor;                // ...and whether only young cells
+  bool gc_major_requested;            // start a major collection after it
+  long gc_live[GC_NUM_CELL_CLASSES];  // cells in use once swept
+  int gc_steps;
+  struct js_val **gc_remembered;      // old values that point at young ones
+  size_t gc_remembered_len;
+  size_t gc_remembered_cap;
+  int gc_minor_runs;
+  int gc_major_runs;
   int gc_runs;
   long gc_last_start;
   long gc_time;
@@ -146,16 +200,28 @@ typedef struct {
   bool opt_print_tokens;
   bool opt_print_ast;
   bool opt_keep_history_file;
+  size_t opt_max_heap;                // heap ceiling in bytes, 0 for none
+  long opt_gc_step_us;                // incremental GC step budget, 0 for none
   const char *opt_history_filename;
 
   jmp_buf repl_jmp;                   // used to handle errors within REPL
   char *script_name;
   struct eval_state *callstack;
+  ctl_signal signal;                  // pending break, continue or return
 
   struct js_val *function_proto;    // cache prototype pointers
   struct js_val *object_proto;
   struct js_val *array_proto;
+  struct js_val *string_proto;
+  struct js_val *number_proto;
+  struct js_val *boolean_proto;
   struct js_val *global;
+  struct js_shape *empty_shape;       // the root of the shape tree
+  unsigned long dict_epoch;           // bumped when dictionary props are freed
+  struct js_method_entry *method_cache; // lookups made without a node's cache
+  struct {                            // atoms for names used on every call
+    char *length, *prototype, *this, *arguments, *callee;
+  } names;
 } fh_state;
 
 typedef struct eval_state {
@@ -179,14 +245,139 @@ typedef struct {
   bool configurable;
   bool circular;
   struct js_val *ptr;
-  UT_hash_handle hh;
 } js_prop;
 
+/* Objects that add the same property names in the same order share a shape,
+ * which maps each name to a slot in the object's vector of props. Shapes form
+ * a tree of transitions from the empty shape, one property at a time, and are
+ * never freed. Objects that outgrow them switch to dictionary mode, where the
+ * props live in a hash table instead (see props.c).
+ */
+typedef struct js_shape {
+  struct js_shape *parent;            // the shape without the last property
+  struct js_shape *transitions;       // shapes with one more property
+  struct js_shape *sibling;           // next transition of the parent
+  char *name;                         // the last property, in slot count-1
+  unsigned count;
+  unsigned num_transitions;
+  unsigned *table;                    // slot+1 by name hash, built on demand
+  unsigned table_size;
+  struct js_enum_cache *enum_cache;   // for-in names, by prototype shapes
+} js_shape;
+
+typedef struct {
+  js_prop prop;
+  UT_hash_handle hh;
+} js_dict_prop;
+
+typedef struct {
+  struct js_val *obj;
+  unsigned slot;                      // next slot, in shape mode
+  char *slot_name;                    // ...and its name
+  js_dict_prop *next;                 // next entry, in dictionary mode
+  bool dict;
+  bool elements;                      // still visiting an array's elements
+  unsigned long elem;                 // ...the next one
+  js_prop view;                       // ...the current one, as a prop
+  char index[24];                     // ...and its name
+} js_prop_iter;
+
+/* The names a for-in loop visits on objects of a shape, in order: the object's
+ * own props, then those of each prototype not shadowed by an earlier one. They
+ * only depend on the shapes along the chain, so each receiver shape keeps a
+ * few lists, one per run of prototype shapes. Attributes aren't part of a
+ * shape, so whether a name is enumerable is checked as it's visited.
+ */
+#define ENUM_CACHE_WAYS 4
+#define ENUM_MAX_DEPTH 8
+
+typedef struct {
+  char *name;                         // an atom
+  unsigned depth;                     // prototypes followed to the holder
+  unsigned slot;                      // ...and its slot there
+} js_enum_key;
+
+typedef struct js_enum_cache {
+  struct js_enum_cache *next;
+  js_shape *shapes[ENUM_MAX_DEPTH + 1]; // each object on the chain
+  unsigned depth;                     // the number of prototypes
+  unsigned count;
+  js_enum_key keys[];
+} js_enum_cache;
+
+typedef struct {
+  struct js_val *obj;                 // the receiver
+  struct js_val *holder;              // the object being visited
+  unsigned depth;                     // ...and how far up the chain it is
+  js_enum_cache *cache;               // the names to visit, if cached
+  unsigned next;                      // ...the next of them
+  struct js_val *chain[ENUM_MAX_DEPTH + 1];
+  js_prop_iter props;                 // the holder's props, if not cached
+} js_enum_iter;
+
+/* Inline caches remember where a lookup from a given AST node found its prop:
+ * the shapes along the scope or prototype chain up to the object holding it,
+ * and its slot there. A holder in dictionary mode is remembered by address,
+ * along with the entry, for as long as no dictionary entry is freed (see
+ * `dict_epoch`). Each node caches a few such paths.
+ */
+#define IC_WAYS 4
+#define IC_MAX_DEPTH 8
+
+typedef struct {
+  js_shape *shapes[IC_MAX_DEPTH + 1]; // each object on the way, holder last
+  struct js_val *holder;              // the holder, if in dictionary mode
+  js_prop *prop;                      // ...and its entry
+  unsigned depth;                     // links followed to the holder
+  unsigned slot;
+  unsigned long epoch;
+} js_ic_entry;
+
+typedef struct js_ic {
+  js_ic_entry entries[IC_WAYS];
+  unsigned count;
+  unsigned next;                      // the entry to replace when full
+} js_ic;
+
+/* Prototype chain lookups with no node to cache them, such as the runtime's
+ * own method and property lookups, share one table of paths instead, indexed
+ * by the receiver's shape and the name looked up. The paths are checked the
+ * same way, so changes to a prototype's props are noticed when probing.
+ */
+#define METHOD_CACHE_SIZE 512
+
+typedef struct js_method_entry {
+  js_shape *shape;                    // the receiver's
+  char *name;                         // an atom
+  js_ic_entry path;
+} js_method_entry;
+
+/* Binary data. An ArrayBuffer owns its bytes, while typed arrays and DataViews
+ * view a range of some ArrayBuffer's, which they keep alive. Typed array
+ * elements are stored unboxed, converted to the element type on the way in.
+ */
+typedef enum {
+  TA_NONE,                            // an ArrayBuffer or DataView
+  TA_INT8,
+  TA_UINT8,
+  TA_UINT8_CLAMPED,
+  TA_INT16,
+  TA_UINT16,
+  TA_INT32,
+  TA_UINT32,
+  TA_FLOAT32,
+  TA_FLOAT64
+} js_elem_type;
+
+typedef struct {
+  unsigned char *bytes;               // where the data starts
+  unsigned long byte_length;
+  struct js_val *buffer;              // the ArrayBuffer viewed, NULL for one
+  js_elem_type type;
+} js_binary;
+
 typedef struct {
   double val;
-  bool is_nan;
-  bool is_inf;
-  bool is_neg;
 } js_number;
 
 typedef struct {
@@ -194,10 +385,6 @@ typedef struct {
   char *ptr;
 } js_string;
 
-typedef struct {
-  bool val;
-} js_boolean;
-
 /* The standard API for natively defined functions provides an instance (when
  * applicable), the arguments as values in linked-list format, and the evaluation
  * state, which contains information that may be used for error reporting.
@@ -209,7 +396,7 @@ typedef struct {
   bool generator;
   bool provide_this;
   bool extensible;            // [[Extensible]]
-  char class[10];             // [[Class]]
+  char class[18];             // [[Class]]
   struct js_val *primitive;   // [[PrimitiveValue]]
   struct js_val *bound_this;  // [[BoundThis]]
   struct js_args *bound_args; // [[BoundArguments]]
@@ -218,30 +405,116 @@ typedef struct {
   struct js_val *parent;
   struct ast_node *node;
   unsigned long length;
+  struct js_val **elements;   // array elements by index, NULL for holes
+  unsigned long capacity;     // ...and the room for them
+  bool sparse;                // some indices are held as props instead
+  js_binary *binary;          // ArrayBuffer, typed array and DataView data
   js_native_function *nativefn;
 } js_object;
 
-/* TODO: Store non-objects more efficiently. A lot of space is currenlty wasted
- * for JS primitives. `js_val` should only store a pointer to the `js_obj`.
- * Maybe the GC can keep separate heaps for objects and values. */
+/* Heap cells share a small header followed by the type-specific payload. The
+ * GC allocates each cell class from its own arenas, sized to fit, so strings
+ * and number boxes only take up the header plus their own member of the union
+ * (see `fh_cell_size`). Never copy a `js_val` by value or touch a member that
+ * doesn't belong to its type: the cell may be shorter than `sizeof(js_val)`.
+ */
 
 typedef struct js_val {
-  js_number number;
-  js_string string;
-  js_boolean boolean;
-  js_object object;
   js_type type;
-  ctl_signal signal;
-  struct js_val *proto;
   bool marked;
   bool flagged;
-  js_prop *map;
+  bool old;                           // survived a collection
+  bool remembered;                    // old, and in the remembered set
+  struct js_val *proto;
+  js_shape *shape;                    // NULL in dictionary mode
+  js_prop *map;                       // slots, or a js_dict_prop hash table
+  union {
+    js_number number;
+    js_string string;
+    js_object object;
+  };
 } js_val;
 
+/* Immediate values
+ *
+ * A `js_val *` doesn't always point into the heap. Booleans, null and
+ * undefined are small constants that no real allocation can have, and on
+ * 64-bit builds numbers are NaN-boxed into the pointer itself: the bits of the
+ * double are offset by 2^49 so that every number has a non-zero top 16 bits,
+ * which user-space pointers never do. (NaNs are canonicalized first so the
+ * offset can't wrap around.) None of these go through `fh_malloc` and none of
+ * them may be dereferenced, so use the IS_* and *VAL macros instead of
+ * reaching into the struct.
+ */
+
+#define FH_NULL        ((js_val *)0x02)
+#define FH_FALSE       ((js_val *)0x06)
+#define FH_TRUE        ((js_val *)0x07)
+#define FH_UNDEF       ((js_val *)0x0a)
+#define FH_IMM_MAX     0x0f
+
+#ifdef FH_NAN_BOXING
+
+#define FH_NUM_OFFSET  ((uint64_t)1 << 49)
+#define FH_NUM_MASK    ((uint64_t)0xffff << 48)
+#define FH_IS_BOXED_NUM(x) (((uint64_t)(uintptr_t)(x) & FH_NUM_MASK) != 0)
+
+static inline js_val *
+fh_new_number(double x)
+{
+  uint64_t bits;
+  if (isnan(x)) x = NAN;
+  memcpy(&bits, &x, sizeof(bits));
+  return (js_val *)(uintptr_t)(bits + FH_NUM_OFFSET);
+}
+
+static inline bool
+fh_is_number(js_val *val)
+{
+  return FH_IS_BOXED_NUM(val);
+}
+
+static inline double
+fh_number_value(js_val *val)
+{
+  uint64_t bits = (uint64_t)(uintptr_t)val - FH_NUM_OFFSET;
+  double x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+#else
+
+#define FH_IS_BOXED_NUM(x) false
+
+js_val * fh_new_number(double);
+
+static inline bool
+fh_is_number(js_val *val)
+{
+  return (uintptr_t)val > FH_IMM_MAX && val->type == T_NUMBER;
+}
+
+static inline double
+fh_number_value(js_val *val)
+{
+  return val->number.val;
+}
+
+#endif
+
+static inline js_type
+fh_type(js_val *val)
+{
+  if (IS_HEAP(val)) return val->type;
+  if (IS_NUM(val)) return T_NUMBER;
+  if (IS_BOOL(val)) return T_BOOLEAN;
+  if (IS_NULL(val)) return T_NULL;
+  return T_UNDEF;
+}
+
 js_val * fh_new_val(js_type);
-js_val * fh_new_number(double, bool, bool, bool);
 js_val * fh_new_string(char *);
-js_val * fh_new_boolean(bool);
 js_val * fh_new_object();
 js_val * fh_new_array();
 js_val * fh_new_function(struct ast_node *);
@@ -249,7 +522,6 @@ js_val * fh_new_native_function(js_native_function, int);
 js_val * fh_new_regexp(char *);
 js_val * fh_new_error(char *, const char *, ...);
 
-js_prop * fh_new_prop(js_prop_flags);
 fh_state * fh_new_global_state();
 
 eval_state * fh_new_state(int, int);
@@ -259,6 +531,7 @@ void fh_pop_state();
 js_val * fh_eval_file(FILE *, js_val *);
 js_val * fh_eval_string(char *, js_val *);
 js_val * fh_try_get_proto(char *);
+js_val * fh_proto_of(js_val *);
 
 bool fh_is_callable(js_val *);
 js_val * fh_to_primitive(js_val *, js_type);
@@ -266,6 +539,9 @@ js_val * fh_to_number(js_val *);
 js_val * fh_to_int(js_val *);
 js_val * fh_to_int32(js_val *);
 js_val * fh_to_uint32(js_val *);
+unsigned fh_elem_size(js_elem_type);
+js_val * fh_read_elem(js_elem_type, unsigned char *);
+void fh_write_elem(js_elem_type, unsigned char *, js_val *);
 js_val * fh_to_string(js_val *);
 js_val * fh_to_boolean(js_val *);
 js_val * fh_to_object(js_val *);
@@ -0,0 +1,203 @@
+/*
+ * frame.c -- Static resolution of function locals
+ *
+ * Copyright (c) 2012-2017 Nick Reynolds
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "frame.h"
+#include "props.h"
+#include "str.h"
+
+// The names of a frame so far, each once, with the attributes a call gives
+// them.
+typedef struct {
+  char **names;
+  js_prop_flags *flags;
+  unsigned count;
+  unsigned cap;
+} locals;
+
+static int
+find_local(locals *l, char *name)
+{
+  unsigned i;
+  for (i = 0; i < l->count; i++)
+    if (l->names[i] == name) return i;
+  return -1;
+}
+
+static unsigned
+add_local(locals *l, char *name, js_prop_flags flags)
+{
+  int slot = find_local(l, name);
+  if (slot >= 0) return slot;
+
+  if (l->count == l->cap) {
+    l->cap = l->cap ? l->cap * 2 : 8;
+    l->names = realloc(l->names, l->cap * sizeof(char *));
+    l->flags = realloc(l->flags, l->cap * sizeof(js_prop_flags));
+  }
+  l->names[l->count] = name;
+  l->flags[l->count] = flags;
+  return l->count++;
+}
+
+
+// ----------------------------------------------------------------------------
+// Scanning a Body
+// ----------------------------------------------------------------------------
+
+// The walks below stay out of nested functions, which have frames of their own.
+
+// Code that mentions `arguments`, or might run eval, needs an arguments object.
+static bool
+needs_arguments(ast_node *node, char *eval)
+{
+  if (node == NULL || node->type == NODE_FUNC) return false;
+  if (node->type == NODE_IDENT &&
+      (node->sval == fh->names.arguments || (eval && node->sval == eval)))
+    return true;
+  unsigned i;
+  for (i = 0; i < node->count; i++)
+    if (needs_arguments(node->items[i], eval)) return true;
+  return needs_arguments(node->e1, eval) || needs_arguments(node->e2, eval) ||
+    needs_arguments(node->e3, eval);
+}
+
+// Function declarations are the function statements of the body itself.
+static bool
+is_func_dec(ast_node *item)
+{
+  return item->type == NODE_FUNC && item->e3 && item->e3->sval;
+}
+
+// Vars are declared wherever they are in the body.
+static void
+add_vars(locals *l, ast_node *node)
+{
+  if (node == NULL || node->type == NODE_FUNC) return;
+  if (node->type == NODE_VAR_DEC)
+    add_local(l, node->e1->sval, P_WRITE | P_ENUM);
+  add_vars(l, node->e1);
+  add_vars(l, node->e2);
+  add_vars(l, node->e3);
+  unsigned i;
+  for (i = 0; i < node->count; i++) add_vars(l, node->items[i]);
+}
+
+static void
+resolve_idents(locals *l, ast_node *node)
+{
+  if (node == NULL || node->type == NODE_FUNC) return;
+  if (node->type == NODE_IDENT) {
+    int slot = find_local(l, node->sval);
+    if (slot >= 0) node->slot = slot + 1;
+  }
+  resolve_idents(l, node->e1);
+  resolve_idents(l, node->e2);
+  resolve_idents(l, node->e3);
+  unsigned i;
+  for (i = 0; i < node->count; i++) resolve_idents(l, node->items[i]);
+}
+
+
+// ----------------------------------------------------------------------------
+// Declarations
+// ----------------------------------------------------------------------------
+
+/* Find the declarations a source list hoists (see frame.h). */
+js_decls *
+fh_declare(ast_node *body)
+{
+  js_decls *decls = calloc(1, sizeof(js_decls));
+  locals vars = {NULL, NULL, 0, 0};
+  unsigned i;
+
+  decls->funcs = malloc((body->count + 1) * sizeof(ast_node *));
+  for (i = 0; i < body->count; i++)
+    if (is_func_dec(body->items[i]))
+      decls->funcs[decls->num_funcs++] = body->items[i];
+
+  add_vars(&vars, body);
+  decls->vars = vars.names;
+  decls->num_vars = vars.count;
+  free(vars.flags);
+  return decls;
+}
+
+
+// ----------------------------------------------------------------------------
+// Frames
+// ----------------------------------------------------------------------------
+
+/* Lay out a function's frame and resolve the identifiers in its body that
+ * name its locals. Functions with more locals than an object in shape mode
+ * can hold get a frame with no shape, and their calls build scopes the slow
+ * way.
+ */
+js_frame *
+fh_resolve(ast_node *func)
+{
+  js_frame *frame = calloc(1, sizeof(js_frame));
+  ast_node *body = func->e2;
+  locals l = {NULL, NULL, 0, 0};
+
+  add_local(&l, fh->names.this, P_DEFAULT);
+  frame->arguments = needs_arguments(body, fh_find_atom("eval")) ?
+    (int)add_local(&l, fh->names.arguments, P_DEFAULT) : -1;
+
+  if (func->e1) {
+    unsigned i;
+    frame->num_params = func->e1->count;
+    frame->params = calloc(frame->num_params, sizeof(unsigned));
+    for (i = 0; i < frame->num_params; i++)
+      frame->params[i] = add_local(&l, func->e1->items[i]->sval, P_DEFAULT);
+  }
+  if (body) {
+    unsigned i;
+    if (!body->decls) body->decls = fh_declare(body);
+    js_decls *decls = frame->decls = body->decls;
+    frame->funcs = calloc(decls->num_funcs + 1, sizeof(unsigned));
+    for (i = 0; i < decls->num_funcs; i++)
+      frame->funcs[i] = add_local(&l, decls->funcs[i]->e3->sval, P_WRITE | P_ENUM);
+    for (i = 0; i < decls->num_vars; i++)
+      add_local(&l, decls->vars[i], P_WRITE | P_ENUM);
+  }
+
+  // A named function expression can refer to itself by name, unless one of
+  // its locals takes the name. Assigning to it does nothing.
+  frame->self = -1;
+  if (func->val && func->e3 && find_local(&l, func->e3->sval) < 0)
+    frame->self = add_local(&l, func->e3->sval, P_NONE);
+
+  frame->shape = fh_shape_of(l.names, l.count);
+  if (frame->shape) {
+    unsigned i;
+    frame->locals = calloc(l.count, sizeof(js_prop));
+    for (i = 0; i < l.count; i++) {
+      js_prop *prop = &frame->locals[i];
+      prop->name = l.names[i];
+      prop->writable = l.flags[i] & P_WRITE;
+      prop->enumerable = l.flags[i] & P_ENUM;
+      prop->configurable = l.flags[i] & P_CONF;
+      prop->ptr = JSUNDEF();
+    }
+    resolve_idents(&l, body);
+  }
+
+  free(l.names);
+  free(l.flags);
+  return frame;
+}
@@ -0,0 +1,68 @@
+/*
+ * frame.h -- Static resolution of function locals
+ *
+ * Copyright (c) 2012-2017 Nick Reynolds
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "flathead.h"
+#include "nodes.h"
+
+/* The declarations a source list (a program, a function's body or eval'd
+ * code) hoists into the scope it runs in: its function statements, and the
+ * names of the vars anywhere in it but nested functions, each once. They're
+ * found the first time it runs, rather than every time.
+ */
+typedef struct js_decls {
+  ast_node **funcs;
+  unsigned num_funcs;
+  char **vars;
+  unsigned num_vars;
+} js_decls;
+
+/* A function's frame is the set of names its calls define in their own
+ * scope: `this`, `arguments`, its params, the vars and functions it declares,
+ * and a named function expression's own name. They're known from its source,
+ * so each call's scope object starts out with all of them, in the same slots,
+ * copied from a template rather than added one at a time. Identifiers in the
+ * body that name one of them are given its slot. Only functions that mention
+ * `arguments`, or might call eval, get an arguments object.
+ *
+ * A scope's parent is the caller's scope, so names from any further out can't
+ * be resolved ahead of time. Neither can a slot be trusted blindly, since a
+ * closure runs in the scope it was returned from, and object literals
+ * evaluate their values in a scope of their own: a slot is only used if the
+ * scope being looked in holds that name there (see `fh_get_local`).
+ */
+typedef struct js_frame {
+  js_shape *shape;                    // of a new scope, or NULL if too big
+  js_prop *locals;                    // ...its props as a call starts
+  unsigned *params;                   // the slot of each param, in order
+  unsigned num_params;
+  js_decls *decls;                    // of the body, or NULL if it's empty
+  unsigned *funcs;                    // the slot of each of its functions
+  int arguments;                      // the arguments object's slot, or -1
+  int self;                           // the function's own name's, or -1
+} js_frame;
+
+// `this` always comes first.
+#define FRAME_THIS 0
+
+js_decls * fh_declare(ast_node *);
+js_frame * fh_resolve(ast_node *);
+
+#endif
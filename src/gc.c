@@ -20,6 +20,8 @@
 #include <time.h>
 
 #include "gc.h"
+#include "props.h"
+#include "args.h"
 #include "debug.h"
 
 #ifdef FH_GC_PROFILE
@@ -31,7 +33,7 @@
 #endif
 
 #ifdef FH_GC_PROFILE_VERBOSE
-#define GC_PRINT_VERBOSE(indent, ...) GC_PRINT(indent, ...)
+#define GC_PRINT_VERBOSE(indent, ...) GC_PRINT(indent, __VA_ARGS__)
 #define GC_DEBUG_VERBOSE(indent, val) GC_DEBUG(indent, val)
 #else
 #define GC_PRINT_VERBOSE(indent, ...)
@@ -40,37 +42,100 @@
 
 /* GC Overview
  *
- * Bi-color, non-incremental, mark & sweep, stop-the-world garbage collection.
+ * Tri-color, incremental, generational mark & sweep garbage collection.
  *
  * Arenas
  * ------
  * The global state object keeps an array of pointers to arenas – big
  * contiguous blocks of memory which are slotted to hold Flathead's js_val
- * structs. The arena size is determined by the SLOTS_PER_ARENA define. The
- * size is then that number of slots multiplied by the size of a js_val struct.
- * The system will create arenas on demand, when space cannot be freed from an
- * existing arena, and the MAX_ARENAS define has not been exceeded.
+ * cells. Every arena serves one cell class: objects get full js_val cells,
+ * while strings and number boxes get small cells that stop after the string
+ * member of the union. The arena size is determined by the SLOTS_PER_ARENA
+ * define. The size is then that number of slots multiplied by the cell size.
+ * The system will create arenas on demand, when a collection leaves less than
+ * a quarter of a cell class free, as long as the heap ceiling (--max-heap) is
+ * not exceeded. Arenas left empty by a collection are returned to the OS,
+ * keeping one per cell class.
  *
- * At the start of each arena is a metadata section which stores usage
- * information and the list of vacant slots.
+ * Each arena has a metadata section which stores usage information and a
+ * bitmap of occupied slots.
  *
  * Allocation
  * ----------
+ * The state remembers which arena of each cell class is being allocated
+ * from, and each arena remembers the first bitmap word that may have a vacant
+ * slot. Finding a slot is a `__builtin_ctzll` on the complement of that word,
+ * so allocation doesn't slow down as the heap fills. Sweeping moves the word
+ * cursor back when it frees a slot below it.
+ *
+ * Generations
+ * -----------
+ * Cells allocated since the last collection are young and have their bit set
+ * in their arena's young bitmap. Every cell that survives a collection is
+ * promoted to the old generation. Cells never move, since the interpreter
+ * holds raw pointers to them all over, so promotion is only a flag on the
+ * cell and the young bitmap is cleared after each run.
+ *
+ * When a cell class fills up, a minor collection reclaims young cells only.
+ * Marking stops at old values, and the sweep visits only young slots, so the
+ * pause is proportional to what was allocated since the last run rather than
+ * to the whole heap. A major collection marks and sweeps everything. It runs
+ * instead when old cells take up more than three quarters of the class, or
+ * when the script asks for one through gc.run().
+ *
+ * Old values that are made to point at young ones are put in the remembered
+ * set by the write barrier (`fh_gc_barrier`), which every store of a js_val
+ * into a heap cell goes through. A minor collection treats the remembered
+ * values as extra roots. Since no young values are left after any collection,
+ * the set is emptied every time.
  *
  * Mark Phase
  * ----------
+ * Marking starts at the global object, the scopes on the callstack and the
+ * root stack of values C code is holding onto (see the handle scopes in gc.h).
+ * It is iterative: a value is marked when first reached and pushed onto an
+ * explicit mark stack, and the stack is drained by scanning each popped
+ * value's references. The stack is growable up to GC_MARK_STACK_MAX entries.
+ * Past that, values are still marked but not pushed, and an overflow flag
+ * makes the collector rescan the marked cells of the heap once the stack is
+ * empty. Deep structures like long linked lists can't exhaust the C stack.
+ *
+ * Incremental Marking
+ * -------------------
+ * Values are white (unmarked), gray (marked and waiting on the mark stack) or
+ * black (marked and scanned). A major collection started from fh_malloc
+ * stays in the GC_STATE_MARK state between allocations, and every
+ * GC_STEP_ALLOCS allocations a step scans gray values until the mark stack
+ * is empty or the step has run for --gc-step-us microseconds. Values created
+ * meanwhile are allocated black. The write barrier shades a white value gray
+ * when it's stored into a marked one, so a black value never points at a
+ * white one. Once the stack is empty, the roots are marked again (the
+ * callstack isn't covered by the barrier) and the heap is left to be swept.
+ * A --gc-step-us of 0 turns this off, and major collections then run to
+ * completion as soon as they start.
  *
  * Sweep Phase
  * -----------
+ * Each arena's bitmap is walked a word at a time. Unmarked cells are freed in
+ * place along with their string buffer and property table, and the bytes
+ * released are tallied for gc.info(). Survivors have their mark cleared for
+ * the next run.
+ *
+ * Sweeping is lazy. A collection only flags every arena as needing a sweep,
+ * and an arena is swept when allocation first looks at it for a vacant slot.
+ * In between, every GC_STEP_ALLOCS allocations a step sweeps one more arena,
+ * so that the sweep is done before long even for cell classes that aren't
+ * being allocated. Marks left in unswept arenas can't be told apart from new
+ * ones, so any remaining arenas are swept before the next collection starts.
+ * Survivors are promoted when they're marked rather than when swept, which
+ * keeps the write barrier right in the meantime. gc.run() and a --gc-step-us
+ * of 0 sweep everything straight away.
  *
  * Issues & Enhancement Ideas
  * --------------------------
- * - Arena free lists should be bitmaps. Integer arrays are a huge waste of
- *   space.
  * - Store the color (e.g. black or white) of the js_val instead of explicitly
  *   labeling them marked or unmarked. Then we can flip the color semantics
  *   after each run and save some time unmarking.
- * - Tri- or quad-color incremental algorithm a la LuaJIT.
  * - Utility structs (e.g. js_args, js_prop, eval_state, ast_nodes) need to be
  *   garbage collected or freed by hand, whichever is more appropriate.
  * - Strings need to be stored within the arena somehow. Maybe they can be
@@ -79,56 +144,217 @@
  */
 
 
+// An incremental step checks the clock every GC_STEP_CHECK scanned values,
+// and one step runs every GC_STEP_ALLOCS allocations while marking.
+#define GC_STEP_CHECK 64
+#define GC_STEP_ALLOCS 256
+
+// The mark stack starts small and doubles up to GC_MARK_STACK_MAX entries.
+#define GC_MARK_STACK_MIN 256
+#ifndef GC_MARK_STACK_MAX
+#define GC_MARK_STACK_MAX (1 << 20)
+#endif
+
+// Cell sizes are rounded up so every slot stays aligned for a js_val.
+#define CELL_ALIGN(size) \
+  (((size) + _Alignof(js_val) - 1) & ~(_Alignof(js_val) - 1))
+
+static const size_t cell_sizes[GC_NUM_CELL_CLASSES] = {
+  [GC_CELL_SMALL] = CELL_ALIGN(offsetof(js_val, string) + sizeof(js_string)),
+  [GC_CELL_OBJECT] = sizeof(js_val)
+};
+
+static gc_cell_class
+fh_cell_class(js_type type)
+{
+  return type == T_OBJECT ? GC_CELL_OBJECT : GC_CELL_SMALL;
+}
+
+size_t
+fh_cell_size(js_type type)
+{
+  return cell_sizes[fh_cell_class(type)];
+}
+
+static size_t
+fh_arena_bytes(gc_cell_class cell_class)
+{
+  return sizeof(gc_arena) + SLOTS_PER_ARENA * cell_sizes[cell_class];
+}
+
 static gc_arena *
-fh_new_arena()
+fh_new_arena(gc_cell_class cell_class)
 {
+  size_t bytes = fh_arena_bytes(cell_class);
+  if (fh->opt_max_heap && fh->gc_heap_size + bytes > fh->opt_max_heap)
+    return NULL;
+
   gc_arena *arena = malloc(sizeof(gc_arena));
 
+  arena->cell_class = cell_class;
+  arena->cell_size = cell_sizes[cell_class];
   arena->num_slots = SLOTS_PER_ARENA;
   arena->used_slots = 0;
-
-  memset(arena->freelist, 0, sizeof(arena->freelist));
+  arena->young_slots = 0;
+  arena->needs_sweep = false;
+  arena->next_word = 0;
+  arena->slots = calloc(arena->num_slots, arena->cell_size);
+
+  // Bits past the last slot are permanently set so they're never handed out.
+  memset(arena->used, 0, sizeof(arena->used));
+  memset(arena->young, 0, sizeof(arena->young));
+  if (arena->num_slots % 64)
+    arena->used[GC_BITMAP_WORDS - 1] = ~(uint64_t)0 << (arena->num_slots % 64);
+
+  if (fh->gc_num_arenas == fh->gc_arenas_cap) {
+    fh->gc_arenas_cap = fh->gc_arenas_cap ? fh->gc_arenas_cap * 2 : 8;
+    fh->gc_arenas = realloc(fh->gc_arenas, fh->gc_arenas_cap * sizeof(gc_arena *));
+  }
+  fh->gc_arenas[fh->gc_num_arenas++] = arena;
+  fh->gc_heap_size += bytes;
   return arena;
 }
 
+static void
+fh_free_arena(int index)
+{
+  gc_arena *arena = fh->gc_arenas[index];
+  fh->gc_heap_size -= fh_arena_bytes(arena->cell_class);
+
+  free(arena->slots);
+  free(arena);
+
+  fh->gc_num_arenas--;
+  memmove(&fh->gc_arenas[index], &fh->gc_arenas[index + 1],
+      (fh->gc_num_arenas - index) * sizeof(gc_arena *));
+}
+
+static size_t fh_gc_sweep(gc_arena *);
+
+// Returns an arena of the cell class with a vacant slot, or NULL. The arena
+// is remembered so that allocation only searches again once it fills up.
+// Arenas still waiting to be swept after a collection are swept on the way.
 static gc_arena *
-fh_get_arena()
+fh_get_arena(gc_cell_class cell_class)
 {
-  // Currently 1 arena, but room for more.
-  gc_arena *arena = NULL;
-  if (fh->gc_num_arenas == 0) {
-    arena = fh_new_arena();
-    fh->gc_arenas[0] = arena;
-    fh->gc_num_arenas++;
+  gc_arena *arena = fh->gc_alloc_arenas[cell_class];
+  if (arena && arena->used_slots < arena->num_slots)
+    return arena;
+
+  int i;
+  for (i = 0; i < fh->gc_num_arenas; i++) {
+    arena = fh->gc_arenas[i];
+    if (arena->cell_class != cell_class) continue;
+    if (arena->needs_sweep)
+      fh_gc_sweep(arena);
+    if (arena->used_slots < arena->num_slots)
+      return fh->gc_alloc_arenas[cell_class] = arena;
+  }
+  return fh->gc_alloc_arenas[cell_class] = NULL;
+}
+
+static void
+fh_gc_usage(gc_cell_class cell_class, long *total, long *used, long *young)
+{
+  *total = *used = *young = 0;
+  int i;
+  for (i = 0; i < fh->gc_num_arenas; i++) {
+    if (fh->gc_arenas[i]->cell_class == cell_class) {
+      *total += fh->gc_arenas[i]->num_slots;
+      *used += fh->gc_arenas[i]->used_slots;
+      *young += fh->gc_arenas[i]->young_slots;
+    }
   }
-  else
-    arena = fh->gc_arenas[0];
-  return arena;
 }
 
+static void fh_gc_start(bool);
+static void fh_gc_step(void);
+static void fh_gc_major(void);
+
 js_val *
-fh_malloc(bool first_attempt)
+fh_malloc(js_type type)
 {
-  if (fh->gc_state != GC_STATE_NONE) {
+  if (fh->gc_state == GC_STATE_STARTING || fh->gc_state == GC_STATE_SWEEP) {
     fprintf(stderr, "Error: politely refusing to allocate during garbage collection");
     exit(EXIT_FAILURE);
   }
 
-  gc_arena *arena = fh_get_arena();
-  int i;
-  for (i = 0; i < arena->num_slots; i++) {
-    if (!arena->freelist[i]) {
-      arena->freelist[i] = true;
-      arena->used_slots++;
-      return &arena->slots[i];
+#ifdef FH_GC_STRESS
+  // Collect on every allocation to flush out values that aren't rooted.
+  static unsigned long stress_allocs = 0;
+  if (fh->gc_state == GC_STATE_NONE) {
+    if (++stress_allocs % 1024 == 0)
+      fh_gc_major();
+    else
+      fh_gc_minor();
+  }
+#endif
+
+  // An incremental collection or a lazy sweep advances a little with every
+  // few allocations.
+  if ((fh->gc_state == GC_STATE_MARK || fh->gc_sweep_pending) &&
+      ++fh->gc_step_allocs >= GC_STEP_ALLOCS)
+    fh_gc_step();
+
+  gc_cell_class cell_class = fh_cell_class(type);
+  gc_arena *arena = fh_get_arena(cell_class);
+
+  // Every arena of this class is full. Collect the young generation, or the
+  // whole heap once old cells fill most of the class, then grow the heap if
+  // the collection left less than a quarter of the class vacant, so we don't
+  // end up collecting again after a handful of allocations.
+  //
+  // Arenas are swept lazily after a collection, so what's left in use is
+  // taken from the marking counts rather than the arenas.
+  //
+  // When old cells fill half the class after a minor collection, a major
+  // collection is started incrementally once the sweep is done. Minor
+  // collections can't run while it's marking, so a class that fills up in
+  // the meantime gets another arena instead. Only at the heap ceiling is the
+  // collection finished in one go.
+  if (!arena && fh->gc_state == GC_STATE_MARK)
+    arena = fh_new_arena(cell_class);
+
+  if (!arena) {
+    long total, used, young;
+    fh_gc_usage(cell_class, &total, &used, &young);
+    if (total > 0) {
+      if (fh->gc_state == GC_STATE_MARK || (used - young) * 4 > total * 3) {
+        fh_gc_major();
+      } else {
+        fh_gc_minor();
+        if (fh->opt_gc_step_us > 0 && fh->gc_live[cell_class] * 2 > total)
+          fh->gc_major_requested = true;
+      }
+      used = fh->gc_live[cell_class];
     }
+    if ((total - used) * 4 < total || total == 0)
+      fh_new_arena(cell_class);
+    arena = fh_get_arena(cell_class);
+  }
+
+  if (!arena) {
+    fprintf(stderr, "Error: process out of memory");
+    exit(EXIT_FAILURE);
   }
-  if (first_attempt) {
-    fh_gc();
-    return fh_malloc(false);
+
+  // Words before next_word are known to be full, so this finds the first
+  // vacant slot without rescanning the used part of the arena.
+  int w;
+  for (w = arena->next_word; w < GC_BITMAP_WORDS; w++) {
+    uint64_t vacant = ~arena->used[w];
+    if (vacant) {
+      int bit = __builtin_ctzll(vacant);
+      arena->used[w] |= (uint64_t)1 << bit;
+      arena->young[w] |= (uint64_t)1 << bit;
+      arena->used_slots++;
+      arena->young_slots++;
+      arena->next_word = w;
+      if (fh->gc_state == GC_STATE_MARK)
+        fh->gc_live[cell_class]++;
+      return GC_SLOT(arena, w * 64 + bit);
+    }
   }
-  fprintf(stderr, "Error: process out of memory");
-  exit(EXIT_FAILURE);
   UNREACHABLE();
 }
 
@@ -157,11 +383,12 @@ fh_gc_debug()
     fh->gc_time += delta;
   }
 
-  long total_slots = 0, used_slots = 0;
+  long total_slots = 0, used_slots = 0, total_bytes = 0;
   int i;
   for (i = 0; i < fh->gc_num_arenas; i++) {
     total_slots += fh->gc_arenas[i]->num_slots;
     used_slots += fh->gc_arenas[i]->used_slots;
+    total_bytes += fh->gc_arenas[i]->num_slots * fh->gc_arenas[i]->cell_size;
   }
 
   printf(
@@ -169,7 +396,7 @@ fh_gc_debug()
     total_slots,
     used_slots, total_slots,
     total_slots - used_slots, total_slots,
-    (total_slots * sizeof(js_val)) / 1000,
+    total_bytes / 1000,
     fh->gc_runs
   );
 
@@ -181,128 +408,443 @@ fh_gc_debug_arena(gc_arena *arena)
 {
 #ifdef FH_GC_PROFILE_VERBOSE
   for (int i = 0; i < arena->num_slots; i++) {
-    printf("slot[%4d]: (USED %d) (MARKED %d)\n", i, arena->freelist[i], arena->freelist[i] && arena->slots[i].marked);
+    printf("slot[%4d]: (USED %d) (MARKED %d)\n", i, (int)GC_SLOT_USED(arena, i), GC_SLOT_USED(arena, i) && GC_SLOT(arena, i)->marked);
   }
 #endif
 }
 
+// Push a marked value for scanning. If the mark stack can't grow, the value
+// stays marked but unscanned and the overflow flag is raised, so that
+// fh_gc_rescan can pick it up once the stack has drained.
 static void
-fh_gc_mark(js_val *val, int depth)
+fh_gc_push(js_val *val)
 {
-  if (val && val->flagged) puts("Attempting to mark flagged val");
-  if (!val || val->marked) return;
+  if (fh->gc_mark_top == fh->gc_mark_cap) {
+    size_t cap = fh->gc_mark_cap ? fh->gc_mark_cap * 2 : GC_MARK_STACK_MIN;
+    js_val **stack = cap <= GC_MARK_STACK_MAX ?
+      realloc(fh->gc_mark_stack, cap * sizeof(js_val *)) : NULL;
+    if (!stack) {
+      fh->gc_mark_overflow = true;
+      return;
+    }
+    fh->gc_mark_stack = stack;
+    fh->gc_mark_cap = cap;
+  }
+  fh->gc_mark_stack[fh->gc_mark_top++] = val;
+}
 
+// Mark a value (white to gray) and push it for scanning.
+static void
+fh_gc_mark(js_val *val)
+{
+  // Immediates live outside the heap and have nothing to mark.
+  if (!IS_HEAP(val)) return;
+  // Minor collections leave the old generation alone.
+  if (fh->gc_minor && val->old) return;
+  if (val->flagged) puts("Attempting to mark flagged val");
+  if (val->marked) return;
+
+  // Survivors are promoted as soon as they're marked, so that the barrier
+  // sees them as old even before their arena is swept.
   val->marked = true;
+  val->old = true;
+  fh->gc_live[fh_cell_class(val->type)]++;
 
-  GC_DEBUG_VERBOSE(depth, val);
-
-  GC_PRINT_VERBOSE(depth, "Marking prototype\n");
-  fh_gc_mark(val->proto, depth + 1);
+  GC_DEBUG_VERBOSE((int)fh->gc_mark_top, val);
 
-  if (IS_OBJ(val)) {
-    GC_PRINT_VERBOSE(depth, "Marking primitive\n");
-    fh_gc_mark(val->object.primitive, depth + 1);
-
-    GC_PRINT_VERBOSE(depth, "Marking bound this\n");
-    fh_gc_mark(val->object.bound_this, depth + 1);
+  fh_gc_push(val);
+}
 
-    GC_PRINT_VERBOSE(depth, "Marking scope\n");
-    fh_gc_mark(val->object.scope, depth + 1);
+// Mark everything a value refers to.
+static void
+fh_gc_scan(js_val *val)
+{
+  fh_gc_mark(val->proto);
 
-    GC_PRINT_VERBOSE(depth, "Marking instance\n");
-    fh_gc_mark(val->object.instance, depth + 1);
+  if (IS_OBJ(val)) {
+    fh_gc_mark(val->object.primitive);
+    fh_gc_mark(val->object.bound_this);
+    fh_gc_mark(val->object.scope);
+    fh_gc_mark(val->object.instance);
+    fh_gc_mark(val->object.parent);
+
+    js_args *args;
+    for (args = val->object.bound_args; args != NULL; args = args->next)
+      fh_gc_mark(args->arg);
+
+    unsigned long i;
+    for (i = 0; i < val->object.capacity; i++) {
+      js_val *elem = val->object.elements[i];
+      if (elem && elem != val) fh_gc_mark(elem);
+    }
 
-    GC_PRINT_VERBOSE(depth, "Marking parent\n");
-    fh_gc_mark(val->object.parent, depth + 1);
+    // A typed array's bytes belong to its buffer.
+    if (val->object.binary) fh_gc_mark(val->object.binary->buffer);
   }
 
   if (val->map) {
     js_prop *prop;
-    OBJ_ITER(val, prop) {
+    MAP_ITER(val, prop) {
       if (prop->ptr && !prop->circular) {
-        GC_PRINT_VERBOSE(depth, "Marking %s\n", prop->name);
-        fh_gc_mark(prop->ptr, depth + 1);
+        GC_PRINT_VERBOSE((int)fh->gc_mark_top, "Marking %s\n", prop->name);
+        fh_gc_mark(prop->ptr);
       }
     }
   }
 }
 
 static void
-fh_gc_free_val(js_val *val)
+fh_gc_drain()
+{
+  while (fh->gc_mark_top > 0)
+    fh_gc_scan(fh->gc_mark_stack[--fh->gc_mark_top]);
+}
+
+// Values marked while the stack was full were never scanned. Scan every
+// marked cell in the heap again until a pass gets through without the stack
+// overflowing. Rescanning a value that was already scanned is harmless.
+static void
+fh_gc_rescan()
 {
-  // Free the object hashtable
+  while (fh->gc_mark_overflow) {
+    fh->gc_mark_overflow = false;
+    int a, i;
+    for (a = 0; a < fh->gc_num_arenas; a++) {
+      gc_arena *arena = fh->gc_arenas[a];
+      for (i = 0; i < arena->num_slots; i++) {
+        if (GC_SLOT_USED(arena, i) && GC_SLOT(arena, i)->marked) {
+          fh_gc_scan(GC_SLOT(arena, i));
+          fh_gc_drain();
+        }
+      }
+    }
+  }
+}
+
+// Release what a dead cell owns outside the arena and return the number of
+// bytes reclaimed, counting the cell itself.
+static size_t
+fh_gc_free_val(js_val *val, size_t cell_size)
+{
+  size_t bytes = cell_size;
+
+  // Free the object's props
   //
-  // Note we're not freeing the values pointed at, only the pointers to them
-  // and the hashtable overhead.
-  /* if (val->map) { */
-  /*   js_prop *prop, *tmp; */
-  /*   HASH_ITER(hh, val->map, prop, tmp) { */
-  /*     HASH_DEL(val->map, prop); */
-  /*     if (prop != NULL) { */
-  /*       free(prop); */
-  /*     } */
-  /*   } */
-  /* } */
+  // Note we're not freeing the values pointed at, only the props pointing to
+  // them and their slots or hashtable.
+  bytes += fh_free_props(val);
+
+  // Free any binary data, unless it's a view of some other buffer's
+  if (IS_OBJ(val) && val->object.binary) {
+    js_binary *bin = val->object.binary;
+    if (!bin->buffer) {
+      bytes += bin->byte_length;
+      free(bin->bytes);
+    }
+    bytes += sizeof(js_binary);
+    free(bin);
+    val->object.binary = NULL;
+  }
 
   // Free any strings (dynamically alloc-ed outside slots)
   if (IS_STR(val) && val->string.ptr != NULL) {
+    bytes += strlen(val->string.ptr) + 1;
     free(val->string.ptr);
   }
 
-  memset(val, 0, sizeof(js_val));
+  // The cell itself is left as is; fh_new_val clears it on reuse.
+  return bytes;
 }
 
-static void
+// Free every unmarked slot in place and clear the mark on the survivors. Only
+// occupied slots are visited, a bitmap word at a time, and after a minor
+// collection only the young ones.
+static size_t
 fh_gc_sweep(gc_arena *arena)
 {
-  js_val val;
-  int sweeped_count = 0;
-  for (int i = 0; i < arena->num_slots; i++) {
-    if (!arena->freelist[i]) return;
-    val = arena->slots[i];
-    if (!val.marked) {
-      if (val.flagged) puts("GC: freeing flagged val");
-      arena->freelist[i] = false;
-      fh_gc_free_val(&val);
+  if (!arena->needs_sweep) return 0;
+
+  js_val *val;
+  size_t bytes = 0;
+  int w, i, first_vacant = -1;
+  for (w = 0; w < GC_BITMAP_WORDS; w++) {
+    uint64_t occupied = fh->gc_sweep_minor ? arena->young[w] : arena->used[w];
+    arena->young[w] = 0;
+    while (occupied) {
+      int bit = __builtin_ctzll(occupied);
+      occupied &= occupied - 1;
+      i = w * 64 + bit;
+      if (i >= arena->num_slots) break;
+
+      val = GC_SLOT(arena, i);
+      if (val->marked) {
+        val->marked = false;
+        continue;
+      }
+      if (val->flagged) puts("GC: freeing flagged val");
+      arena->used[w] &= ~((uint64_t)1 << bit);
       arena->used_slots--;
-      sweeped_count++;
-    } else {
-      arena->slots[i].marked = false;
+      bytes += fh_gc_free_val(val, arena->cell_size);
+    }
+    if (first_vacant < 0 && ~arena->used[w])
+      first_vacant = w;
+  }
+  if (first_vacant >= 0 && first_vacant < arena->next_word)
+    arena->next_word = first_vacant;
+  arena->young_slots = 0;
+  arena->needs_sweep = false;
+  fh->gc_sweep_pending--;
+
+  fh->gc_last_reclaimed += bytes;
+  fh->gc_total_reclaimed += bytes;
+  return bytes;
+}
+
+// Give empty arenas back to the OS, keeping at least one per cell class.
+static void
+fh_gc_release_arenas()
+{
+  int i, j, count[GC_NUM_CELL_CLASSES] = {0};
+  for (i = 0; i < fh->gc_num_arenas; i++)
+    count[fh->gc_arenas[i]->cell_class]++;
+
+  for (i = fh->gc_num_arenas - 1; i >= 0; i--) {
+    j = fh->gc_arenas[i]->cell_class;
+    if (fh->gc_arenas[i]->used_slots == 0 && count[j] > 1) {
+      fh_free_arena(i);
+      count[j]--;
     }
   }
 }
 
+// Sweep whatever the last collection left unswept, then give empty arenas
+// back.
+static void
+fh_gc_sweep_all()
+{
+  if (fh->gc_sweep_pending == 0) return;
+
+  int i;
+  for (i = 0; i < fh->gc_num_arenas; i++)
+    fh_gc_sweep(fh->gc_arenas[i]);
+  fh_gc_release_arenas();
+
+  // Start allocating from the lowest arena with room again.
+  memset(fh->gc_alloc_arenas, 0, sizeof(fh->gc_alloc_arenas));
+}
+
+// Add an old value to the remembered set, unless it's already there.
+void
+fh_gc_remember(js_val *val)
+{
+  if (!IS_HEAP(val) || !val->old || val->remembered) return;
+
+  if (fh->gc_remembered_len == fh->gc_remembered_cap) {
+    fh->gc_remembered_cap = fh->gc_remembered_cap ? fh->gc_remembered_cap * 2 : 64;
+    fh->gc_remembered = realloc(fh->gc_remembered,
+        fh->gc_remembered_cap * sizeof(js_val *));
+  }
+  fh->gc_remembered[fh->gc_remembered_len++] = val;
+  val->remembered = true;
+}
+
+// Grow the root stack used by handle scopes.
 void
-fh_gc()
+fh_grow_roots()
+{
+  fh->gc_roots_cap = fh->gc_roots_cap ? fh->gc_roots_cap * 2 : 1024;
+  fh->gc_roots = realloc(fh->gc_roots, fh->gc_roots_cap * sizeof(js_val *));
+}
+
+static void
+fh_gc_mark_roots()
+{
+  fh_gc_mark(fh->global);
+  fh_gc_mark(fh->function_proto);
+  fh_gc_mark(fh->object_proto);
+  fh_gc_mark(fh->array_proto);
+  fh_gc_mark(fh->string_proto);
+  fh_gc_mark(fh->number_proto);
+  fh_gc_mark(fh->boolean_proto);
+
+  eval_state *top = fh->callstack;
+  while (top) {
+    fh_gc_mark(top->ctx);
+    fh_gc_mark(top->this);
+    fh_gc_mark(top->scope);
+    top = top->parent;
+  }
+
+  size_t i;
+  for (i = 0; i < fh->gc_roots_top; i++)
+    fh_gc_mark(fh->gc_roots[i]);
+}
+
+// Begin a collection by marking the roots. A major collection may then be
+// left in the mark phase and advanced by fh_gc_step between allocations.
+static void
+fh_gc_start(bool minor)
 {
-  gc_arena *arena = fh_get_arena();
+  // Marks left over from the last collection have to be cleared first.
+  fh_gc_sweep_all();
 
-  fh_gc_debug_arena(arena);
+  int i;
+  for (i = 0; i < fh->gc_num_arenas; i++)
+    fh_gc_debug_arena(fh->gc_arenas[i]);
+
+  // Count what will be left of each cell class. A minor collection keeps the
+  // old cells, and marking adds the survivors.
+  for (i = 0; i < GC_NUM_CELL_CLASSES; i++) {
+    long total, used, young;
+    fh_gc_usage(i, &total, &used, &young);
+    fh->gc_live[i] = minor ? used - young : 0;
+  }
 
   // Start
   fh->gc_state = GC_STATE_STARTING;
+  fh->gc_minor = minor;
+  if (minor) {
+    fh->gc_minor_runs++;
+  } else {
+    fh->gc_major_runs++;
+    fh->gc_major_requested = false;
+  }
   fh_gc_debug();
 
   // Mark
   fh->gc_state = GC_STATE_MARK;
-  fh_gc_mark(fh->global, 0);
-  if (fh->callstack) {
-    eval_state *top = fh->callstack;
-    while (top) {
-      fh_gc_mark(top->scope, 0);
-      top = top->parent;
-    }
+  fh_gc_mark_roots();
+
+  // Old values pointing into the young generation are roots of a minor
+  // collection.
+  size_t r;
+  if (minor) {
+    for (r = 0; r < fh->gc_remembered_len; r++)
+      fh_gc_scan(fh->gc_remembered[r]);
   }
+}
+
+// Finish marking and leave the arenas to be swept. The roots are marked
+// again, since the callstack may have changed since the collection started,
+// and anything still gray is scanned.
+static void
+fh_gc_finish()
+{
+  int i;
+  fh_gc_mark_roots();
+  fh_gc_drain();
+  fh_gc_rescan();
   fh_gc_debug();
 
-  // Sweep
+  // No young values are left after any collection.
+  size_t r;
+  for (r = 0; r < fh->gc_remembered_len; r++)
+    fh->gc_remembered[r]->remembered = false;
+  fh->gc_remembered_len = 0;
+
+  // Sweep, lazily unless incremental collection is turned off.
   fh->gc_state = GC_STATE_SWEEP;
-  fh_gc_sweep(arena);
+  fh->gc_last_reclaimed = 0;
+  fh->gc_sweep_minor = fh->gc_minor;
+  for (i = 0; i < fh->gc_num_arenas; i++)
+    fh->gc_arenas[i]->needs_sweep = true;
+  fh->gc_sweep_pending = fh->gc_num_arenas;
+  if (fh->opt_gc_step_us == 0)
+    fh_gc_sweep_all();
+
+  // Start allocating from the lowest arena with room again.
+  memset(fh->gc_alloc_arenas, 0, sizeof(fh->gc_alloc_arenas));
   fh_gc_debug();
 
   // Stop
   fh->gc_state = GC_STATE_NONE;
+  fh->gc_minor = false;
   fh_gc_debug();
 
-  fh_gc_debug_arena(arena);
+  for (i = 0; i < fh->gc_num_arenas; i++)
+    fh_gc_debug_arena(fh->gc_arenas[i]);
+}
+
+// While marking, scan gray values until the mark stack is empty or the step
+// has used up its time budget. Once nothing is left to scan, the collection
+// is finished. While sweeping, sweep the next arena, and once they're all
+// swept start the major collection that was asked for, if any.
+static void
+fh_gc_step()
+{
+  fh->gc_step_allocs = 0;
+  fh->gc_steps++;
+
+  if (fh->gc_state != GC_STATE_MARK) {
+    int i;
+    for (i = 0; i < fh->gc_num_arenas; i++) {
+      if (fh->gc_arenas[i]->needs_sweep) {
+        fh_gc_sweep(fh->gc_arenas[i]);
+        break;
+      }
+    }
+    if (fh->gc_sweep_pending == 0) {
+      fh_gc_release_arenas();
+      memset(fh->gc_alloc_arenas, 0, sizeof(fh->gc_alloc_arenas));
+      if (fh->gc_major_requested)
+        fh_gc_start(false);
+    }
+    return;
+  }
+
+  clock_t deadline = clock() +
+    (clock_t)(fh->opt_gc_step_us * (CLOCKS_PER_SEC / 1e6));
+  long scanned = 0;
+  while (fh->gc_mark_top > 0) {
+    fh_gc_scan(fh->gc_mark_stack[--fh->gc_mark_top]);
+    if (++scanned % GC_STEP_CHECK == 0 && clock() >= deadline)
+      return;
+  }
+  fh_gc_finish();
+}
+
+// Collect the whole heap, finishing an incremental collection if one is
+// under way. The sweep is left to allocation.
+static void
+fh_gc_major()
+{
+  if (fh->gc_state != GC_STATE_MARK)
+    fh_gc_start(false);
+  fh_gc_finish();
+}
+
+// Collect the whole heap right away, sweep included.
+void
+fh_gc()
+{
+  fh_gc_major();
+  fh_gc_sweep_all();
+}
+
+// Collect the young generation only.
+void
+fh_gc_minor()
+{
+  fh_gc_start(true);
+  fh_gc_finish();
+}
+
+// Shade a value gray. Used by the write barrier while a collection is in the
+// mark phase.
+void
+fh_gc_shade(js_val *val)
+{
+  fh_gc_mark(val);
+}
+
+// Backward write barrier, for when many of an object's references change at
+// once: remember it, and if it has already been marked, queue it to be
+// scanned again.
+void
+fh_gc_barrier_back(js_val *obj)
+{
+  if (!IS_HEAP(obj)) return;
+  fh_gc_remember(obj);
+  if (fh->gc_state == GC_STATE_MARK && obj->marked)
+    fh_gc_push(obj);
 }
@@ -22,15 +22,91 @@
 #include "flathead.h"
 
 #define SLOTS_PER_ARENA 10000
+#define GC_STEP_US 1000                 // default incremental step budget
+#define GC_BITMAP_WORDS ((SLOTS_PER_ARENA + 63) / 64)
 
 typedef struct gc_arena {
+  gc_cell_class cell_class;
+  size_t cell_size;
   int num_slots;
   int used_slots;
-  bool freelist[SLOTS_PER_ARENA];
-  js_val slots[SLOTS_PER_ARENA];
+  int young_slots;
+  bool needs_sweep;                   // holds garbage from the last collection
+  int next_word;                      // first bitmap word that may have room
+  uint64_t used[GC_BITMAP_WORDS];     // one bit per slot, set when in use
+  uint64_t young[GC_BITMAP_WORDS];    // slots allocated since the last run
+  char *slots;
 } gc_arena;
 
-js_val * fh_malloc(bool);
+#define GC_SLOT_USED(arena, i) (((arena)->used[(i) / 64] >> ((i) % 64)) & 1)
+
+#define GC_SLOT(arena, i) \
+  ((js_val *)((arena)->slots + (size_t)(i) * (arena)->cell_size))
+
+js_val * fh_malloc(js_type);
+size_t fh_cell_size(js_type);
 void fh_gc(void);
+void fh_gc_minor(void);
+void fh_gc_remember(js_val *);
+void fh_gc_shade(js_val *);
+void fh_gc_barrier_back(js_val *);
+
+// Handle scopes
+//
+// C code holds js_val pointers that nothing in the heap refers to, like the
+// operands of an expression or a value a native function has just created.
+// Every value allocated, and every value fh_eval returns, is pushed onto a
+// root stack that collections mark from. A handle scope is a position on
+// that stack: closing it drops everything pushed since it was opened, and
+// fh_escape keeps a single value alive in the enclosing scope. The evaluator
+// opens scopes around statements, loop iterations and calls, so that a
+// collection can happen on any allocation.
+
+void fh_grow_roots(void);
+
+static inline js_val *
+fh_root(js_val *val)
+{
+  if (IS_HEAP(val)) {
+    if (fh->gc_roots_top == fh->gc_roots_cap)
+      fh_grow_roots();
+    fh->gc_roots[fh->gc_roots_top++] = val;
+  }
+  return val;
+}
+
+static inline size_t
+fh_open_scope()
+{
+  return fh->gc_roots_top;
+}
+
+static inline void
+fh_close_scope(size_t scope)
+{
+  fh->gc_roots_top = scope;
+}
+
+static inline js_val *
+fh_escape(size_t scope, js_val *val)
+{
+  fh_close_scope(scope);
+  return fh_root(val);
+}
+
+// Write barrier: call after storing a reference to `val` anywhere in `obj`
+// (a property, the prototype, or an internal object field). Minor collections
+// need to find young values that are only reachable from old ones, and an
+// incremental collection must never leave a marked object pointing at an
+// unmarked one.
+static inline void
+fh_gc_barrier(js_val *obj, js_val *val)
+{
+  if (!IS_HEAP(obj) || !IS_HEAP(val)) return;
+  if (obj->old && !obj->remembered && !val->old)
+    fh_gc_remember(obj);
+  if (fh->gc_state == GC_STATE_MARK && obj->marked && !val->marked)
+    fh_gc_shade(val);
+}
 
 #endif
@@ -70,7 +70,7 @@
   #define NEW_FINALLY(block)         NEW_NODE(NODE_FINALLY,block,0,0,0,0)
   #define NEW_FOR(exps,stmt)         NEW_NODE(NODE_FOR,exps,stmt,0,0,0)
   #define NEW_FORIN(lhs,in,stmt)     NEW_NODE(NODE_FORIN,lhs,in,stmt,0,0)
-  #define NEW_FUNC(params,body,id)   NEW_NODE(NODE_FUNC,params,body,id,0,0)
+  #define NEW_FUNC(prm,body,id,exp)  NEW_NODE(NODE_FUNC,prm,body,id,exp,0)
   #define NEW_IDENT(name)            NEW_NODE(NODE_IDENT,0,0,0,0,name)
   #define NEW_IF(p,q,r)              NEW_NODE(NODE_IF,p,q,r,0,0)
   #define NEW_MEMBER(head,tail,exp)  NEW_NODE(NODE_MEMBER,head,tail,0,exp,0)
@@ -155,7 +155,6 @@
 
 %type<node> AdditiveExpression
 %type<node> AdditiveExpressionNoFn
-%type<node> AnonymousFunction
 %type<node> ArgumentList
 %type<node> Arguments
 %type<node> ArrayLiteral
@@ -220,7 +219,6 @@
 %type<node> MemberExpressionNoFn
 %type<node> MultiExpression
 %type<node> MultiExpressionNoFn
-%type<node> NamedFunction
 %type<node> NewExpression
 %type<node> NewExpressionNoFn
 %type<node> NullLiteral
@@ -599,29 +597,23 @@ RegularExpressionLiteral : REGEXP
                              { $$ = NEW_REGEXP($1); }
                          ;
 
-                         /* Whether a named function is a declaration or expression is ambiguous
-                            here. We'll decide that on evaluation. */
-NamedFunction            : FUNCTION Identifier '(' FormalParameterList ')' '{' FunctionBody '}'
-                             { $$ = NEW_FUNC($4, $7, $2); }
+                         /* Statements can't start with a function expression (see
+                            ExpressionNoFn), so a named function in a source list is
+                            always a declaration. */
+FunctionDeclaration      : FUNCTION Identifier '(' FormalParameterList ')' '{' FunctionBody '}'
+                             { $$ = NEW_FUNC($4, $7, $2, false); }
                          | FUNCTION Identifier '(' ')' '{' FunctionBody '}'
-                             { $$ = NEW_FUNC(NULL, $6, $2); }
+                             { $$ = NEW_FUNC(NULL, $6, $2, false); }
                          ;
 
-                         /* Anonymous functions, OTOH, can readily be labeled expressions. */
-AnonymousFunction        : FUNCTION '(' FormalParameterList ')' '{' FunctionBody '}'
-                             { $$ = NEW_FUNC($3, $6, NULL); }
+FunctionExpression       : FUNCTION Identifier '(' FormalParameterList ')' '{' FunctionBody '}'
+                             { $$ = NEW_FUNC($4, $7, $2, true); }
+                         | FUNCTION Identifier '(' ')' '{' FunctionBody '}'
+                             { $$ = NEW_FUNC(NULL, $6, $2, true); }
+                         | FUNCTION '(' FormalParameterList ')' '{' FunctionBody '}'
+                             { $$ = NEW_FUNC($3, $6, NULL, true); }
                          | FUNCTION '(' ')' '{' FunctionBody '}'
-                             { $$ = NEW_FUNC(NULL, $5, NULL); }
-                         ;
-
-FunctionDeclaration      : NamedFunction
-                             { $$ = $1; }
-                         ;
-
-FunctionExpression       : NamedFunction
-                             { $$ = $1; }
-                         | AnonymousFunction
-                             { $$ = $1; }
+                             { $$ = NEW_FUNC(NULL, $5, NULL, true); }
                          ;
 
 FormalParameterList      : Identifier
@@ -1230,17 +1222,21 @@ main(int argc, char **argv)
   // Create the global state object
   fh = fh_new_global_state();
 
-  int c = 0, fakeind = 0, optind = 1;
+  int c = 0, fakeind = 0;
   static struct option long_options[] = {
     {"version", no_argument, NULL, 'v'},
     {"help", no_argument, NULL, 'h'},
     {"interactive", no_argument, NULL, 'i'},
     {"nodes", no_argument, NULL, 'n'},
     {"tokens", no_argument, NULL, 't'},
+    {"max-heap", required_argument, NULL, 'm'},
+    {"gc-step-us", required_argument, NULL, 's'},
     {NULL, 0, NULL, 0}
   };
 
-  while ((c = getopt_long(argc, argv, "vhint", long_options, &fakeind)) != -1) {
+  // getopt_long moves the options ahead of the script name, leaving optind
+  // pointing at the script (if any).
+  while ((c = getopt_long(argc, argv, "vhintm:s:", long_options, &fakeind)) != -1) {
     switch (c) {
       case 0: break;
       case 'v': fh_print_version(); return 0;
@@ -1248,9 +1244,10 @@ main(int argc, char **argv)
       case 'i': fh->opt_interactive = true; break;
       case 'n': fh->opt_print_ast = true; break;
       case 't': fh->opt_print_tokens = true; break;
+      case 'm': fh->opt_max_heap = strtoul(optarg, NULL, 10) * 1024 * 1024; break;
+      case 's': fh->opt_gc_step_us = strtol(optarg, NULL, 10); break;
       default: break;
     }
-    optind++;
   }
 
   static FILE *source = NULL;
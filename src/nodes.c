@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "nodes.h"
+#include "str.h"
 
 ast_node *
 node_alloc()
@@ -29,15 +30,102 @@ node_alloc()
   struct ast_node *node = calloc(1, sizeof(*node));
   node->type = NODE_UNKNOWN;
   node->sub_type = NODE_UNKNOWN;
-  node->visited = false;
   return node;
 }
 
+static const struct {
+  char *name;
+  enum ast_op op;
+} binary_ops[] = {
+  {"+", OPR_ADD}, {"-", OPR_SUB}, {"*", OPR_MUL}, {"/", OPR_DIV},
+  {"%", OPR_MOD}, {"==", OPR_EQ}, {"!=", OPR_NE}, {"===", OPR_STRICT_EQ},
+  {"!==", OPR_STRICT_NE}, {"<", OPR_LT}, {">", OPR_GT}, {"<=", OPR_LE},
+  {">=", OPR_GE}, {"instanceof", OPR_INSTANCEOF}, {"in", OPR_IN},
+  {"&", OPR_BIT_AND}, {"^", OPR_BIT_XOR}, {"|", OPR_BIT_OR},
+  {"<<", OPR_LSHIFT}, {">>", OPR_RSHIFT}, {">>>", OPR_URSHIFT},
+  {"&&", OPR_AND}, {"||", OPR_OR},
+}, unary_ops[] = {
+  {"+", OPR_PLUS}, {"-", OPR_NEG}, {"!", OPR_NOT}, {"~", OPR_BIT_NOT},
+  {"++", OPR_INC}, {"--", OPR_DEC}, {"delete", OPR_DELETE},
+  {"void", OPR_VOID}, {"typeof", OPR_TYPEOF},
+};
+
+#define LOOKUP_OP(table, s, len) { \
+  unsigned i; \
+  for (i = 0; i < sizeof(table) / sizeof(table[0]); i++) \
+    if (strlen(table[i].name) == (len) && !strncmp(table[i].name, s, len)) \
+      return table[i].op; \
+}
+
+// Resolve an operator's name, so evaluation can switch on it.
+static enum ast_op
+node_op(enum ast_node_type type, char *s)
+{
+  // A hoisted declaration's initializer is evaluated as an assignment.
+  if (type == NODE_VAR_DEC) return OPR_ASSIGN;
+  if (type == NODE_ASGN) {
+    if (s == NULL) return OPR_COMMA;
+    if (!strcmp(s, "=")) return OPR_ASSIGN;
+    // `+=` and the like, by the binary operator before the `=`
+    LOOKUP_OP(binary_ops, s, strlen(s) - 1);
+  }
+  else if (s != NULL) {
+    if (type == NODE_EXP) LOOKUP_OP(binary_ops, s, strlen(s));
+    if (type == NODE_UNARY_PRE || type == NODE_UNARY_POST)
+      LOOKUP_OP(unary_ops, s, strlen(s));
+  }
+  return OPR_NONE;
+}
+
+static bool
+is_list(enum ast_node_type type)
+{
+  switch (type) {
+    case NODE_ARG_LST:
+    case NODE_CLAUSE_LST:
+    case NODE_EL_LST:
+    case NODE_PARAM_LST:
+    case NODE_PROP_LST:
+    case NODE_SRC_LST:
+    case NODE_STMT_LST:
+    case NODE_VAR_DEC_LST:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void
+node_append(ast_node *list, ast_node *item)
+{
+  // Capacity is the next power of two up from the count.
+  if ((list->count & (list->count - 1)) == 0) {
+    unsigned cap = list->count ? list->count * 2 : 1;
+    list->items = realloc(list->items, cap * sizeof(ast_node *));
+  }
+  list->items[list->count++] = item;
+}
+
 ast_node *
 node_new(enum ast_node_type type, ast_node *e1, ast_node *e2, ast_node *e3,
          double x, char *s, int line, int column)
 {
+  // The grammar builds a list from its last item and the list before it.
+  // The item is added to that list, which is passed on up in its place.
+  if (is_list(type)) {
+    ast_node *list = e2;
+    if (list == NULL) {
+      list = node_alloc();
+      list->type = type;
+      list->line = line;
+      list->column = column;
+    }
+    if (e1 != NULL) node_append(list, e1);
+    return list;
+  }
+
   ast_node *node = node_alloc();
+  node->op = node_op(type, s);
 
   // Assign expression subtypes
   if (type == NODE_UNARY_POST || type == NODE_UNARY_PRE) {
@@ -56,55 +144,18 @@ node_new(enum ast_node_type type, ast_node *e1, ast_node *e2, ast_node *e3,
   node->line = line;
   node->column = column;
 
+  // Members flag computed access, and functions being expressions.
   node->val = 0;
-  if (type == NODE_NUM || type == NODE_BOOL || type == NODE_MEMBER)
+  if (type == NODE_NUM || type == NODE_BOOL || type == NODE_MEMBER ||
+      type == NODE_FUNC)
     node->val = x;
 
   node->sval = NULL;
-  if (s != NULL) {
-    node->sval = malloc((strlen(s) + 1) * sizeof(char));
-    strcpy(node->sval, s);
-    node->sval[strlen(s)] = '\0';
-  }
+  if (s != NULL)
+    node->sval = fh_intern(s);
   return node;
 }
 
-ast_node *
-node_pop(ast_node *node)
-{
-  if (node->e2 != NULL && !node->e2->visited)
-    return node_pop(node->e2);
-  node->visited = true;
-  return node->e1;
-}
-
-bool
-node_empty(ast_node *node)
-{
-  return node->visited;
-}
-
-void
-node_rewind(ast_node *node)
-{
-  // Unset visited on a node linked list.
-  if (!node->e1) return;
-  node->visited = false;
-  if (node->e2 != NULL) node_rewind(node->e2);
-}
-
-int
-node_count(ast_node *node)
-{
-  int count = 0;
-  ast_node *head = node;
-  while (head) {
-    if (head->e1) count++;
-    head = head->e2;
-  }
-  return count;
-}
-
 void
 node_print(ast_node *node, bool rec, int depth)
 {
@@ -179,4 +230,7 @@ node_print(ast_node *node, bool rec, int depth)
   if (node->e1 != NULL) node_print(node->e1, rec, depth + 2);
   if (node->e2 != NULL) node_print(node->e2, rec, depth + 2);
   if (node->e3 != NULL) node_print(node->e3, rec, depth + 2);
+  unsigned i;
+  for (i = 0; i < node->count; i++)
+    node_print(node->items[i], rec, depth + 2);
 }
@@ -76,15 +76,69 @@ enum ast_node_type {
   NODE_WHILE,
 };
 
+// Operators of expression, unary and assignment nodes, resolved from their
+// names when parsed. Compound assignments carry their binary operator.
+enum ast_op {
+  OPR_NONE,
+  OPR_ASSIGN,
+  OPR_COMMA,
+
+  OPR_ADD,
+  OPR_SUB,
+  OPR_MUL,
+  OPR_DIV,
+  OPR_MOD,
+  OPR_EQ,
+  OPR_NE,
+  OPR_STRICT_EQ,
+  OPR_STRICT_NE,
+  OPR_LT,
+  OPR_GT,
+  OPR_LE,
+  OPR_GE,
+  OPR_INSTANCEOF,
+  OPR_IN,
+  OPR_BIT_AND,
+  OPR_BIT_XOR,
+  OPR_BIT_OR,
+  OPR_LSHIFT,
+  OPR_RSHIFT,
+  OPR_URSHIFT,
+  OPR_AND,
+  OPR_OR,
+
+  OPR_PLUS,
+  OPR_NEG,
+  OPR_NOT,
+  OPR_BIT_NOT,
+  OPR_INC,
+  OPR_DEC,
+  OPR_DELETE,
+  OPR_VOID,
+  OPR_TYPEOF,
+};
+
+/* Lists (of statements, args, params and so on) keep their items in order in
+ * an array, filled in as they're parsed, rather than in a chain of nodes. The
+ * AST isn't changed once parsed, besides the caches hung off it, so the same
+ * list can be walked any number of times at once.
+ */
 typedef struct ast_node {
   struct ast_node *e1;
   struct ast_node *e2;
   struct ast_node *e3;
-  char *sval;
+  struct ast_node **items;            // of a list
+  unsigned count;
+  char *sval;                         // an atom (see str.c)
   double val;
   enum ast_node_type type;
   enum ast_node_type sub_type;
-  bool visited;
+  enum ast_op op;
+  struct js_ic *ic;                   // inline cache for lookups (see props.c)
+  struct js_code *code;               // bytecode, for source lists (see vm.h)
+  struct js_frame *frame;             // locals, for functions (see frame.h)
+  struct js_decls *decls;             // hoisted, for source lists (ditto)
+  unsigned slot;                      // ...and an identifier's, plus one
   int line;
   int column;
 } ast_node;
@@ -92,10 +146,6 @@ typedef struct ast_node {
 ast_node * node_alloc(void);
 ast_node * node_new(enum ast_node_type, ast_node *, ast_node *, ast_node *,
                     double, char *, int, int);
-ast_node * node_pop(ast_node *);
-void node_rewind(ast_node *);
-bool node_empty(ast_node *);
-int node_count(ast_node *);
 void node_print(ast_node *, bool, int);
 
 #endif
@@ -17,6 +17,478 @@
  */
 
 #include "props.h"
+#include "str.h"
+#include "gc.h"
+
+// Objects with more props than this, or that would add a transition to a shape
+// that already has this many, go to dictionary mode.
+#define SHAPE_MAX_PROPS 64
+#define SHAPE_MAX_TRANSITIONS 64
+
+// Smaller shapes are searched linearly rather than through a table.
+#define SHAPE_TABLE_MIN 8
+
+// The smallest elements vector, and how far past its end a write can be and
+// still grow it, rather than go to a sparse prop.
+#define ELEMENTS_MIN 8
+
+// Room for any index spelled out as a name.
+#define INDEX_NAME_SIZE 24
+
+// Prop storage is carved out of slabs this big.
+#define POOL_SLAB_SIZE 16384
+
+// One pool per slot vector capacity: 4, 8, ..., SHAPE_MAX_PROPS.
+#define SLOT_POOLS 5
+
+
+// ----------------------------------------------------------------------------
+// Prop storage
+// ----------------------------------------------------------------------------
+
+// Slot vectors and dictionary entries come from free lists, one per size, that
+// are refilled a slab at a time. Freed storage goes back on its list for the
+// next object rather than to malloc, and slabs are kept once allocated.
+
+typedef struct pool_block {
+  struct pool_block *next;
+} pool_block;
+
+typedef struct {
+  size_t size;                        // bytes per block
+  pool_block *free;
+} prop_pool;
+
+static prop_pool slot_pools[SLOT_POOLS];
+static prop_pool dict_pool = {sizeof(js_dict_prop), NULL};
+
+static void *
+pool_alloc(prop_pool *pool)
+{
+  if (pool->free == NULL) {
+    size_t count = POOL_SLAB_SIZE / pool->size, i;
+    char *slab = malloc(count * pool->size);
+    for (i = 0; i < count; i++) {
+      pool_block *block = (pool_block *)(slab + i * pool->size);
+      block->next = pool->free;
+      pool->free = block;
+    }
+  }
+
+  pool_block *block = pool->free;
+  pool->free = block->next;
+  return block;
+}
+
+static void
+pool_free(prop_pool *pool, void *ptr)
+{
+  pool_block *block = ptr;
+  block->next = pool->free;
+  pool->free = block;
+}
+
+// The pool for slot vectors of the given capacity.
+static prop_pool *
+slot_pool(unsigned cap)
+{
+  unsigned i = 0;
+  while ((4u << i) < cap) i++;
+  assert(i < SLOT_POOLS);
+  slot_pools[i].size = cap * sizeof(js_prop);
+  return &slot_pools[i];
+}
+
+// ----------------------------------------------------------------------------
+// Shapes
+// ----------------------------------------------------------------------------
+
+js_shape *
+fh_new_shape(js_shape *parent, char *name)
+{
+  js_shape *shape = malloc(sizeof(js_shape));
+
+  shape->parent = parent;
+  shape->transitions = NULL;
+  shape->sibling = NULL;
+  shape->name = NULL;
+  shape->count = 0;
+  shape->num_transitions = 0;
+  shape->table = NULL;
+  shape->table_size = 0;
+  shape->enum_cache = NULL;
+
+  if (parent) {
+    shape->name = fh_intern(name);
+    shape->count = parent->count + 1;
+    shape->sibling = parent->transitions;
+    parent->transitions = shape;
+    parent->num_transitions++;
+  }
+
+  return shape;
+}
+
+static void
+shape_build_table(js_shape *shape)
+{
+  unsigned size = 16, mask, i;
+  while (size < shape->count * 2) size *= 2;
+  mask = size - 1;
+
+  shape->table = calloc(size, sizeof(unsigned));
+  shape->table_size = size;
+
+  js_shape *s;
+  for (s = shape; s->parent != NULL; s = s->parent) {
+    for (i = fh_atom_hash(s->name) & mask; shape->table[i]; i = (i + 1) & mask);
+    shape->table[i] = s->count;
+  }
+}
+
+// Find the slot holding the named prop of an object in shape mode, or -1.
+// Names here and below are atoms.
+static int
+shape_lookup(js_val *obj, char *name)
+{
+  js_shape *shape = obj->shape;
+  unsigned i, slot;
+
+  if (shape->count < SHAPE_TABLE_MIN) {
+    for (i = 0; i < shape->count; i++)
+      if (obj->map[i].name == name) return i;
+    return -1;
+  }
+
+  if (!shape->table) shape_build_table(shape);
+  unsigned mask = shape->table_size - 1;
+  for (i = fh_atom_hash(name) & mask; (slot = shape->table[i]); i = (i + 1) & mask)
+    if (obj->map[slot - 1].name == name) return slot - 1;
+  return -1;
+}
+
+// The shape that adds the named prop to the given one, or NULL if the object
+// should go to dictionary mode instead.
+static js_shape *
+shape_transition(js_shape *shape, char *name)
+{
+  js_shape *next;
+  for (next = shape->transitions; next != NULL; next = next->sibling)
+    if (next->name == name) return next;
+
+  if (shape->count >= SHAPE_MAX_PROPS ||
+      shape->num_transitions >= SHAPE_MAX_TRANSITIONS)
+    return NULL;
+  return fh_new_shape(shape, name);
+}
+
+// Slot vectors grow in powers of two. An object that drops its newest prop
+// keeps its vector, so this is a lower bound on the vector's capacity, and
+// vectors go back to the pool for it: a waste of a few slots at worst.
+static unsigned
+slot_capacity(unsigned count)
+{
+  unsigned cap = 4;
+  while (cap < count) cap *= 2;
+  return cap;
+}
+
+static void
+free_slots(js_prop *slots, unsigned count)
+{
+  if (slots) pool_free(slot_pool(slot_capacity(count)), slots);
+}
+
+// Dictionaries are keyed by the address of each prop's name.
+
+static js_prop *
+dict_add(js_val *obj, js_prop *prop)
+{
+  js_dict_prop *dict = (js_dict_prop *)obj->map;
+  js_dict_prop *entry = pool_alloc(&dict_pool);
+  entry->prop = *prop;
+  HASH_ADD_PTR(dict, prop.name, entry);
+  obj->map = (js_prop *)dict;
+  return &entry->prop;
+}
+
+static js_dict_prop *
+dict_find(js_val *obj, char *name)
+{
+  js_dict_prop *dict = (js_dict_prop *)obj->map, *entry = NULL;
+  if (dict)
+    HASH_FIND_PTR(dict, &name, entry);
+  return entry;
+}
+
+// Move an object's props from its slots into a hash table, keeping their
+// order. Each entry takes its own reference to its name.
+static void
+to_dict(js_val *obj)
+{
+  js_prop *slots = obj->map;
+  unsigned i, count = obj->shape->count;
+
+  obj->map = NULL;
+  obj->shape = NULL;
+  for (i = 0; i < count; i++) {
+    fh_intern(slots[i].name);
+    dict_add(obj, &slots[i]);
+  }
+  free_slots(slots, count);
+}
+
+// Add a prop that the object doesn't have yet and return it.
+static js_prop *
+add_prop(js_val *obj, js_key key)
+{
+  char *atom = fh_intern_key(key);
+
+  if (obj->shape) {
+    js_shape *next = shape_transition(obj->shape, atom);
+    if (next) {
+      fh_release_atom(atom);
+      unsigned count = obj->shape->count;
+      if (obj->map == NULL || count == slot_capacity(count)) {
+        js_prop *slots = pool_alloc(slot_pool(slot_capacity(count + 1)));
+        if (obj->map) memcpy(slots, obj->map, count * sizeof(js_prop));
+        free_slots(obj->map, count);
+        obj->map = slots;
+      }
+      obj->shape = next;
+      obj->map[count].name = next->name;
+      return &obj->map[count];
+    }
+    to_dict(obj);
+  }
+
+  js_prop prop = {.name = atom};
+  return dict_add(obj, &prop);
+}
+
+// Find an object's own prop by atom.
+static js_prop *
+get_own(js_val *obj, char *name)
+{
+  if (!IS_HEAP(obj)) return NULL;
+
+  if (obj->shape) {
+    int slot = shape_lookup(obj, name);
+    return slot < 0 ? NULL : &obj->map[slot];
+  }
+
+  js_dict_prop *entry = dict_find(obj, name);
+  return entry ? &entry->prop : NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Array elements
+// ----------------------------------------------------------------------------
+
+/* Arrays and arguments objects keep their elements in a vector by index, with
+ * NULL for holes, rather than as props named "0", "1" and so on. Indices too
+ * far past the end of the vector to be worth growing it for, and elements
+ * given attributes other than the defaults, are held as ordinary props
+ * instead, which marks the array sparse: only then does a lookup that misses
+ * the vector check the props too.
+ *
+ * Typed arrays have a fixed number of elements, stored unboxed in the bytes
+ * of an ArrayBuffer; indices past the end are ignored.
+ *
+ * The index API below takes numbers rather than names, and works on any
+ * object, so that array-likes and strings can be walked without spelling out
+ * a name for each index.
+ */
+
+/* Parse a canonical array index: "7", but not "07", "7.0" or "-7". */
+bool
+fh_array_index(char *name, unsigned long *index)
+{
+  unsigned long i = 0;
+  if (*name < '0' || *name > '9' || (*name == '0' && name[1])) return false;
+  for (; *name >= '0' && *name <= '9'; name++)
+    if ((i = i * 10 + (*name - '0')) >= ARRAY_INDEX_MAX) return false;
+  if (*name) return false;
+  *index = i;
+  return true;
+}
+
+static bool
+indexed(js_val *obj)
+{
+  return IS_ARR(obj) || (IS_OBJ(obj) && STREQ(obj->object.class, "Arguments"));
+}
+
+static bool
+is_elem(js_val *obj, char *name, unsigned long *index)
+{
+  return fh_array_index(name, index) && (indexed(obj) || IS_TYPED(obj));
+}
+
+// Spell out an index as a prop name, for elements held as props.
+static char *
+index_name(char name[INDEX_NAME_SIZE], unsigned long i)
+{
+  snprintf(name, INDEX_NAME_SIZE, "%lu", i);
+  return name;
+}
+
+// An element held as a prop.
+static js_prop *
+get_sparse(js_val *arr, unsigned long i)
+{
+  char name[INDEX_NAME_SIZE];
+  char *atom = fh_find_atom(index_name(name, i));
+  return atom ? get_own(arr, atom) : NULL;
+}
+
+// An element from an array's vector or a typed array's bytes, or NULL.
+static js_val *
+stored_elem(js_val *obj, unsigned long i)
+{
+  if (i < obj->object.capacity) return obj->object.elements[i];
+
+  js_binary *bin = obj->object.binary;
+  if (bin && bin->type != TA_NONE && i < obj->object.length)
+    return fh_read_elem(bin->type, bin->bytes + i * fh_elem_size(bin->type));
+  return NULL;
+}
+
+static void
+set_typed(js_val *obj, unsigned long i, js_val *val)
+{
+  js_binary *bin = obj->object.binary;
+  if (i < obj->object.length)
+    fh_write_elem(bin->type, bin->bytes + i * fh_elem_size(bin->type), val);
+}
+
+// Elements have no props of their own, so a lookup by name fills in a view of
+// one, in storage the caller provides. Writes through it are lost.
+static js_prop *
+elem_view(js_prop *view, js_val *arr, char *name, js_val *val)
+{
+  view->name = name;
+  view->writable = view->enumerable = view->configurable = true;
+  view->ptr = val;
+  view->circular = val == arr;
+  return view;
+}
+
+// Find an object's own prop by name, given the name's atom if it has one.
+static js_prop *
+find_own(js_val *obj, char *name, char *atom, js_prop *view)
+{
+  unsigned long i;
+  js_val *val;
+  if (IS_OBJ(obj) && (obj->object.elements || obj->object.binary) &&
+      fh_array_index(name, &i) && (val = stored_elem(obj, i)))
+    return elem_view(view, obj, name, val);
+  return atom ? get_own(obj, atom) : NULL;
+}
+
+// Grow the vector to hold the given index, if it's near enough the end, and
+// move in any sparse elements that now fit.
+static bool
+grow_elements(js_val *arr, unsigned long index)
+{
+  unsigned long i, cap = arr->object.capacity;
+  if (index >= cap * 2 + ELEMENTS_MIN) return false;
+
+  unsigned long new_cap = MAX(MAX(cap * 2, ELEMENTS_MIN), index + 1);
+  js_val **elements = realloc(arr->object.elements, new_cap * sizeof(js_val *));
+  for (i = cap; i < new_cap; i++)
+    elements[i] = NULL;
+  arr->object.elements = elements;
+  arr->object.capacity = new_cap;
+
+  if (arr->object.sparse) {
+    js_prop *prop;
+    MAP_ITER(arr, prop) {
+      if (!fh_array_index(prop->name, &i) || i < cap || i >= new_cap) continue;
+      if (!prop->writable || !prop->enumerable || !prop->configurable) continue;
+      js_val *val = prop->ptr;
+      fh_del_prop(arr, prop->name);
+      elements[i] = val;
+    }
+  }
+  return true;
+}
+
+// Store an element in the vector, returning false if it belongs in a prop.
+static bool
+set_elem(js_val *arr, unsigned long i, js_val *val, js_prop_flags flags)
+{
+  bool plain = flags == P_IGNORE || flags == P_DEFAULT;
+
+  if (i < arr->object.capacity && arr->object.elements[i]) {
+    arr->object.elements[i] = plain ? val : NULL;
+    if (!plain) return false;
+  }
+  else if (!plain || (arr->object.sparse && get_sparse(arr, i)))
+    return false;
+  else if (i >= arr->object.capacity && !grow_elements(arr, i))
+    return false;
+
+  arr->object.elements[i] = val;
+  fh_gc_barrier(arr, val);
+  return true;
+}
+
+/* Get an object's own element at an index, or NULL if there's none (a hole). */
+js_val *
+fh_get_elem(js_val *obj, unsigned long i)
+{
+  if (!IS_OBJ(obj)) return NULL;
+  js_val *val = stored_elem(obj, i);
+  if (val || IS_TYPED(obj)) return val;
+  if (!obj->object.sparse && indexed(obj)) return NULL;
+
+  js_prop *prop = get_sparse(obj, i);
+  return prop ? prop->ptr : NULL;
+}
+
+/* Same as `fh_get` with the index as a name, but strings give their chars. */
+js_val *
+fh_get_index(js_val *obj, unsigned long i)
+{
+  if (IS_STR(obj)) {
+    if (i >= obj->string.length) return JSUNDEF();
+    char c[2] = {obj->string.ptr[i], '\0'};
+    return JSSTR(c);
+  }
+
+  js_val *val = fh_get_elem(obj, i);
+  return val ? val : JSUNDEF();
+}
+
+/* Same as `fh_set` with the index as a name. An array's length is left alone. */
+void
+fh_set_index(js_val *obj, unsigned long i, js_val *val)
+{
+  if (IS_TYPED(obj)) {
+    set_typed(obj, i, val);
+    return;
+  }
+  if (indexed(obj) && set_elem(obj, i, val, P_IGNORE)) return;
+
+  char name[INDEX_NAME_SIZE];
+  fh_set(obj, index_name(name, i), val);
+}
+
+/* Same as `fh_del_prop` with the index as a name, leaving a hole. */
+bool
+fh_del_index(js_val *obj, unsigned long i)
+{
+  if (!IS_HEAP(obj) || IS_TYPED(obj)) return false;
+  if (IS_OBJ(obj) && i < obj->object.capacity && obj->object.elements[i]) {
+    obj->object.elements[i] = NULL;
+    return true;
+  }
+  if (IS_OBJ(obj) && !obj->object.sparse && indexed(obj)) return false;
+
+  char name[INDEX_NAME_SIZE];
+  return fh_del_prop(obj, index_name(name, i));
+}
 
 // ----------------------------------------------------------------------------
 // Get a property
@@ -25,13 +497,22 @@
 /* Lookup a property on an object, resolve the value, and return it. */
 js_val *
 fh_get(js_val *obj, char *name)
+{
+  return fh_get_key(obj, fh_key(name));
+}
+
+/* Same as `fh_get`, given the name's key. The `_key` variants below are for
+ * callers that have the key already, or use it more than once.
+ */
+js_val *
+fh_get_key(js_val *obj, js_key key)
 {
   // We can't read properties from undefined.
-  if (obj->type == T_UNDEF)
-    fh_throw(NULL, fh_new_error(E_TYPE, "Cannot read property '%s' of undefined", name));
+  if (IS_UNDEF(obj))
+    fh_throw(NULL, fh_new_error(E_TYPE, "Cannot read property '%s' of undefined", key.str));
 
   // But we'll happily return undefined if a property doesn't exist.
-  js_prop *prop = fh_get_prop(obj, name);
+  js_prop view, *prop = fh_get_prop_key(obj, key, &view);
   return prop ? prop->ptr : JSUNDEF();
 }
 
@@ -39,7 +520,7 @@ fh_get(js_val *obj, char *name)
 js_val *
 fh_get_rec(js_val *obj, char *name)
 {
-  js_prop *prop = fh_get_prop_rec(obj, name);
+  js_prop view, *prop = fh_get_prop_rec(obj, name, &view);
   return prop ? prop->ptr : JSUNDEF();
 }
 
@@ -47,40 +528,68 @@ fh_get_rec(js_val *obj, char *name)
 js_val *
 fh_get_proto(js_val *obj, char *name)
 {
-  js_prop *prop = fh_get_prop_proto(obj, name);
+  return fh_get_proto_key(obj, fh_key(name));
+}
+
+js_val *
+fh_get_proto_key(js_val *obj, js_key key)
+{
+  js_prop view, *prop = fh_get_prop_proto_key(obj, key, &view);
   js_val *val = prop ? prop->ptr : JSUNDEF();
   // Store a ref to the instance for natively define methods.
   if (IS_FUNC(val)) {
     val->object.instance = obj;
+    fh_gc_barrier(val, obj);
   }
   return val;
 }
 
-/* Lookup a property on an object and return it. */
+/* Lookup a property on an object and return it.
+ *
+ * Names that aren't atoms yet can't belong to any property, though they may
+ * still name an array element. An element comes back as a view (see above),
+ * filled in from the given one, which lives as long as the caller needs it.
+ */
 js_prop *
-fh_get_prop(js_val *obj, char *name)
+fh_get_prop(js_val *obj, char *name, js_prop *view)
 {
-  js_prop *prop = NULL;
-  if (obj->map)
-    HASH_FIND_STR(obj->map, name, prop);
-  return prop;
+  return fh_get_prop_key(obj, fh_key(name), view);
+}
+
+js_prop *
+fh_get_prop_key(js_val *obj, js_key key, js_prop *view)
+{
+  return find_own(obj, key.str, fh_find_atom_key(key), view);
 }
 
 js_prop *
-fh_get_prop_rec(js_val *obj, char *name)
+fh_get_prop_rec(js_val *obj, char *name, js_prop *view)
 {
-  js_prop *prop = fh_get_prop(obj, name);
-  if (prop == NULL && obj->object.parent != NULL)
-    return fh_get_prop_rec(obj->object.parent, name);
+  char *atom = fh_find_atom(name);
+  js_prop *prop;
+  while ((prop = find_own(obj, name, atom, view)) == NULL && obj->object.parent != NULL)
+    obj = obj->object.parent;
   return prop;
 }
 
+static js_prop * method_lookup(js_val *, char *);
+
+js_prop *
+fh_get_prop_proto(js_val *obj, char *name, js_prop *view)
+{
+  return fh_get_prop_proto_key(obj, fh_key(name), view);
+}
+
 js_prop *
-fh_get_prop_proto(js_val *obj, char *name)
+fh_get_prop_proto_key(js_val *obj, js_key key, js_prop *view)
 {
-  js_prop *prop = fh_get_prop(obj, name);
-  if (prop == NULL && obj->proto != NULL)
-    return fh_get_prop_proto(obj->proto, name);
+  char *atom = fh_find_atom_key(key);
+  unsigned long i;
+  if (atom && !fh_array_index(key.str, &i)) return method_lookup(obj, atom);
+
+  js_prop *prop = NULL;
+  for (; obj != NULL && (prop = find_own(obj, key.str, atom, view)) == NULL;
+       obj = fh_proto_of(obj));
   return prop;
 }
 
@@ -89,13 +598,27 @@ fh_get_prop_proto(js_val *obj, char *name)
 // Set a property
 // ----------------------------------------------------------------------------
 
+static void
+assign(js_val *obj, js_prop *prop, js_val *val)
+{
+  prop->ptr = val;
+  fh_gc_barrier(obj, val);
+  prop->circular = prop->ptr == obj ? 1 : 0; // Do we have a circular reference?
+}
+
 /* Set a property on an object using the provided name and value, and the
  * default property flags.
  */
 void
 fh_set(js_val *obj, char *name, js_val *val)
 {
-  fh_set_prop(obj, name, val, P_IGNORE);
+  fh_set_prop_key(obj, fh_key(name), val, P_IGNORE);
+}
+
+void
+fh_set_key(js_val *obj, js_key key, js_val *val)
+{
+  fh_set_prop_key(obj, key, val, P_IGNORE);
 }
 
 /* Set a property on an object using the provided name, value, and property
@@ -104,12 +627,34 @@ fh_set(js_val *obj, char *name, js_val *val)
 void
 fh_set_prop(js_val *obj, char *name, js_val *val, js_prop_flags flags)
 {
+  fh_set_prop_key(obj, fh_key(name), val, flags);
+}
+
+void
+fh_set_prop_key(js_val *obj, js_key key, js_val *val, js_prop_flags flags)
+{
+  // Immediates can't hold properties; writes to them are silently dropped.
+  if (!IS_HEAP(obj)) return;
+
+  // Elements go in the vector if they can.
+  unsigned long i;
+  if (is_elem(obj, key.str, &i)) {
+    if (IS_TYPED(obj)) {
+      set_typed(obj, i, val);
+      return;
+    }
+    if (set_elem(obj, i, val, flags)) return;
+    obj->object.sparse = true;
+  }
+
   // Get the existing prop or create a new one.
-  bool new = false;
-  js_prop *prop = fh_get_prop(obj, name);
+  key.atom = fh_find_atom_key(key);
+  js_prop *prop = key.atom ? get_own(obj, key.atom) : NULL;
   if (prop == NULL) {
-    prop = fh_new_prop(P_DEFAULT);
-    new = true;
+    prop = add_prop(obj, key);
+    prop->writable = true;
+    prop->configurable = true;
+    prop->enumerable = true;
   }
 
   // Update the prop flags.
@@ -120,41 +665,271 @@ fh_set_prop(js_val *obj, char *name, js_val *val, js_prop_flags flags)
     prop->enumerable = flags & P_ENUM;
   }
 
-  prop->ptr = val;
-  prop->circular = prop->ptr == obj ? 1 : 0; // Do we have a circular reference?
-
-  // Add the prop if new
-  if (new) {
-    prop->name = malloc((strlen(name) + 1) * sizeof(char));
-    strcpy(prop->name, name);
-    prop->name[strlen(name)] = '\0';
-    HASH_ADD_KEYPTR(hh, obj->map, prop->name, strlen(prop->name), prop);
-  }
+  assign(obj, prop, val);
 }
 
 /* Set a property on the given object, or -- if not defined -- the closest
- * parent scope on which the name is already defined.
+ * parent scope on which the name is already defined. Read-only props are
+ * left alone.
  */
 void
 fh_set_rec(js_val *obj, char *name, js_val *val)
 {
-  js_val *scope_to_set = obj;
-  js_val *parent = NULL;
+  fh_set_rec_key(obj, fh_key(name), val);
+}
+
+void
+fh_set_rec_key(js_val *obj, js_key key, js_val *val)
+{
+  // Array-likes aren't scopes, so their elements are set on them directly.
+  unsigned long i;
+  if (is_elem(obj, key.str, &i)) {
+    fh_set_key(obj, key, val);
+    return;
+  }
 
   // Try and find the property in a parent scope.
-  js_prop *prop = fh_get_prop(obj, name);
-  while (prop == NULL) {
-    if (obj->object.parent == NULL) break;
-    parent = obj->object.parent;
-    prop = fh_get_prop(parent, name);
-    obj = parent;
+  key.atom = fh_find_atom_key(key);
+  js_val *scope = obj;
+  js_prop *prop = NULL;
+  if (key.atom) {
+    while ((prop = get_own(scope, key.atom)) == NULL && scope->object.parent != NULL)
+      scope = scope->object.parent;
   }
-  if (prop != NULL && parent != NULL)
-    scope_to_set = parent;
 
-  fh_set(scope_to_set, name, val);
+  if (prop) {
+    if (prop->writable) assign(scope, prop, val);
+  }
+  else
+    fh_set_key(obj, key, val);
 }
 
+// ----------------------------------------------------------------------------
+// Inline caches
+// ----------------------------------------------------------------------------
+
+static js_val *
+next_scope(js_val *obj)
+{
+  return obj->object.parent;
+}
+
+// Follow a cached path from the given object, returning the prop it leads to
+// if every object on the way still has the same shape, or NULL.
+static js_prop *
+ic_probe(js_ic_entry *entry, js_val *obj, js_val **holder,
+         js_val *(*next)(js_val *))
+{
+  unsigned i;
+  for (i = 0; i < entry->depth; i++) {
+    if (!IS_HEAP(obj) || obj->shape != entry->shapes[i]) return NULL;
+    obj = next(obj);
+  }
+
+  *holder = obj;
+  if (entry->holder)
+    return obj == entry->holder && entry->epoch == fh->dict_epoch ?
+      entry->prop : NULL;
+  return IS_HEAP(obj) && obj->shape == entry->shapes[i] ?
+    &obj->map[entry->slot] : NULL;
+}
+
+// Look a prop up along a chain the slow way, describing the path taken in the
+// given entry if it can be cached. Only paths through objects in shape mode,
+// up to a holder in either mode, can be.
+static js_prop *
+ic_walk(js_val *obj, char *name, js_val **holder, js_val *(*next)(js_val *),
+        js_ic_entry *entry, bool *cacheable)
+{
+  js_prop *prop = NULL;
+  unsigned i;
+
+  *cacheable = true;
+  for (i = 0; obj != NULL; i++, obj = next(obj)) {
+    prop = get_own(obj, name);
+    if (i > IC_MAX_DEPTH || !IS_HEAP(obj) || (!prop && !obj->shape))
+      *cacheable = false;
+    if (prop) break;
+    if (*cacheable) entry->shapes[i] = obj->shape;
+  }
+  if (!prop) return NULL;
+  *holder = obj;
+  if (!*cacheable) return prop;
+
+  entry->depth = i;
+  entry->shapes[i] = obj->shape;
+  entry->holder = obj->shape ? NULL : obj;
+  entry->prop = prop;
+  entry->slot = obj->shape ? prop - obj->map : 0;
+  entry->epoch = fh->dict_epoch;
+  return prop;
+}
+
+// Look a prop up along a chain, through the cache and filling it on a miss.
+static js_prop *
+ic_lookup(js_ic **icp, js_val *obj, char *name, js_val **holder,
+          js_val *(*next)(js_val *))
+{
+  js_ic *ic = *icp;
+  js_prop *prop;
+  unsigned i;
+
+  if (ic) {
+    for (i = 0; i < ic->count; i++)
+      if ((prop = ic_probe(&ic->entries[i], obj, holder, next))) return prop;
+  }
+
+  js_ic_entry entry;
+  bool cacheable;
+  prop = ic_walk(obj, name, holder, next, &entry, &cacheable);
+  if (!prop || !cacheable) return prop;
+
+  if (!ic) ic = *icp = calloc(1, sizeof(js_ic));
+  if (ic->count < IC_WAYS)
+    ic->entries[ic->count++] = entry;
+  else {
+    ic->entries[ic->next] = entry;
+    ic->next = (ic->next + 1) % IC_WAYS;
+  }
+  return prop;
+}
+
+// Look a prop up along the prototype chain, through the method cache and
+// filling it on a miss. Receivers in dictionary mode skip the cache.
+static js_prop *
+method_lookup(js_val *obj, char *atom)
+{
+  js_method_entry *cached = NULL;
+  js_val *holder;
+  js_prop *prop;
+
+  if (IS_HEAP(obj) && obj->shape) {
+    uintptr_t hash = (uintptr_t)obj->shape >> 4 ^ (uintptr_t)atom >> 4;
+    cached = &fh->method_cache[hash % METHOD_CACHE_SIZE];
+    if (cached->shape == obj->shape && cached->name == atom &&
+        (prop = ic_probe(&cached->path, obj, &holder, fh_proto_of)))
+      return prop;
+  }
+
+  js_ic_entry path;
+  bool cacheable;
+  prop = ic_walk(obj, atom, &holder, fh_proto_of, &path, &cacheable);
+  if (prop && cacheable && cached) {
+    cached->shape = obj->shape;
+    cached->name = atom;
+    cached->path = path;
+  }
+  return prop;
+}
+
+/* Same as `fh_get_proto`, caching the lookup in the given node's cache. The
+ * name must be an atom, as are those of identifiers in the AST.
+ */
+js_val *
+fh_get_proto_cached(js_val *obj, char *name, js_ic **ic)
+{
+  js_val *holder;
+  js_prop *prop = ic_lookup(ic, obj, name, &holder, fh_proto_of);
+  js_val *val = prop ? prop->ptr : JSUNDEF();
+  // Store a ref to the instance for natively define methods.
+  if (IS_FUNC(val)) {
+    val->object.instance = obj;
+    fh_gc_barrier(val, obj);
+  }
+  return val;
+}
+
+/* Same as `fh_get_prop_rec`, caching the lookup in the given node's cache. */
+js_prop *
+fh_get_prop_rec_cached(js_val *obj, char *name, js_ic **ic)
+{
+  js_val *holder;
+  return ic_lookup(ic, obj, name, &holder, next_scope);
+}
+
+/* Same as `fh_set_rec`, caching the lookup in the given node's cache. */
+void
+fh_set_rec_cached(js_val *obj, char *name, js_val *val, js_ic **ic)
+{
+  js_val *holder;
+  js_prop *prop = ic_lookup(ic, obj, name, &holder, next_scope);
+  if (prop) {
+    if (prop->writable) assign(holder, prop, val);
+  }
+  else
+    fh_set_rec(obj, name, val);
+}
+
+
+// ----------------------------------------------------------------------------
+// Frames
+// ----------------------------------------------------------------------------
+
+/* The shape an empty object takes on by adding the given props in order, or
+ * NULL if it would go to dictionary mode on the way.
+ */
+js_shape *
+fh_shape_of(char **names, unsigned count)
+{
+  js_shape *shape = fh->empty_shape;
+  unsigned i;
+  for (i = 0; i < count && shape; i++)
+    shape = shape_transition(shape, names[i]);
+  return shape;
+}
+
+/* Give an empty object all the props of a shape at once, copied from `props`
+ * (see frame.h).
+ */
+void
+fh_init_props(js_val *obj, js_shape *shape, js_prop *props)
+{
+  assert(obj->shape == fh->empty_shape && obj->map == NULL);
+  obj->shape = shape;
+  if (!shape->count) return;
+  obj->map = pool_alloc(slot_pool(slot_capacity(shape->count)));
+  memcpy(obj->map, props, shape->count * sizeof(js_prop));
+}
+
+void
+fh_set_slot(js_val *obj, unsigned slot, js_val *val)
+{
+  assign(obj, &obj->map[slot], val);
+}
+
+// The prop in a scope's slot, if it has the given name.
+static js_prop *
+local(js_val *scope, char *name, unsigned slot)
+{
+  if (!IS_HEAP(scope) || !scope->shape || slot >= scope->shape->count)
+    return NULL;
+  return scope->map[slot].name == name ? &scope->map[slot] : NULL;
+}
+
+/* Look a variable up by the slot it was resolved to, plus one, if it's there,
+ * or else as `fh_get_prop_rec_cached` does.
+ */
+js_prop *
+fh_get_local(js_val *scope, char *name, unsigned slot, js_ic **ic)
+{
+  js_prop *prop;
+  if (slot && (prop = local(scope, name, slot - 1))) return prop;
+  return fh_get_prop_rec_cached(scope, name, ic);
+}
+
+/* Same as `fh_set_rec_cached`, given a slot as for `fh_get_local`. */
+void
+fh_set_local(js_val *scope, char *name, unsigned slot, js_val *val, js_ic **ic)
+{
+  js_prop *prop;
+  if (slot && (prop = local(scope, name, slot - 1))) {
+    if (prop->writable) assign(scope, prop, val);
+  }
+  else
+    fh_set_rec_cached(scope, name, val, ic);
+}
+
+
 // ----------------------------------------------------------------------------
 // Delete a property
 // ----------------------------------------------------------------------------
@@ -163,8 +938,309 @@ fh_set_rec(js_val *obj, char *name, js_val *val)
 bool
 fh_del_prop(js_val *obj, char *name)
 {
-  js_prop *deletee = fh_get_prop(obj, name);
+  unsigned long i;
+  if (IS_TYPED(obj) && fh_array_index(name, &i)) return false;
+  if (is_elem(obj, name, &i) && i < obj->object.capacity &&
+      obj->object.elements[i]) {
+    obj->object.elements[i] = NULL;
+    return true;
+  }
+
+  char *atom = fh_find_atom(name);
+  js_prop *deletee = atom ? get_own(obj, atom) : NULL;
   if (!deletee) return false;
-  HASH_DEL(obj->map, deletee);
+
+  if (obj->shape) {
+    // Deleting the newest prop just steps back to the previous shape.
+    if (deletee == &obj->map[obj->shape->count - 1]) {
+      obj->shape = obj->shape->parent;
+      return true;
+    }
+    to_dict(obj);
+    deletee = get_own(obj, atom);
+  }
+
+  js_dict_prop *dict = (js_dict_prop *)obj->map;
+  js_dict_prop *entry = (js_dict_prop *)deletee;
+  HASH_DEL(dict, entry);
+  obj->map = (js_prop *)dict;
+  fh_release_atom(entry->prop.name);
+  pool_free(&dict_pool, entry);
+  fh->dict_epoch++;
   return true;
 }
+
+/* Free all of an object's props, and an array's elements, returning the
+ * number of bytes released.
+ */
+size_t
+fh_free_props(js_val *obj)
+{
+  size_t bytes = 0;
+
+  if (obj->type == T_OBJECT && obj->object.elements) {
+    bytes += obj->object.capacity * sizeof(js_val *);
+    free(obj->object.elements);
+    obj->object.elements = NULL;
+    obj->object.capacity = 0;
+    obj->object.sparse = false;
+  }
+
+  if (obj->shape) {
+    if (obj->map)
+      bytes += slot_capacity(obj->shape->count) * sizeof(js_prop);
+    free_slots(obj->map, obj->shape->count);
+  }
+  else if (obj->map) {
+    // Clearing the table leaves the entries' insertion-order links intact, so
+    // they can still be walked afterwards.
+    js_dict_prop *dict = (js_dict_prop *)obj->map, *entry = dict, *next;
+    bytes += sizeof(UT_hash_table) +
+      dict->hh.tbl->num_buckets * sizeof(UT_hash_bucket);
+    HASH_CLEAR(hh, dict);
+    for (; entry != NULL; entry = next) {
+      next = entry->hh.next;
+      bytes += sizeof(js_dict_prop);
+      fh_release_atom(entry->prop.name);
+      pool_free(&dict_pool, entry);
+    }
+    fh->dict_epoch++;
+  }
+
+  obj->map = NULL;
+  obj->shape = fh->empty_shape;
+  return bytes;
+}
+
+/* Hand all of one object's props, and elements, over to another, replacing its
+ * own.
+ */
+void
+fh_move_props(js_val *dst, js_val *src)
+{
+  fh_free_props(dst);
+  dst->shape = src->shape;
+  dst->map = src->map;
+  src->shape = fh->empty_shape;
+  src->map = NULL;
+  if (src->type == T_OBJECT && dst->type == T_OBJECT) {
+    dst->object.elements = src->object.elements;
+    dst->object.capacity = src->object.capacity;
+    dst->object.sparse = src->object.sparse;
+    src->object.elements = NULL;
+    src->object.capacity = 0;
+    src->object.sparse = false;
+  }
+  fh->dict_epoch++;
+  fh_gc_barrier_back(dst);
+}
+
+
+// ----------------------------------------------------------------------------
+// Iterate props
+// ----------------------------------------------------------------------------
+
+/* An array's elements are visited first, by index, as views like those from
+ * `fh_get_prop`. Props follow in the order they were added (see OBJ_ITER).
+ * Deleting the current prop along the way is safe, even if it sends the object
+ * to dictionary mode. MAP_ITER skips the elements.
+ */
+js_prop_iter
+fh_iter_map(js_val *obj)
+{
+  js_prop_iter it = {.obj = obj, .slot = 0, .slot_name = NULL, .next = NULL};
+  it.dict = IS_HEAP(obj) && obj->shape == NULL;
+  if (it.dict)
+    it.next = (js_dict_prop *)obj->map;
+  return it;
+}
+
+js_prop_iter
+fh_iter_props(js_val *obj)
+{
+  js_prop_iter it = fh_iter_map(obj);
+  it.elements = IS_OBJ(obj) && (obj->object.elements || IS_TYPED(obj));
+  it.elem = 0;
+  return it;
+}
+
+// The next element as a view, or NULL once they've all been seen.
+static js_prop *
+next_elem(js_prop_iter *it)
+{
+  js_val *obj = it->obj;
+  unsigned long end = IS_TYPED(obj) ? obj->object.length : obj->object.capacity;
+  while (it->elem < end) {
+    unsigned long i = it->elem++;
+    js_val *val = stored_elem(obj, i);
+    if (!val) continue;
+
+    it->view.name = index_name(it->index, i);
+    it->view.writable = it->view.enumerable = it->view.configurable = true;
+    it->view.ptr = val;
+    it->view.circular = val == obj;
+    return &it->view;
+  }
+  return NULL;
+}
+
+js_prop *
+fh_next_prop(js_prop_iter *it)
+{
+  js_val *obj = it->obj;
+  if (!IS_HEAP(obj)) return NULL;
+
+  // Start on the props once the elements are done, as they may have changed
+  // in the meantime.
+  if (it->elements) {
+    js_prop *view = next_elem(it);
+    if (view) return view;
+    *it = fh_iter_map(obj);
+  }
+
+  // If the object went to dictionary mode since the last step, pick up from
+  // the prop that was next in line.
+  if (!it->dict && obj->shape == NULL) {
+    it->dict = true;
+    it->next = it->slot_name ? dict_find(obj, it->slot_name) : NULL;
+  }
+
+  if (it->dict) {
+    js_dict_prop *entry = it->next;
+    if (!entry) return NULL;
+    it->next = entry->hh.next;
+    return &entry->prop;
+  }
+
+  unsigned count = obj->shape->count;
+  if (it->slot >= count) return NULL;
+  js_prop *prop = &obj->map[it->slot++];
+  it->slot_name = it->slot < count ? obj->map[it->slot].name : NULL;
+  return prop;
+}
+
+
+// ----------------------------------------------------------------------------
+// Enumeration
+// ----------------------------------------------------------------------------
+
+/* For-in loops visit each object's elements, then its props, up the prototype
+ * chain, skipping any name an earlier object on the chain already has. Props
+ * deleted before they're reached are skipped too. Receivers whose chain is all
+ * in shape mode, with no elements past the receiver's own, take their names
+ * from a list cached on the receiver's shape; others walk the props live.
+ */
+
+// The cached names for an object and its prototypes, which are stored in the
+// given chain, or NULL if they can't be cached.
+static js_enum_cache *
+enum_cache(js_val *obj, js_val **chain)
+{
+  js_shape *shapes[ENUM_MAX_DEPTH + 1];
+  unsigned depth, d, e, i, count = 0, ways = 0;
+  js_val *o;
+
+  if (!IS_HEAP(obj)) return NULL;
+  for (depth = 0, o = obj; o != NULL; depth++, o = o->proto) {
+    if (depth > ENUM_MAX_DEPTH || !o->shape) return NULL;
+    if (depth && IS_OBJ(o) && (o->object.elements || IS_TYPED(o))) return NULL;
+    chain[depth] = o;
+    shapes[depth] = o->shape;
+    count += o->shape->count;
+  }
+  depth--;
+
+  js_enum_cache *cache;
+  for (cache = obj->shape->enum_cache; cache != NULL; cache = cache->next, ways++)
+    if (cache->depth == depth &&
+        !memcmp(cache->shapes, shapes, (depth + 1) * sizeof(js_shape *)))
+      return cache;
+  if (ways >= ENUM_CACHE_WAYS) return NULL;
+
+  cache = malloc(sizeof(js_enum_cache) + count * sizeof(js_enum_key));
+  memcpy(cache->shapes, shapes, (depth + 1) * sizeof(js_shape *));
+  cache->depth = depth;
+  cache->count = 0;
+
+  for (d = 0; d <= depth; d++) {
+    for (i = 0; i < shapes[d]->count; i++) {
+      char *name = chain[d]->map[i].name;
+      for (e = 0; e < d && shape_lookup(chain[e], name) < 0; e++);
+      if (e < d) continue;
+      cache->keys[cache->count++] = (js_enum_key){name, d, i};
+    }
+  }
+
+  cache->next = obj->shape->enum_cache;
+  obj->shape->enum_cache = cache;
+  return cache;
+}
+
+js_enum_iter
+fh_iter_enum(js_val *obj)
+{
+  js_enum_iter it = {.obj = obj, .holder = obj, .depth = 0, .next = 0};
+  it.cache = enum_cache(obj, it.chain);
+  it.props = fh_iter_props(obj);
+  return it;
+}
+
+// Whether an object before the holder on the chain has the given prop.
+static bool
+enum_shadowed(js_enum_iter *it, char *name, char *atom)
+{
+  js_val *obj;
+  js_prop view;
+  for (obj = it->obj; obj != it->holder; obj = fh_proto_of(obj))
+    if (find_own(obj, name, atom, &view)) return true;
+  return false;
+}
+
+static js_val *
+next_cached(js_enum_iter *it)
+{
+  js_enum_cache *cache = it->cache;
+  js_prop *prop;
+
+  if (it->props.elements) {
+    if ((prop = next_elem(&it->props))) return JSSTR(prop->name);
+    it->props.elements = false;
+  }
+
+  while (it->next < cache->count) {
+    js_enum_key *key = &cache->keys[it->next++];
+    js_val *holder = it->chain[key->depth];
+    prop = holder->shape == cache->shapes[key->depth] ?
+      &holder->map[key->slot] : get_own(holder, key->name);
+    if (!prop || !prop->enumerable) continue;
+
+    // Only the receiver has elements, which the list doesn't account for.
+    it->holder = holder;
+    if (key->depth && enum_shadowed(it, key->name, NULL)) continue;
+    return JSSTR(key->name);
+  }
+  return NULL;
+}
+
+/* The name of the next prop a for-in loop visits, as a new string, or NULL
+ * once they've all been visited.
+ */
+js_val *
+fh_next_enum(js_enum_iter *it)
+{
+  if (it->cache) return next_cached(it);
+
+  js_prop *prop;
+  while (it->holder != NULL) {
+    while ((prop = fh_next_prop(&it->props))) {
+      if (!prop->enumerable) continue;
+      char *atom = prop == &it->props.view ? fh_find_atom(prop->name) : prop->name;
+      if (it->depth && enum_shadowed(it, prop->name, atom)) continue;
+      return JSSTR(prop->name);
+    }
+    it->holder = fh_proto_of(it->holder);
+    it->depth++;
+    if (it->holder) it->props = fh_iter_props(it->holder);
+  }
+  return NULL;
+}
@@ -20,16 +20,45 @@
 #define PROP_H
 
 #include "flathead.h"
+#include "str.h"
 
 void fh_set(js_val *, char *, js_val *);
+void fh_set_key(js_val *, js_key, js_val *);
 void fh_set_prop(js_val *, char *, js_val *, js_prop_flags);
+void fh_set_prop_key(js_val *, js_key, js_val *, js_prop_flags);
 void fh_set_rec(js_val *, char *, js_val *);
+void fh_set_rec_key(js_val *, js_key, js_val *);
 bool fh_del_prop(js_val *, char *);
-js_prop * fh_get_prop(js_val *, char *);
-js_prop * fh_get_prop_rec(js_val *, char *);
-js_prop * fh_get_prop_proto(js_val *, char *);
+js_prop * fh_get_prop(js_val *, char *, js_prop *);
+js_prop * fh_get_prop_key(js_val *, js_key, js_prop *);
+js_prop * fh_get_prop_rec(js_val *, char *, js_prop *);
+js_prop * fh_get_prop_proto(js_val *, char *, js_prop *);
+js_prop * fh_get_prop_proto_key(js_val *, js_key, js_prop *);
 js_val * fh_get(js_val *, char *);
+js_val * fh_get_key(js_val *, js_key);
 js_val * fh_get_proto(js_val *, char *);
+js_val * fh_get_proto_key(js_val *, js_key);
 js_val * fh_get_rec(js_val *, char *);
+bool fh_array_index(char *, unsigned long *);
+js_val * fh_get_elem(js_val *, unsigned long);
+js_val * fh_get_index(js_val *, unsigned long);
+void fh_set_index(js_val *, unsigned long, js_val *);
+bool fh_del_index(js_val *, unsigned long);
+js_val * fh_get_proto_cached(js_val *, char *, js_ic **);
+js_prop * fh_get_prop_rec_cached(js_val *, char *, js_ic **);
+void fh_set_rec_cached(js_val *, char *, js_val *, js_ic **);
+js_shape * fh_shape_of(char **, unsigned);
+void fh_init_props(js_val *, js_shape *, js_prop *);
+void fh_set_slot(js_val *, unsigned, js_val *);
+js_prop * fh_get_local(js_val *, char *, unsigned, js_ic **);
+void fh_set_local(js_val *, char *, unsigned, js_val *, js_ic **);
+size_t fh_free_props(js_val *);
+void fh_move_props(js_val *, js_val *);
+js_shape * fh_new_shape(js_shape *, char *);
+js_prop_iter fh_iter_props(js_val *);
+js_prop_iter fh_iter_map(js_val *);
+js_prop * fh_next_prop(js_prop_iter *);
+js_enum_iter fh_iter_enum(js_val *);
+js_val * fh_next_enum(js_enum_iter *);
 
 #endif
@@ -18,13 +18,13 @@
 // Merge Sort (implements Array#sort)
 // ----------------------------------------------------------------------------
 
-static int (*cmp_func)(js_prop *, js_prop *);   // Current Array#sort cmp func
+static int (*cmp_func)(js_val *, js_val *);     // Current Array#sort cmp func
 static js_val *js_cmp_func;                     // JavaScript-defined cmp func
 static eval_state *js_cmp_state;                // Eval state of JS cmp func
 
 static void
-merge(js_prop **left, js_prop **right,
-          unsigned long l_len, unsigned long r_len, js_prop **out)
+merge(js_val **left, js_val **right,
+          unsigned long l_len, unsigned long r_len, js_val **out)
 {
   unsigned long i, j, k;
   for (i = j = k = 0; i < l_len && j < r_len; )
@@ -35,7 +35,7 @@ merge(js_prop **left, js_prop **right,
 }
 
 static void
-recur(js_prop **arr, js_prop **tmp, unsigned long len)
+recur(js_val **arr, js_val **tmp, unsigned long len)
 {
   long l = len / 2;
   if (len <= 1) return;
@@ -47,30 +47,55 @@ recur(js_prop **arr, js_prop **tmp, unsigned long len)
 }
 
 static void
-merge_sort(js_prop **arr, unsigned long len)
+merge_sort(js_val **arr, unsigned long len)
 {
-  js_prop **tmp = malloc(sizeof(js_prop *) * len);
-  memcpy(tmp, arr, sizeof(js_prop *) * len);
+  js_val **tmp = malloc(sizeof(js_val *) * len);
+  memcpy(tmp, arr, sizeof(js_val *) * len);
 
   recur(arr, tmp, len);
 
   free(tmp);
 }
 
+// Comparisons drop whatever they allocate, since a sort makes O(n log n) of
+// them.
+
 static int
-cmp(js_prop *a, js_prop *b)
+cmp(js_val *a, js_val *b)
 {
-  return strcmp(TO_STR(a->ptr)->string.ptr, TO_STR(b->ptr)->string.ptr) < 0;
+  size_t scope = fh_open_scope();
+  int res = strcmp(TO_STR(a)->string.ptr, TO_STR(b)->string.ptr) < 0;
+  fh_close_scope(scope);
+  return res;
 }
 
 static int
-cmp_js(js_prop *a, js_prop *b)
+cmp_js(js_val *a, js_val *b)
 {
+  size_t scope = fh_open_scope();
   js_args *args = args_new();
-  args_append(args, a->ptr);
-  args_append(args, b->ptr);
+  args_append(args, a);
+  args_append(args, b);
   js_val *result = fh_call(js_cmp_state->ctx, JSUNDEF(), js_cmp_func, args);
-  return TO_BOOL(result)->number.val > 0;
+  int res = NUMVAL(TO_NUM(result)) <= 0;
+  fh_close_scope(scope);
+  return res;
+}
+
+
+// ----------------------------------------------------------------------------
+// Elements
+// ----------------------------------------------------------------------------
+
+// Move an element to another index, holes included.
+static void
+move_elem(js_val *arr, unsigned long from, unsigned long to)
+{
+  js_val *val = fh_get_elem(arr, from);
+  if (val)
+    fh_set_index(arr, to, val);
+  else
+    fh_del_index(arr, to);
 }
 
 
@@ -87,7 +112,7 @@ arr_new(js_val *instance, js_args *args, eval_state *state)
 
   // Create array of given length:
   if (ARGLEN(args) == 1 && IS_NUM(ARG(args, 0))) {
-    double len = ARG(args, 0)->number.val;
+    double len = NUMVAL(ARG(args, 0));
     // Must be positive integer less than 2^32 - 1
     if (len < 0 || len >= ULONG_MAX || fmod(len, 1) != 0)
       fh_throw(state, fh_new_error(E_RANGE, "Invalid array length"));
@@ -100,7 +125,7 @@ arr_new(js_val *instance, js_args *args, eval_state *state)
 
   unsigned i; // num of args will be less than UINT_MAX
   for (i = 0; i < ARGLEN(args); i++)
-    fh_set(arr, JSNUMKEY(i)->string.ptr, ARG(args, i));
+    fh_set_index(arr, i, ARG(args, i));
 
   fh_set_len(arr, i);
   return arr;
@@ -131,12 +156,13 @@ arr_proto_pop(js_val *instance, js_args *args, eval_state *state)
   unsigned long len = instance->object.length;
   if (len == 0) return JSUNDEF();
 
-  js_val *key = JSNUMKEY(len - 1);
-  js_val *popped = fh_get(instance, key->string.ptr);
+  // Once it's out of the array nothing else keeps the element alive.
+  size_t scope = fh_open_scope();
+  js_val *popped = fh_root(fh_get_elem(instance, len - 1));
 
-  fh_del_prop(instance, key->string.ptr);
+  fh_del_index(instance, len - 1);
   fh_set_len(instance, len - 1);
-  return popped;
+  return fh_escape(scope, popped ? popped : JSUNDEF());
 }
 
 // Array.prototype.push(element1, ..., elementN)
@@ -146,11 +172,8 @@ arr_proto_push(js_val *instance, js_args *args, eval_state *state)
   unsigned long len = instance->object.length;
   unsigned nargs = ARGLEN(args);
   unsigned i;
-  for (i = 0; i < nargs; i++) {
-    js_val *key = JSNUMKEY(len);
-    fh_set(instance, key->string.ptr, ARG(args, i));
-    len++;
-  }
+  for (i = 0; i < nargs; i++)
+    fh_set_index(instance, len++, ARG(args, i));
 
   fh_set_len(instance, len);
   return JSNUM(len);
@@ -161,40 +184,22 @@ js_val *
 arr_proto_reverse(js_val *instance, js_args *args, eval_state *state)
 {
   unsigned long len = instance->object.length;
-  unsigned long i = 0, j = len - 1;
-  js_val *tmp;
-  js_prop *iprop, *jprop;
-  char *ik, *jk;
-
-  // While i & j converge, swap the values they point to.
-  while (i < j) {
-    ik = JSNUMKEY(i++)->string.ptr;
-    jk = JSNUMKEY(j--)->string.ptr;
-
-    iprop = fh_get_prop(instance, ik);
-    jprop = fh_get_prop(instance, jk);
-
-    // Need to do some checks to account for missing properties
-    // (they may have been deleted or never set)
-
-    if (jprop)
-      jprop->ptr = jprop->ptr == NULL ? JSUNDEF() : jprop->ptr;
-    if (iprop)
-      iprop->ptr = iprop->ptr == NULL ? JSUNDEF() : iprop->ptr;
+  if (len == 0) return instance;
 
-    if (!iprop && jprop) {
-      fh_set_prop(instance, ik, jprop->ptr, P_DEFAULT);
-      fh_del_prop(instance, jk);
-    }
-    else if (!jprop && iprop) {
-      fh_set_prop(instance, jk, iprop->ptr, P_DEFAULT);
-      fh_del_prop(instance, ik);
-    }
-    else if (jprop && iprop) {
-      tmp = iprop->ptr;
-      iprop->ptr = jprop->ptr;
-      jprop->ptr = tmp;
-    }
+  // While i & j converge, swap the values they point to. Holes (deleted or
+  // never set) swap places too.
+  unsigned long i = 0, j = len - 1;
+  js_val *ival;
+  size_t scope = fh_open_scope();
+  for (; i < j; i++, j--) {
+    // The element at i is only held here once it's overwritten.
+    ival = fh_root(fh_get_elem(instance, i));
+    move_elem(instance, j, i);
+    if (ival)
+      fh_set_index(instance, j, ival);
+    else
+      fh_del_index(instance, j);
+    fh_close_scope(scope);
   }
 
   return instance;
@@ -204,25 +209,21 @@ arr_proto_reverse(js_val *instance, js_args *args, eval_state *state)
 js_val *
 arr_proto_shift(js_val *instance, js_args *args, eval_state *state)
 {
-  // Shift off first element, but then we have to rename all the keys.
+  // Shift off first element, but then we have to move all the others down.
 
   unsigned long len = instance->object.length;
   if (len == 0) return JSUNDEF();
 
-  js_val *shifted = fh_get(instance, "0");
-  fh_del_prop(instance, "0");
+  size_t scope = fh_open_scope();
+  js_val *shifted = fh_root(fh_get_elem(instance, 0));
 
   unsigned long i;
-  for (i = 1; i < len; i++) {
-    js_val *old_key = JSNUMKEY(i);
-    js_val *new_key = JSNUMKEY(i-1);
-    js_prop *prop = fh_get_prop(instance, old_key->string.ptr);
-    fh_del_prop(instance, old_key->string.ptr);
-    fh_set(instance, new_key->string.ptr, prop->ptr);
-  }
+  for (i = 1; i < len; i++)
+    move_elem(instance, i, i - 1);
+  fh_del_index(instance, len - 1);
 
   fh_set_len(instance, len - 1);
-  return shifted;
+  return fh_escape(scope, shifted ? shifted : JSUNDEF());
 }
 
 // Array.prototype.sort([compareFunction])
@@ -242,36 +243,24 @@ arr_proto_sort(js_val *instance, js_args *args, eval_state *state)
     cmp_func = cmp;
   }
 
-  js_val *sorted = JSARR();
-
-  // Build an array of js_prop pointers from the hashmap.
-  unsigned long i, j;
-  js_prop *prop, *prop_lst[len];
+  // Gather the values, rooting them in case the compare function takes them
+  // out of the array.
+  unsigned long i, n = 0;
+  js_val *val;
+  js_val **vals = malloc(sizeof(js_val *) * len);
   for (i = 0; i < len; i++) {
-    prop = fh_get_prop(instance, JSNUMKEY(i)->string.ptr);
-    if (!prop) {
-      i--;
-      continue;
-    }
-    prop_lst[i] = prop;
+    if ((val = fh_get_elem(instance, i)))
+      vals[n++] = fh_root(val);
   }
 
-  // Do a merge sort of the js_prop pointers array.
-  merge_sort(prop_lst, i);
-
-  // Rebuild the hashmap (using a donor array).
-  for (j = 0; j < i; j++) {
-    prop = prop_lst[j];
-    free(prop->name);
-    prop->name = JSNUMKEY(j)->string.ptr;
-    HASH_ADD_KEYPTR(hh, sorted->map, prop->name, strlen(prop->name), prop);
-  }
+  merge_sort(vals, n);
 
-  // Steal the donor array's hashmap.
-  instance->map = sorted->map;
-  sorted->map = NULL;
-
-  fh_set_len(instance, len);
+  // Write them back in order, with any holes moved to the end.
+  for (i = 0; i < n; i++)
+    fh_set_index(instance, i, vals[i]);
+  for (; i < len; i++)
+    fh_del_index(instance, i);
+  free(vals);
 
   return instance;
 }
@@ -292,8 +281,8 @@ arr_proto_splice(js_val *instance, js_args *args, eval_state *state)
   unsigned long len = instance->object.length;     // instance array length
   unsigned long args_ind = 2;                      // args splice start index
   unsigned int  args_length = ARGLEN(args);        // number of args
-  unsigned long splice_ind = index->number.val;    // splice start index
-  unsigned long splice_len = how_many->number.val; // splice length
+  unsigned long splice_ind = NUMVAL(index);    // splice start index
+  unsigned long splice_len = NUMVAL(how_many); // splice length
 
   // For each element in the array.
   js_val *val;
@@ -304,14 +293,14 @@ arr_proto_splice(js_val *instance, js_args *args, eval_state *state)
 
       // Add any new elements
       while (args_ind < args_length) {
-        fh_set(keepers, JSNUMKEY(k)->string.ptr, ARG(args, args_ind));
+        fh_set_index(keepers, k, ARG(args, args_ind));
         args_ind++;
         k++;
       }
       // Add the spliced region to the rejects, skip over those indices.
       while (splice_len > 0) {
-        val = fh_get(instance, JSNUMKEY(i)->string.ptr);
-        fh_set(rejects, JSNUMKEY(j)->string.ptr, val);
+        if ((val = fh_get_elem(instance, i)))
+          fh_set_index(rejects, j, val);
         splice_len--, i++, j++;
       }
       // Don't hit this branch twice.
@@ -319,18 +308,15 @@ arr_proto_splice(js_val *instance, js_args *args, eval_state *state)
 
     }
     else {
-      val = fh_get(instance, JSNUMKEY(i)->string.ptr);
-      fh_set(keepers, JSNUMKEY(k)->string.ptr, val);
+      if ((val = fh_get_elem(instance, i)))
+        fh_set_index(keepers, k, val);
       k++, i++;
     }
   }
 
-  // We're doing a hotswap of the keepers hash into the instance array.
+  // We're doing a hotswap of the keepers' props into the instance array.
   // Still technically mutates the instance array (its pointer hasn't changed)
-  instance->map = keepers->map;
-
-  // GC will take the hash if we don't remove the reference.
-  keepers->map = NULL;
+  fh_move_props(instance, keepers);
 
   fh_set_len(instance, k);
   fh_set_len(rejects, j);
@@ -341,30 +327,18 @@ arr_proto_splice(js_val *instance, js_args *args, eval_state *state)
 js_val *
 arr_proto_unshift(js_val *instance, js_args *args, eval_state *state)
 {
-  js_val *newarr = JSARR();
   unsigned nargs = ARGLEN(args);
   unsigned long len = instance->object.length;
+  unsigned long i;
 
-  unsigned long i = 0, j = 0;
-
-  // Add the args
-  for (; i < nargs; i++) {
-    fh_set(newarr, JSNUMKEY(i)->string.ptr, ARG(args, i));
-  }
-
-  // Add the instance's elements
-  js_val *val;
-  for (; j < len; j++, i++) {
-    val = fh_get(instance, JSNUMKEY(j)->string.ptr);
-    fh_set(newarr, JSNUMKEY(i)->string.ptr, val);
-  }
-
-  // Replace the map into our instance.
-  instance->map = newarr->map;
-  newarr->map = NULL;
+  // Make room for the args, from the end down, then add them.
+  for (i = len; i-- > 0; )
+    move_elem(instance, i, i + nargs);
+  for (i = 0; i < nargs; i++)
+    fh_set_index(instance, i, ARG(args, i));
 
-  fh_set_len(instance, i);
-  return JSNUM(i);
+  fh_set_len(instance, len + nargs);
+  return JSNUM(len + nargs);
 }
 
 // Array.prototype.concat(value1, value2, ..., valueN)
@@ -374,36 +348,29 @@ arr_proto_concat(js_val *instance, js_args *args, eval_state *state)
   unsigned nargs = ARGLEN(args);
   unsigned long len = instance->object.length;
   js_val *concat = JSARR();
-  js_val *key;
 
   unsigned long i = 0, // newarr index
                 j = 0; // args index
 
   // Add the current array to the new array.
-  for (; i < len; i++) {
-    key = JSNUMKEY(i);
-    fh_set(concat, key->string.ptr, fh_get(instance, key->string.ptr));
-  }
+  for (; i < len; i++)
+    fh_set_index(concat, i, fh_get_index(instance, i));
 
   // Add the arguments to the new array.
   js_val *arg;
   for (; j < nargs; j++, i++) {
-    key = JSNUMKEY(i);
     arg = ARG(args, j);
     // Extract array elements one level deep.
     if (IS_ARR(arg)) {
       unsigned long k;
-      js_val *inner_key;
       for (k = 0; k < arg->object.length; k++) {
-        key = JSNUMKEY(i);
-        inner_key = JSNUMKEY(k);
-        fh_set(concat, key->string.ptr, fh_get(arg, inner_key->string.ptr));
+        fh_set_index(concat, i, fh_get_index(arg, k));
         // Let the outer loop increment i if we're at the end:
         if (k < arg->object.length - 1) i++;
       }
     }
     else {
-      fh_set(concat, key->string.ptr, arg);
+      fh_set_index(concat, i, arg);
     }
   }
 
@@ -425,7 +392,7 @@ do_join(js_val *arr, js_val *sep)
   unsigned long i;
 
   for (i = 0; i < arr->object.length; i++) {
-    el = fh_get(arr, JSNUMKEY(i)->string.ptr);
+    el = fh_get_index(arr, i);
 
     if (!first)
       result = JSSTR(fh_str_concat(result->string.ptr, sep->string.ptr));
@@ -456,22 +423,22 @@ arr_proto_slice(js_val *instance, js_args *args, eval_state *state)
   unsigned long len = instance->object.length;
 
   unsigned long j;
-  if (IS_UNDEF(begin) || begin->number.val > len)
+  if (IS_UNDEF(begin) || NUMVAL(begin) > len)
     return slice;
-  else if (begin->number.val >= 0)
-    j = begin->number.val;
-  else if (-begin->number.val <= len)
-    j = len + begin->number.val;
+  else if (NUMVAL(begin) >= 0)
+    j = NUMVAL(begin);
+  else if (-NUMVAL(begin) <= len)
+    j = len + NUMVAL(begin);
   else
     j = 0;
 
   unsigned long k;
-  if (IS_UNDEF(end) || end->number.val > len)
+  if (IS_UNDEF(end) || NUMVAL(end) > len)
     k = len;
-  else if (end->number.val >= 0)
-    k = end->number.val;
-  else if (-end->number.val <= len)
-    k = len + end->number.val;
+  else if (NUMVAL(end) >= 0)
+    k = NUMVAL(end);
+  else if (-NUMVAL(end) <= len)
+    k = len + NUMVAL(end);
   else
     return slice;
 
@@ -482,8 +449,8 @@ arr_proto_slice(js_val *instance, js_args *args, eval_state *state)
   js_val *val;
   unsigned long i;
   for (i = 0; j < k && j < len; j++, i++) {
-    val = fh_get(instance, JSNUMKEY(j)->string.ptr);
-    fh_set(slice, JSNUMKEY(i)->string.ptr, val);
+    val = fh_get_index(instance, j);
+    fh_set_index(slice, i, val);
   }
 
   fh_set_len(slice, i);
@@ -507,18 +474,17 @@ arr_proto_index_of(js_val *instance, js_args *args, eval_state *state)
 
   unsigned long i = 0;
   if (IS_NUM(from)) {
-    if (from->number.val < 0)
-      i = len + from->number.val;
+    if (NUMVAL(from) < 0)
+      i = len + NUMVAL(from);
     else
-      i = from->number.val;
+      i = NUMVAL(from);
   }
 
-  js_val *key, *equals;
+  js_val *equals;
   for (; i < len; i++) {
-    key = JSNUMKEY(i);
     // indexOf uses strict equality
-    equals = fh_eq(fh_get(instance, key->string.ptr), search, true);
-    if (equals->boolean.val) {
+    equals = fh_eq(fh_get_index(instance, i), search, true);
+    if (BOOLVAL(equals)) {
       return JSNUM(i);
     }
   }
@@ -535,18 +501,17 @@ arr_proto_last_index_of(js_val *instance, js_args *args, eval_state *state)
   long long i = len - 1;
 
   if (IS_NUM(from)) {
-    if (from->number.val < 0)
-      i = len + from->number.val;
-    else if (from->number.val < len)
-      i = from->number.val;
+    if (NUMVAL(from) < 0)
+      i = len + NUMVAL(from);
+    else if (NUMVAL(from) < len)
+      i = NUMVAL(from);
   }
 
-  js_val *key, *equals;
+  js_val *equals;
   for (; i >= 0; i--) {
-    key = JSNUMKEY(i);
     // lastIndexOf uses strict equality
-    equals = fh_eq(fh_get(instance, key->string.ptr), search, true);
-    if (equals->boolean.val) {
+    equals = fh_eq(fh_get_index(instance, i), search, true);
+    if (BOOLVAL(equals)) {
       return JSNUM(i);
     }
   }
@@ -562,21 +527,18 @@ arr_proto_filter(js_val *instance, js_args *args, eval_state *state)
   js_val *filtered = JSARR();
   unsigned long len = instance->object.length;
 
-  js_val *ikey, *jkey, *val, *result;
+  js_val *val, *result;
   js_args *cbargs;
   unsigned long i = 0, j = 0;
   for (; i < len; i++) {
-    ikey = JSNUMKEY(i);
-    val = fh_get(instance, ikey->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, val);
     args_append(cbargs, JSNUM(i));
     args_append(cbargs, instance);
     result = fh_call(state->ctx, this, callback, cbargs);
-    if (TO_BOOL(result)->boolean.val) {
-      jkey = JSNUMKEY(j++);
-      fh_set(filtered, jkey->string.ptr, fh_get(instance, ikey->string.ptr));
-    }
+    if (BOOLVAL(TO_BOOL(result)))
+      fh_set_index(filtered, j++, fh_get_index(instance, i));
   }
 
   fh_set_len(filtered, j);
@@ -591,12 +553,11 @@ arr_proto_for_each(js_val *instance, js_args *args, eval_state *state)
   js_val *this = ARG(args, 1);
   unsigned long len = instance->object.length;
 
-  js_val *key, *val;
+  js_val *val;
   js_args *cbargs;
   unsigned long i;
   for (i = 0; i < len; i++) {
-    key = JSNUMKEY(i);
-    val = fh_get(instance, key->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, val);
     args_append(cbargs, JSNUM(i));
@@ -615,18 +576,17 @@ arr_proto_every(js_val *instance, js_args *args, eval_state *state)
   js_val *this = ARG(args, 1);
   unsigned long len = instance->object.length;
 
-  js_val *key, *val, *result;
+  js_val *val, *result;
   js_args *cbargs;
   unsigned long i;
   for (i = 0; i < len; i++) {
-    key = JSNUMKEY(i);
-    val = fh_get(instance, key->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, val);
     args_append(cbargs, JSNUM(i));
     args_append(cbargs, instance);
     result = fh_call(state->ctx, this, callback, cbargs);
-    if (!TO_BOOL(result)->boolean.val)
+    if (!BOOLVAL(TO_BOOL(result)))
       return JSBOOL(0);
   }
 
@@ -642,18 +602,17 @@ arr_proto_map(js_val *instance, js_args *args, eval_state *state)
   unsigned long len = instance->object.length;
   js_val *map = JSARR();
 
-  js_val *key, *val, *result;
+  js_val *val, *result;
   js_args *cbargs;
   unsigned long i;
   for (i = 0; i < len; i++) {
-    key = JSNUMKEY(i);
-    val = fh_get(instance, key->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, val);
     args_append(cbargs, JSNUM(i));
     args_append(cbargs, instance);
     result = fh_call(state->ctx, this, callback, cbargs);
-    fh_set(map, key->string.ptr, result);
+    fh_set_index(map, i, result);
   }
 
   fh_set_len(map, len);
@@ -668,18 +627,17 @@ arr_proto_some(js_val *instance, js_args *args, eval_state *state)
   js_val *this = ARG(args, 1);
   unsigned long len = instance->object.length;
 
-  js_val *key, *val, *result;
+  js_val *val, *result;
   js_args *cbargs;
   unsigned long i;
   for (i = 0; i < len; i++) {
-    key = JSNUMKEY(i);
-    val = fh_get(instance, key->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, val);
     args_append(cbargs, JSNUM(i));
     args_append(cbargs, instance);
     result = fh_call(state->ctx, this, callback, cbargs);
-    if (TO_BOOL(result)->boolean.val)
+    if (BOOLVAL(TO_BOOL(result)))
       return JSBOOL(1);
   }
 
@@ -701,15 +659,14 @@ arr_proto_reduce(js_val *instance, js_args *args, eval_state *state)
     if (len == 0)
       fh_throw(state, fh_new_error(E_RANGE, "Reduce of empty array with no initial value"));
 
-    reduction = fh_get(instance, "0");
+    reduction = fh_get_index(instance, 0);
     i = 1;
   }
 
-  js_val *key, *val;
+  js_val *val;
   js_args *cbargs;
   for (; i < len; i++) {
-    key = JSNUMKEY(i);
-    val = fh_get(instance, key->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, reduction);
     args_append(cbargs, val);
@@ -736,7 +693,7 @@ arr_proto_reduce_right(js_val *instance, js_args *args, eval_state *state)
     if (len == 0)
       fh_throw(state, fh_new_error(E_RANGE, "Reduce of empty array with no initial value"));
 
-    reduction = fh_get(instance, JSNUMKEY(i)->string.ptr);
+    reduction = fh_get_index(instance, i);
 
     if (len == 1) return reduction;
 
@@ -748,7 +705,7 @@ arr_proto_reduce_right(js_val *instance, js_args *args, eval_state *state)
   js_val *val;
   js_args *cbargs;
   do {
-    val = fh_get(instance, JSNUMKEY(i)->string.ptr);
+    val = fh_get_index(instance, i);
     cbargs = args_new();
     args_append(cbargs, reduction);
     args_append(cbargs, val);
@@ -9,8 +9,10 @@ js_val *
 bool_new(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *value = ARG(args, 0);
-  if (state->construct)
+  if (state->construct) {
     state->this->object.primitive = TO_BOOL(value);
+    fh_gc_barrier(state->this, state->this->object.primitive);
+  }
   return TO_BOOL(value);
 }
 
@@ -18,7 +20,7 @@ bool_new(js_val *instance, js_args *args, eval_state *state)
 js_val *
 bool_proto_to_string(js_val *instance, js_args *args, eval_state *state)
 {
-  return instance->boolean.val ? JSSTR("true") : JSSTR("false");
+  return BOOLVAL(instance) ? JSSTR("true") : JSSTR("false");
 }
 
 // Boolean.prototype.valueOf()
@@ -51,6 +53,7 @@ bootstrap_boolean()
   DEF(prototype, "valueOf", JSNFUNC(bool_proto_value_of, 0));
 
   fh_attach_prototype(prototype, fh->function_proto);
+  fh->boolean_proto = prototype;
 
   return boolean;
 }
@@ -610,7 +610,7 @@ make_date_from_args(js_args *args, double t, int shift, int max_args)
     if (shift <= i && (i - shift) < max_args) {
       arg = ARG(args, j++);
       if (!IS_UNDEF(arg) || j == 1) {
-        parts[i] = TO_NUM(arg)->number.val;
+        parts[i] = NUMVAL(TO_NUM(arg));
         continue;
       }
     }
@@ -644,12 +644,12 @@ ms_from_args(js_args *args)
           *mil = IS_UNDEF(ms) ? JSNUM(0) : TO_NUM(ms);
 
   // Resolve a 2-digit year to 4 digits, relative to the 20th century.
-  long yi = floor(y->number.val);
+  long yi = floor(NUMVAL(y));
   if (yi >= 0 && yi <= 99)
     yi = 1900 + yi;
 
-  double day = make_day(yi, m->number.val, dt->number.val);
-  double time = make_time(h->number.val, min->number.val, s->number.val, mil->number.val);
+  double day = make_day(yi, NUMVAL(m), NUMVAL(dt));
+  double time = make_time(NUMVAL(h), NUMVAL(min), NUMVAL(s), NUMVAL(mil));
   return time_clip(make_date(day, time));
 }
 
@@ -680,7 +680,7 @@ date_new(js_val *instance, js_args *args, eval_state *state)
   else if (len == 1) {
     js_val *arg = ARG(args, 0);
     if (IS_NUM(arg))
-      utc = JSNUM(arg->number.val);
+      utc = JSNUM(NUMVAL(arg));
     else
       utc = date_parse_str(TO_STR(arg)->string.ptr);
   }
@@ -692,6 +692,7 @@ date_new(js_val *instance, js_args *args, eval_state *state)
 
   fh_set_class(state->this, "Date");
   state->this->object.primitive = utc;
+  fh_gc_barrier(state->this, utc);
   return state->this;
 }
 
@@ -735,74 +736,87 @@ date_is_dst(js_val *instance, js_args *args, eval_state *state)
 // Date Prototype
 // ----------------------------------------------------------------------------
 
+// Dates are passed to their methods as the wrapper object, since the time
+// value it holds is immutable and setters have to replace it.
+#define TIMEVAL(date) NUMVAL((date)->object.primitive)
+
+static js_val *
+date_set_value(js_val *date, double t)
+{
+  js_val *utc = JSNUM(t);
+  date->object.primitive = utc;
+  fh_gc_barrier(date, utc);
+  return utc;
+}
+
 // Date.prototype.getDate()
 js_val *
 date_proto_get_date(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(date_from_time(local_time(instance->number.val)));
+  return JSNUM(date_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getDay()
 js_val *
 date_proto_get_day(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(week_day(local_time(instance->number.val)));
+  return JSNUM(week_day(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getFullYear()
 js_val *
 date_proto_get_full_year(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(year_from_time(local_time(instance->number.val)));
+  return JSNUM(year_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getHours()
 js_val *
 date_proto_get_hours(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(hour_from_time(local_time(instance->number.val)));
+  return JSNUM(hour_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getMilliseconds()
 js_val *
 date_proto_get_milliseconds(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(ms_from_time(local_time(instance->number.val)));
+  return JSNUM(ms_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getMinutes()
 js_val *
 date_proto_get_minutes(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(min_from_time(local_time(instance->number.val)));
+  return JSNUM(min_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getMonth()
 js_val *
 date_proto_get_month(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(month_from_time(local_time(instance->number.val)));
+  return JSNUM(month_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getSeconds()
 js_val *
 date_proto_get_seconds(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(sec_from_time(local_time(instance->number.val)));
+  return JSNUM(sec_from_time(local_time(TIMEVAL(instance))));
 }
 
 // Date.prototype.getTime()
 js_val *
 date_proto_get_time(js_val *instance, js_args *args, eval_state *state)
 {
-  return instance;
+  return instance->object.primitive;
 }
 
 // Date.prototype.getTimezoneOffset()
 js_val *
 date_proto_get_timezone_offset(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
+  double t = TIMEVAL(instance);
   return JSNUM((t - local_time(t)) / ms_per_min);
 }
 
@@ -810,63 +824,63 @@ date_proto_get_timezone_offset(js_val *instance, js_args *args, eval_state *stat
 js_val *
 date_proto_get_utc_date(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(date_from_time(instance->number.val));
+  return JSNUM(date_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCDay()
 js_val *
 date_proto_get_utc_day(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(week_day(instance->number.val));
+  return JSNUM(week_day(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCFullYear()
 js_val *
 date_proto_get_utc_full_year(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(year_from_time(instance->number.val));
+  return JSNUM(year_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCHours()
 js_val *
 date_proto_get_utc_hours(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(hour_from_time(instance->number.val));
+  return JSNUM(hour_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCMilliseconds()
 js_val *
 date_proto_get_utc_milliseconds(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(ms_from_time(instance->number.val));
+  return JSNUM(ms_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCMinutes()
 js_val *
 date_proto_get_utc_minutes(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(min_from_time(instance->number.val));
+  return JSNUM(min_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCMonth()
 js_val *
 date_proto_get_utc_month(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(month_from_time(instance->number.val));
+  return JSNUM(month_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getUTCSeconds()
 js_val *
 date_proto_get_utc_seconds(js_val *instance, js_args *args, eval_state *state)
 {
-  return JSNUM(sec_from_time(instance->number.val));
+  return JSNUM(sec_from_time(TIMEVAL(instance)));
 }
 
 // Date.prototype.getYear()
 js_val *
 date_proto_get_year(js_val *instance, js_args *args, eval_state *state)
 {
-  int y = year_from_time(local_time(instance->number.val));
+  int y = year_from_time(local_time(TIMEVAL(instance)));
   return JSNUM(y - 1900);
 }
 
@@ -874,166 +888,150 @@ date_proto_get_year(js_val *instance, js_args *args, eval_state *state)
 js_val *
 date_proto_set_date(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 2, 1)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 2, 1))));
 }
 
 // Date.prototype.setFullYear(yearValue[, monthValue[, dayValue]])
 js_val *
 date_proto_set_full_year(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 0, 3)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 0, 3))));
 }
 
 // Date.prototype.setHours(hourValue[, minutesValue[, secondsValue[, msValue]]])
 js_val *
 date_proto_set_hours(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 3, 4)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 3, 4))));
 }
 
 // Date.prototype.setMilliseconds(msValue)
 js_val *
 date_proto_set_milliseconds(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 6, 1)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 6, 1))));
 }
 
 // Date.prototype.setMinutes(minutesValue[, secondsValue[, msValue]])
 js_val *
 date_proto_set_minutes(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 4, 3)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 4, 3))));
 }
 
 // Date.prototype.setMonth(monthValue[, dayValue])
 js_val *
 date_proto_set_month(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 1, 2)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 1, 2))));
 }
 
 // Date.prototype.setSeconds(secondsValue[, msValue])
 js_val *
 date_proto_set_seconds(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
-  instance->number.val = utc_time(time_clip(make_date_from_args(args, t, 5, 2)));
-  return instance;
+  double t = local_time(TIMEVAL(instance));
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(args, t, 5, 2))));
 }
 
 // Date.prototype.setTime(timeValue)
 js_val *
 date_proto_set_time(js_val *instance, js_args *args, eval_state *state)
 {
-  instance->number.val = time_clip(TO_NUM(ARG(args, 0))->number.val);
-  return instance;
+  return date_set_value(instance, time_clip(NUMVAL(TO_NUM(ARG(args, 0)))));
 }
 
 // Date.prototype.setUTCDate(dayValue)
 js_val *
 date_proto_set_utc_date(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 2, 1));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 2, 1)));
 }
 
 // Date.prototype.setUTCFullYear(yearValue[, monthValue[, dayValue]])
 js_val *
 date_proto_set_utc_full_year(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 0, 3));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 0, 3)));
 }
 
 // Date.prototype.setUTCHours(hoursValue[, minutesValue[, secondsValue[, msValue]]])
 js_val *
 date_proto_set_utc_hours(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 3, 4));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 3, 4)));
 }
 
 // Date.prototype.setUTCMilliseconds(msValue)
 js_val *
 date_proto_set_utc_milliseconds(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 6, 1));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 6, 1)));
 }
 
 // Date.prototype.setUTCMinutes(minutesValue[, secondsValue[, msValue]])
 js_val *
 date_proto_set_utc_minutes(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 4, 3));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 4, 3)));
 }
 
 // Date.prototype.setUTCMonth(monthValue[, dayValue])
 js_val *
 date_proto_set_utc_month(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 1, 2));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 1, 2)));
 }
 
 // Date.prototype.setUTCSeconds(secondsValue[, msValue])
 js_val *
 date_proto_set_utc_seconds(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = instance->number.val;
-  instance->number.val = time_clip(make_date_from_args(args, t, 5, 2));
-  return instance;
+  double t = TIMEVAL(instance);
+  return date_set_value(instance, time_clip(make_date_from_args(args, t, 5, 2)));
 }
 
 // Date.prototype.setYear(yearValue)
 js_val *
 date_proto_set_year(js_val *instance, js_args *args, eval_state *state)
 {
-  double t = local_time(instance->number.val);
+  double t = local_time(TIMEVAL(instance));
 
   // Adjust the year argument and put it back
-  int y = TO_NUM(ARG(args, 0))->number.val;
+  int y = NUMVAL(TO_NUM(ARG(args, 0)));
   if (y >= 0 && y <= 99)
     y += 1900;
   js_args *new_args = args_new();
   args_append(new_args, JSNUM(y));
 
   // Same procedure as setFullYear, but with no additional parameters
-  instance->number.val = utc_time(time_clip(make_date_from_args(new_args, t, 0, 1)));
-  return instance;
+  return date_set_value(instance, utc_time(time_clip(make_date_from_args(new_args, t, 0, 1))));
 }
 
 // Date.prototype.toDateString()
 js_val *
 date_proto_to_date_string(js_val *instance, js_args *args, eval_state *state)
 {
-  return date_format_loc(instance->number.val, true, false);
+  return date_format_loc(TIMEVAL(instance), true, false);
 }
 
 // Date.prototype.toISOString()
 js_val *
 date_proto_to_iso_string(js_val *instance, js_args *args, eval_state *state)
 {
-  return date_format_iso(instance->number.val);
+  return date_format_iso(TIMEVAL(instance));
 }
 
 // Date.prototype.toLocaleDateString()
@@ -1061,28 +1059,28 @@ date_proto_to_locale_time_string(js_val *instance, js_args *args, eval_state *st
 js_val *
 date_proto_to_string(js_val *instance, js_args *args, eval_state *state)
 {
-  return date_format_loc(instance->number.val, true, true);
+  return date_format_loc(TIMEVAL(instance), true, true);
 }
 
 // Date.prototype.toTimeString()
 js_val *
 date_proto_to_time_string(js_val *instance, js_args *args, eval_state *state)
 {
-  return date_format_loc(instance->number.val, false, true);
+  return date_format_loc(TIMEVAL(instance), false, true);
 }
 
 // Date.prototype.toUTCString()
 js_val *
 date_proto_to_utc_string(js_val *instance, js_args *args, eval_state *state)
 {
-  return date_format_utc(instance->number.val);
+  return date_format_utc(TIMEVAL(instance));
 }
 
 // Date.prototype.valueOf()
 js_val *
 date_proto_value_of(js_val *instance, js_args *args, eval_state *state)
 {
-  return instance;
+  return instance->object.primitive;
 }
 
 
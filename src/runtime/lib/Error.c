@@ -16,6 +16,7 @@ error_new(js_val *instance, js_args *args, eval_state *state)
     fh_set(err, "message", TO_STR(msg));
 
   err->proto = fh_try_get_proto("Error");
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -26,6 +27,7 @@ error_eval_new(js_val *instance, js_args *args, eval_state *state)
   js_val *err = error_new(instance, args, state);
   fh_set(err, "name", JSSTR(E_EVAL));
   err->proto = fh_try_get_proto(E_EVAL);
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -36,6 +38,7 @@ error_range_new(js_val *instance, js_args *args, eval_state *state)
   js_val *err = error_new(instance, args, state);
   fh_set(err, "name", JSSTR(E_RANGE));
   err->proto = fh_try_get_proto(E_RANGE);
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -46,6 +49,7 @@ error_ref_new(js_val *instance, js_args *args, eval_state *state)
   js_val *err = error_new(instance, args, state);
   fh_set(err, "name", JSSTR(E_REFERENCE));
   err->proto = fh_try_get_proto(E_REFERENCE);
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -56,6 +60,7 @@ error_syntax_new(js_val *instance, js_args *args, eval_state *state)
   js_val *err = error_new(instance, args, state);
   fh_set(err, "name", JSSTR(E_SYNTAX));
   err->proto = fh_try_get_proto(E_SYNTAX);
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -66,6 +71,7 @@ error_type_new(js_val *instance, js_args *args, eval_state *state)
   js_val *err = error_new(instance, args, state);
   fh_set(err, "name", JSSTR(E_TYPE));
   err->proto = fh_try_get_proto(E_TYPE);
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -76,6 +82,7 @@ error_uri_new(js_val *instance, js_args *args, eval_state *state)
   js_val *err = error_new(instance, args, state);
   fh_set(err, "name", JSSTR(E_URI));
   err->proto = fh_try_get_proto(E_URI);
+  fh_gc_barrier(err, err->proto);
   return err;
 }
 
@@ -15,7 +15,9 @@ func_new(js_val *instance, js_args *args, eval_state *state)
 
   for (i = 0; arglen > 0 && i < (arglen - 1); i++) {
     if (!arg_lst) {
-      arg_lst = TO_STR(ARG(args, i))->string.ptr;
+      tmp = TO_STR(ARG(args, i))->string.ptr;
+      arg_lst = malloc((strlen(tmp) + 1) * sizeof(char));
+      strcpy(arg_lst, tmp);
     }
     else {
       tmp = arg_lst;
@@ -49,9 +51,10 @@ func_proto_apply(js_val *instance, js_args *args, eval_state *state)
 
   js_args *func_args = args_new();
 
-  unsigned long i;
-  for (i = 0; i < arr->object.length; i++)
-    args_append(func_args, fh_get(arr, JSNUMKEY(i)->string.ptr));
+  // Any array-like will do, arguments objects included.
+  unsigned long i, len = IS_OBJ(arr) ? NUMVAL(TO_NUM(fh_get(arr, "length"))) : 0;
+  for (i = 0; i < len; i++)
+    args_append(func_args, fh_get_index(arr, i));
 
   return fh_call(state->ctx, this, instance, func_args);
 }
@@ -70,6 +73,9 @@ func_proto_bind(js_val *instance, js_args *args, eval_state *state)
   js_val *func = JSFUNC(instance->object.node);
   func->object.bound_this = this;
   func->object.bound_args = args;
+  fh_gc_barrier(func, this);
+  for (; args != NULL; args = args->next)
+    fh_gc_barrier(func, args->arg);
   return func;
 }
 
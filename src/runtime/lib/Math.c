@@ -14,9 +14,9 @@ js_val *
 math_abs(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  if (x->number.is_nan) return JSNAN();
-  if (x->number.is_inf) return JSINF();
-  return JSNUM(fabs(x->number.val));
+  if (IS_NAN(x)) return JSNAN();
+  if (IS_INF(x)) return JSINF();
+  return JSNUM(fabs(NUMVAL(x)));
 }
 
 // Math.acos(x)
@@ -24,7 +24,7 @@ js_val *
 math_acos(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(acos(x->number.val));
+  return JSNUM(acos(NUMVAL(x)));
 }
 
 // Math.asin(x)
@@ -32,7 +32,7 @@ js_val *
 math_asin(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(asin(x->number.val));
+  return JSNUM(asin(NUMVAL(x)));
 }
 
 // Math.atan(x)
@@ -40,15 +40,15 @@ js_val *
 math_atan(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(atan(x->number.val));
+  return JSNUM(atan(NUMVAL(x)));
 }
 
 // Math.atan2(y, x)
 js_val *
 math_atan2(js_val *instance, js_args *args, eval_state *state)
 {
-  double y = TO_NUM(ARG(args, 0))->number.val;
-  double x = TO_NUM(ARG(args, 1))->number.val;
+  double y = NUMVAL(TO_NUM(ARG(args, 0)));
+  double x = NUMVAL(TO_NUM(ARG(args, 1)));
   return JSNUM(atan2(y, x));
 }
 
@@ -57,9 +57,9 @@ js_val *
 math_ceil(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  if (x->number.is_inf)
-    return x->number.is_neg ? JSNINF() : JSINF();
-  return JSNUM(ceil(x->number.val));
+  if (IS_INF(x))
+    return NUMVAL(x) < 0 ? JSNINF() : JSINF();
+  return JSNUM(ceil(NUMVAL(x)));
 }
 
 // Math.cos(x)
@@ -67,7 +67,7 @@ js_val *
 math_cos(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(cos(x->number.val));
+  return JSNUM(cos(NUMVAL(x)));
 }
 
 // Math.exp(x)
@@ -75,7 +75,7 @@ js_val *
 math_exp(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(exp(x->number.val));
+  return JSNUM(exp(NUMVAL(x)));
 }
 
 // Math.floor(x)
@@ -83,9 +83,9 @@ js_val *
 math_floor(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  if (x->number.is_inf)
-    return x->number.is_neg ? JSNINF() : JSINF();
-  return JSNUM(floor(x->number.val));
+  if (IS_INF(x))
+    return NUMVAL(x) < 0 ? JSNINF() : JSINF();
+  return JSNUM(floor(NUMVAL(x)));
 }
 
 // Math.log(x)
@@ -93,7 +93,7 @@ js_val *
 math_log(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(log(x->number.val));
+  return JSNUM(log(NUMVAL(x)));
 }
 
 // Math.max([value1[,value2[, ...]]])
@@ -105,18 +105,18 @@ math_max(js_val *instance, js_args *args, eval_state *state)
   if (length == 2) {
     js_val *x = TO_NUM(ARG(args, 0)),
             *y = TO_NUM(ARG(args, 1));
-    if (x->number.is_nan || y->number.is_nan) return JSNAN();
-    return x->number.val > y->number.val ? x : y;
+    if (IS_NAN(x) || IS_NAN(y)) return JSNAN();
+    return NUMVAL(x) > NUMVAL(y) ? x : y;
   }
 
   int i;
   js_val *max = TO_NUM(ARG(args, 0));
   js_val *x;
-  if (max->number.is_nan) return JSNAN();
+  if (IS_NAN(max)) return JSNAN();
   for (i = 0; i < (length - 1); i++) {
     x = TO_NUM(ARG(args, i+1));
-    if (x->number.is_nan) return JSNAN();
-    if (x->number.is_inf || x->number.val > max->number.val)
+    if (IS_NAN(x)) return JSNAN();
+    if (IS_INF(x) || NUMVAL(x) > NUMVAL(max))
       max = x;
   };
   return max;
@@ -131,18 +131,18 @@ math_min(js_val *instance, js_args *args, eval_state *state)
   if (length == 2) {
     js_val *x = TO_NUM(ARG(args, 0)),
             *y = TO_NUM(ARG(args, 1));
-    if (x->number.is_nan || y->number.is_nan) return JSNAN();
-    return x->number.val < y->number.val ? x : y;
+    if (IS_NAN(x) || IS_NAN(y)) return JSNAN();
+    return NUMVAL(x) < NUMVAL(y) ? x : y;
   }
 
   int i;
   js_val *min = TO_NUM(ARG(args, 0));
   js_val *x;
-  if (min->number.is_nan) return JSNAN();
+  if (IS_NAN(min)) return JSNAN();
   for (i = 0; i < (length - 1); i++) {
     x = TO_NUM(ARG(args, i+1));
-    if (x->number.is_nan) return JSNAN();
-    if (x->number.val < min->number.val)
+    if (IS_NAN(x)) return JSNAN();
+    if (NUMVAL(x) < NUMVAL(min))
       min = x;
   };
   return min;
@@ -154,9 +154,9 @@ math_pow(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
   js_val *y = TO_NUM(ARG(args, 1));
-  if (x->number.is_nan || y->number.is_nan)
+  if (IS_NAN(x) || IS_NAN(y))
     return JSNAN();
-  return JSNUM(pow(x->number.val, y->number.val));
+  return JSNUM(pow(NUMVAL(x), NUMVAL(y)));
 }
 
 // Math.random()
@@ -171,7 +171,7 @@ js_val *
 math_round(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(floor(x->number.val + 0.5));
+  return JSNUM(floor(NUMVAL(x) + 0.5));
 }
 
 // Math.sin(x)
@@ -179,7 +179,7 @@ js_val *
 math_sin(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(sin(x->number.val));
+  return JSNUM(sin(NUMVAL(x)));
 }
 
 // Math.sqrt(x)
@@ -187,10 +187,10 @@ js_val *
 math_sqrt(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  if (x->number.is_nan) return JSNAN();
-  if (x->number.is_inf) return JSINF();
-  if (x->number.val < 0) return JSNAN();
-  return JSNUM(sqrt(x->number.val));
+  if (IS_NAN(x)) return JSNAN();
+  if (IS_INF(x)) return JSINF();
+  if (NUMVAL(x) < 0) return JSNAN();
+  return JSNUM(sqrt(NUMVAL(x)));
 }
 
 // Math.tan(x)
@@ -198,7 +198,7 @@ js_val *
 math_tan(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *x = TO_NUM(ARG(args, 0));
-  return JSNUM(tan(x->number.val));
+  return JSNUM(tan(NUMVAL(x)));
 }
 
 unsigned long
@@ -13,8 +13,10 @@ js_val *
 number_new(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *value = ARG(args, 0);
-  if (state->construct)
+  if (state->construct) {
     state->this->object.primitive = TO_NUM(value);
+    fh_gc_barrier(state->this, state->this->object.primitive);
+  }
   return TO_NUM(value);
 }
 
@@ -24,11 +26,11 @@ number_proto_to_exponential(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *digits = ARG(args, 0);
 
-  if (instance->number.is_nan || instance->number.is_inf)
+  if (IS_NAN(instance) || IS_INF(instance))
     return TO_STR(instance);
 
-  if (digits->type != T_UNDEF) {
-    if (digits->number.val < 0 || digits->number.val > 20)
+  if (!IS_UNDEF(digits)) {
+    if (NUMVAL(digits) < 0 || NUMVAL(digits) > 20)
       fh_throw(state, fh_new_error(E_RANGE, "fractionDigits must be between 0 and 20"));
   }
 
@@ -36,7 +38,7 @@ number_proto_to_exponential(js_val *instance, js_args *args, eval_state *state)
   int e;
   char *sign;
 
-  x = instance->number.val;
+  x = NUMVAL(instance);
   e = (int)log10(x);
   m = x / pow(10, e);
   if (m < 1) m *= 10, e--;
@@ -44,8 +46,8 @@ number_proto_to_exponential(js_val *instance, js_args *args, eval_state *state)
 
   char *exp_str;
   int size, ndigits;
-  if (digits->type != T_UNDEF) {
-    ndigits = digits->number.val;
+  if (!IS_UNDEF(digits)) {
+    ndigits = NUMVAL(digits);
     size = snprintf(NULL, 0, "%.*fe%s%d", ndigits, m, sign, e);
     exp_str = malloc(size + 1);
     sprintf(exp_str, "%.*fe%s%d", ndigits, m, sign, e);
@@ -62,10 +64,10 @@ number_proto_to_exponential(js_val *instance, js_args *args, eval_state *state)
 js_val *
 number_proto_to_fixed(js_val *instance, js_args *args, eval_state *state)
 {
-  int digits = ARG(args, 0)->type == T_NUMBER ? ARG(args, 0)->number.val : 0;
-  int size = snprintf(NULL, 0, "%.*f", digits, instance->number.val);
+  int digits = IS_NUM(ARG(args, 0)) ? NUMVAL(ARG(args, 0)) : 0;
+  int size = snprintf(NULL, 0, "%.*f", digits, NUMVAL(instance));
   char *exp_str = malloc(size + 1);
-  sprintf(exp_str, "%.*f", digits, instance->number.val);
+  sprintf(exp_str, "%.*f", digits, NUMVAL(instance));
   return JSSTR(exp_str);
 }
 
@@ -84,13 +86,13 @@ number_proto_to_precision(js_val *instance, js_args *args, eval_state *state)
   if (IS_UNDEF(precision))
     return number_proto_to_string(instance, args, state);
 
-  int digits = floor(precision->number.val + 0.5);
+  int digits = floor(NUMVAL(precision) + 0.5);
   if (digits < 1 || digits > 100)
     fh_throw(state, fh_new_error(E_RANGE, "precision must be between 1 and 100"));
 
-  int size = snprintf(NULL, 0, "%.*g", digits, instance->number.val);
+  int size = snprintf(NULL, 0, "%.*g", digits, NUMVAL(instance));
   char *str = malloc(size + 1);
-  sprintf(str, "%.*g", digits, instance->number.val);
+  sprintf(str, "%.*g", digits, NUMVAL(instance));
   return JSSTR(str);
 }
 
@@ -140,6 +142,7 @@ bootstrap_number()
   DEF(prototype, "valueOf", JSNFUNC(number_proto_value_of, 0));
 
   fh_attach_prototype(prototype, fh->function_proto);
+  fh->number_proto = prototype;
 
   return number;
 }
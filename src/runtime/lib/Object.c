@@ -16,11 +16,8 @@ obj_new(js_val *instance, js_args *args, eval_state *state)
   js_val *obj = state->construct ? state->this : JSOBJ();
 
   if (IS_OBJ(value)) return value;
-  if (IS_STR(value) || IS_BOOL(value) || IS_NUM(value)) {
-    js_val *res = TO_OBJ(value);
-    res->proto = value->proto;
-    return res;
-  }
+  if (IS_STR(value) || IS_BOOL(value) || IS_NUM(value))
+    return TO_OBJ(value);
   return obj;
 }
 
@@ -33,6 +30,7 @@ obj_create(js_val *instance, js_args *args, eval_state *state)
 
   js_val *obj = JSOBJ();
   obj->proto = proto;
+  fh_gc_barrier(obj, proto);
 
   if (IS_OBJ(props)) {
     js_prop *p;
@@ -91,7 +89,7 @@ obj_get_own_property_descriptor(js_val *instance, js_args *args, eval_state *sta
 {
   js_val *obj = obj_or_throw(ARG(args, 0), state, "getOwnPropertyDescriptor");
   js_val *prop_name = ARG(args, 1);
-  js_prop *prop = fh_get_prop(obj, prop_name->string.ptr);
+  js_prop view, *prop = fh_get_prop(obj, prop_name->string.ptr, &view);
   js_val *descriptor = JSOBJ();
 
   fh_set(descriptor, "value", prop->ptr);
@@ -113,7 +111,7 @@ obj_keys(js_val *instance, js_args *args, eval_state *state)
   int i = 0;
   OBJ_ITER(obj, p) {
     if (p->enumerable)
-      fh_set(keys, JSNUMKEY(i++)->string.ptr, JSSTR(p->name));
+      fh_set_index(keys, i++, JSSTR(p->name));
   }
 
   fh_set_len(keys, i);
@@ -130,7 +128,7 @@ obj_get_own_property_names(js_val *instance, js_args *args, eval_state *state)
   js_prop *p;
   int i = 0;
   OBJ_ITER(obj, p) {
-    fh_set(names, JSNUMKEY(i++)->string.ptr, JSSTR(p->name));
+    fh_set_index(names, i++, JSSTR(p->name));
   }
 
   fh_set_len(names, i);
@@ -219,7 +217,8 @@ js_val *
 obj_proto_has_own_property(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *prop_name = ARG(args, 0);
-  return JSBOOL(fh_get_prop(instance, prop_name->string.ptr) != NULL);
+  js_prop view;
+  return JSBOOL(fh_get_prop(instance, prop_name->string.ptr, &view) != NULL);
 }
 
 // Object.prototype.isPrototypeOf(object)
@@ -241,7 +240,7 @@ js_val *
 obj_proto_property_is_enumerable(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *prop_name = ARG(args, 0);
-  js_prop *prop = fh_get_prop(instance, prop_name->string.ptr);
+  js_prop view, *prop = fh_get_prop(instance, prop_name->string.ptr, &view);
   return JSBOOL(prop != NULL && prop->enumerable);
 }
 
@@ -282,11 +281,11 @@ flags_from_descriptor(js_val *desc)
   js_val *enumerable = fh_get(desc, "enumerable");
   js_val *configurable = fh_get(desc, "configurable");
   js_val *writable = fh_get(desc, "writable");
-  if (IS_BOOL(enumerable) && enumerable->boolean.val)
+  if (IS_BOOL(enumerable) && BOOLVAL(enumerable))
     flags |= P_ENUM;
-  if (IS_BOOL(configurable) && configurable->boolean.val)
+  if (IS_BOOL(configurable) && BOOLVAL(configurable))
     flags |= P_CONF;
-  if (IS_BOOL(writable) && writable->boolean.val)
+  if (IS_BOOL(writable) && BOOLVAL(writable))
     flags |= P_WRITE;
   return flags;
 }
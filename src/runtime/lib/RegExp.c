@@ -52,15 +52,15 @@ regexp_proto_exec(js_val *instance, js_args *args, eval_state *state)
          *last_ind = fh_get_proto(instance, "lastIndex"),
          *str = TO_STR(ARG(args, 0));
 
-  bool global   = fh_get_proto(instance, "global")->boolean.val;
-  bool caseless = fh_get_proto(instance, "ignoreCase")->boolean.val;
+  bool global   = BOOLVAL(fh_get_proto(instance, "global"));
+  bool caseless = BOOLVAL(fh_get_proto(instance, "ignoreCase"));
 
   bool matched = false;
   int *matches = NULL;
 
   int count;
   int length = strlen(str->string.ptr);
-  int i = fh_to_int32(last_ind)->number.val;
+  int i = NUMVAL(fh_to_int32(last_ind));
 
   if (!global)
     i = 0;
@@ -88,11 +88,11 @@ regexp_proto_exec(js_val *instance, js_args *args, eval_state *state)
   fh_set(res, "index", JSNUM(matches[0]));
   fh_set(res, "input", str);
 
-  fh_set(res, "0", JSSTR(substr));
+  fh_set_index(res, 0, JSSTR(substr));
 
   for (i = 1; i <= count; i++) {
     substr = fh_str_slice(str->string.ptr, matches[2*i], matches[2*i+1]);
-    fh_set(res, JSNUMKEY(i)->string.ptr, JSSTR(substr ? substr : ""));
+    fh_set_index(res, i, JSSTR(substr ? substr : ""));
   }
 
   free(matches);
@@ -107,7 +107,7 @@ regexp_proto_test(js_val *instance, js_args *args, eval_state *state)
 {
   char *str = TO_STR(ARG(args, 0))->string.ptr;
   char *pattern = TO_STR(fh_get(instance, "source"))->string.ptr;
-  bool caseless = fh_get_proto(instance, "ignoreCase")->boolean.val;
+  bool caseless = BOOLVAL(fh_get_proto(instance, "ignoreCase"));
   int count;
   fh_regexp(str, pattern, &count, 0, caseless);
   return JSBOOL(count > 0);
@@ -130,10 +130,10 @@ regexp_proto_to_string(js_val *instance, js_args *args, eval_state *state)
     size,
     "/%s/%s%s%s%s",
     pattern->string.ptr,
-    g->boolean.val ? "g" : "",
-    i->boolean.val ? "i" : "",
-    m->boolean.val ? "m" : "",
-    y->boolean.val ? "y" : ""
+    BOOLVAL(g) ? "g" : "",
+    BOOLVAL(i) ? "i" : "",
+    BOOLVAL(m) ? "m" : "",
+    BOOLVAL(y) ? "y" : ""
   );
 
   js_val *res = JSSTR(new);
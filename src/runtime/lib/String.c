@@ -17,8 +17,10 @@ js_val *
 str_new(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *value = ARGLEN(args) > 0 ? ARG(args, 0) : JSSTR("");
-  if (state->construct)
+  if (state->construct) {
     state->this->object.primitive = TO_STR(value);
+    fh_gc_barrier(state->this, state->this->object.primitive);
+  }
   return TO_STR(value);
 }
 
@@ -44,7 +46,7 @@ str_from_char_code(js_val *instance, js_args *args, eval_state *state)
 js_val *
 str_proto_char_at(js_val *instance, js_args *args, eval_state *state)
 {
-  int index = TO_NUM(ARG(args, 0))->number.val;
+  int index = NUMVAL(TO_INT(ARG(args, 0)));
   int len = instance->string.length;
 
   if (index < 0 || index >= len)
@@ -93,8 +95,9 @@ str_proto_index_of(js_val *instance, js_args *args, eval_state *state)
   char *needle = search_str->string.ptr;
   js_val *from = ARG(args, 1);
 
-  long i = TO_INT(from)->number.val;
+  long i = NUMVAL(TO_INT(from));
   long match = 0;
+  if (i < 0) i = 0;
 
   long needle_len = strlen(needle);
   long haystack_len = strlen(haystack);
@@ -129,28 +132,16 @@ str_proto_last_index_of(js_val *instance, js_args *args, eval_state *state)
   char *haystack = instance->string.ptr;
   char *needle = search_str->string.ptr;
 
-  double max = IS_NUM(from) ? from->number.val : strlen(haystack) - 1;
-  long match = strlen(needle) - 1;
-  long i = strlen(haystack) - 1;
-
   long needle_len = strlen(needle);
   long haystack_len = strlen(haystack);
 
+  double max = IS_NUM(from) && !IS_NAN(from) ? NUMVAL(from) : haystack_len;
   if (max < 0) max = 0;
-  if (max > haystack_len) max = haystack_len - 1;
-
-  if (needle_len == 0)
-    return JSNUM(max <= haystack_len ? max : haystack_len);
+  if (max > haystack_len - needle_len) max = haystack_len - needle_len;
 
-  if (needle_len > haystack_len)
-    return JSNUM(-1);
-
-  for (; i >= 0; i--) {
-    if (haystack[i] == needle[match])
-      match--;
-    else
-      match = needle_len - (haystack[i] == needle[0] ? 2 : 1);
-    if (match < 0 && i <= max)
+  long i;
+  for (i = max; i >= 0; i--) {
+    if (strncmp(haystack + i, needle, needle_len) == 0)
       return JSNUM(i);
   }
 
@@ -175,7 +166,7 @@ str_proto_match(js_val *instance, js_args *args, eval_state *state)
 
   js_args *exec_args;
 
-  bool global = fh_get_proto(regexp, "global")->boolean.val;
+  bool global = BOOLVAL(fh_get_proto(regexp, "global"));
   if (!global) {
     exec_args = args_new();
     args_append(exec_args, instance);
@@ -197,7 +188,7 @@ str_proto_match(js_val *instance, js_args *args, eval_state *state)
       last_match = false;
       break;
     }
-    this_ind = TO_NUM(fh_get(regexp, "lastIndex"))->number.val;
+    this_ind = NUMVAL(TO_NUM(fh_get(regexp, "lastIndex")));
     if (this_ind == prev_last_ind) {
       fh_set(regexp, "lastIndex", JSNUM(this_ind + 1));
       prev_last_ind = this_ind + 1;
@@ -205,8 +196,8 @@ str_proto_match(js_val *instance, js_args *args, eval_state *state)
     else {
       prev_last_ind = this_ind;
     }
-    match_str = fh_get(result, "0");
-    fh_set(arr, JSNUMKEY(n)->string.ptr, match_str);
+    match_str = fh_get_index(result, 0);
+    fh_set_index(arr, n, match_str);
     n++;
   }
 
@@ -247,8 +238,8 @@ str_proto_replace(js_val *instance, js_args *args, eval_state *state)
     return JSSTR(fh_str_replace(str, search, replace, 1));
   }
 
-  bool global = TO_BOOL(fh_get_proto(search_val, "global"))->boolean.val,
-       caseless = TO_BOOL(fh_get_proto(search_val, "ignoreCase"))->boolean.val;
+  bool global = BOOLVAL(TO_BOOL(fh_get_proto(search_val, "global"))),
+       caseless = BOOLVAL(TO_BOOL(fh_get_proto(search_val, "ignoreCase")));
 
   char *pattern = fh_get(search_val, "source")->string.ptr;
   char *repl = TO_STR(replace_val)->string.ptr;
@@ -289,7 +280,7 @@ str_proto_search(js_val *instance, js_args *args, eval_state *state)
   }
 
   char *pattern = fh_get(regexp, "source")->string.ptr;
-  bool caseless = fh_get_proto(regexp, "ignoreCase")->boolean.val;
+  bool caseless = BOOLVAL(fh_get_proto(regexp, "ignoreCase"));
   int count, *matches = fh_regexp(str, pattern, &count, 0, caseless);
 
   if (!matches)
@@ -306,8 +297,8 @@ str_proto_slice(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *end_arg = ARG(args, 1);
   int len = strlen(instance->string.ptr);
-  int end = IS_UNDEF(end_arg) ? len : TO_NUM(end_arg)->number.val;
-  int start = TO_NUM(ARG(args, 0))->number.val;
+  int end = IS_UNDEF(end_arg) ? len : NUMVAL(TO_NUM(end_arg));
+  int start = NUMVAL(TO_NUM(ARG(args, 0)));
 
   if (start < 0) start = len + start > 0 ? len + start : 0;
   if (end < 0) end = len + end > 0 ? len + end : 0;
@@ -322,7 +313,7 @@ regexp_splitter(char *str, js_val *regexp, int limit)
 {
   // TODO: splice matches of captured groups
   char *source = TO_STR(fh_get_proto(regexp, "source"))->string.ptr;
-  bool caseless = TO_BOOL(fh_get_proto(regexp, "ignoreCase"))->boolean.val;
+  bool caseless = BOOLVAL(TO_BOOL(fh_get_proto(regexp, "ignoreCase")));
   // int ncaps = fh_regexp_ncaptures(source);
   js_val *arr = JSARR();
   int count, *matches;
@@ -335,7 +326,7 @@ regexp_splitter(char *str, js_val *regexp, int limit)
     matches = fh_regexp(str, source, &count, i, caseless);
     if (count == 0) break;
     tmp = fh_str_slice(str, i, matches[0]);
-    fh_set(arr, JSNUMKEY(j)->string.ptr, JSSTR(tmp));
+    fh_set_index(arr, j, JSSTR(tmp));
     i = matches[1];
     free(matches);
     matched_last = true;
@@ -343,10 +334,10 @@ regexp_splitter(char *str, js_val *regexp, int limit)
 
   if (i < strlen(str)) {
     tmp = fh_str_slice(str, i, strlen(str));
-    fh_set(arr, JSNUMKEY(j++)->string.ptr, JSSTR(tmp));
+    fh_set_index(arr, j++, JSSTR(tmp));
   }
   else if (matched_last)
-    fh_set(arr, JSNUMKEY(j++)->string.ptr, JSSTR(""));
+    fh_set_index(arr, j++, JSSTR(""));
 
   fh_set_len(arr, j);
   return arr;
@@ -363,7 +354,7 @@ str_proto_split(js_val *instance, js_args *args, eval_state *state)
   js_val *arr = JSARR();
 
   unsigned long limit = IS_UNDEF(limit_arg) ?
-    pow(2, 32) - 1 : TO_UINT32(limit_arg)->number.val;
+    pow(2, 32) - 1 : NUMVAL(TO_UINT32(limit_arg));
 
   if (limit == 0)
     return arr;
@@ -398,7 +389,7 @@ str_proto_split(js_val *instance, js_args *args, eval_state *state)
 
     if (match == (int)strlen(sep)) {
       split = fh_str_slice(str, start, i - strlen(sep) + 1);
-      fh_set(arr, JSNUMKEY(index++)->string.ptr, JSSTR(split));
+      fh_set_index(arr, index++, JSSTR(split));
       free(split);
       start = i + 1;
       match = 0;
@@ -411,11 +402,11 @@ str_proto_split(js_val *instance, js_args *args, eval_state *state)
   if (limit > 0) {
     if (start != len) {
       split = fh_str_slice(str, start, len);
-      fh_set(arr, JSNUMKEY(index++)->string.ptr, JSSTR(split));
+      fh_set_index(arr, index++, JSSTR(split));
       free(split);
     }
     else if (matched_last && strlen(sep))
-      fh_set(arr, JSNUMKEY(index++)->string.ptr, JSSTR(""));
+      fh_set_index(arr, index++, JSSTR(""));
   }
 
   fh_set_len(arr, index);
@@ -427,8 +418,8 @@ js_val *
 str_proto_substr(js_val *instance, js_args *args, eval_state *state)
 {
   long slen = instance->string.length;
-  long start = TO_INT(ARG(args, 0))->number.val;
-  long length = IS_UNDEF(ARG(args, 1)) ?  slen : TO_INT(ARG(args, 1))->number.val;
+  long start = NUMVAL(TO_INT(ARG(args, 0)));
+  long length = IS_UNDEF(ARG(args, 1)) ?  slen : NUMVAL(TO_INT(ARG(args, 1)));
 
   if (start < 0)
     start = MAX(start + slen, 0);
@@ -445,8 +436,8 @@ js_val *
 str_proto_substring(js_val *instance, js_args *args, eval_state *state)
 {
   long len = instance->string.length;
-  long start = TO_INT(ARG(args, 0))->number.val;
-  int end = IS_UNDEF(ARG(args, 1)) ? len : TO_INT(ARG(args, 1))->number.val;
+  long start = NUMVAL(TO_INT(ARG(args, 0)));
+  int end = IS_UNDEF(ARG(args, 1)) ? len : NUMVAL(TO_INT(ARG(args, 1)));
 
   start = MIN(MAX(start, 0), len);
   end = MIN(MAX(end, 0), len);
@@ -595,6 +586,7 @@ bootstrap_string()
   DEF(prototype, "valueOf", JSNFUNC(str_proto_value_of, 0));
 
   fh_attach_prototype(prototype, fh->function_proto);
+  fh->string_proto = prototype;
 
   return string;
 }
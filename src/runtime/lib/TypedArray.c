@@ -0,0 +1,556 @@
+// TypedArray.c
+// ------------
+// ArrayBuffer, typed array and DataView properties, methods, and prototypes
+//
+// An ArrayBuffer owns a block of bytes. Typed arrays and DataViews are windows
+// onto part of one, so a write through any of them is seen by the rest. Typed
+// array elements are read and written by index in props.c.
+//
+// Known issues:
+//  - map and filter aren't implemented, and the typed arrays' length, buffer,
+//    byteOffset and byteLength are own read-only props rather than getters.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TypedArray.h"
+#include "Array.h"
+
+static char *type_names[] = {
+  [TA_NONE] = "ArrayBuffer",
+  [TA_INT8] = "Int8Array",
+  [TA_UINT8] = "Uint8Array",
+  [TA_UINT8_CLAMPED] = "Uint8ClampedArray",
+  [TA_INT16] = "Int16Array",
+  [TA_UINT16] = "Uint16Array",
+  [TA_INT32] = "Int32Array",
+  [TA_UINT32] = "Uint32Array",
+  [TA_FLOAT32] = "Float32Array",
+  [TA_FLOAT64] = "Float64Array"
+};
+
+
+// ----------------------------------------------------------------------------
+// Helpers
+// ----------------------------------------------------------------------------
+
+// A non-negative integer argument small enough to index with.
+static unsigned long
+to_index(js_val *arg, char *what, eval_state *state)
+{
+  double d = NUMVAL(TO_INT(arg));
+  if (d < 0 || d >= ARRAY_INDEX_MAX)
+    fh_throw(state, fh_new_error(E_RANGE, "Invalid %s", what));
+  return d;
+}
+
+// A begin or end argument, counted from the end if negative and clamped to
+// [0, len].
+static unsigned long
+relative_index(js_val *arg, unsigned long len, unsigned long dflt)
+{
+  if (IS_UNDEF(arg)) return dflt;
+  double d = NUMVAL(TO_INT(arg));
+  if (d < 0) return d + len < 0 ? 0 : d + len;
+  return d > len ? len : d;
+}
+
+// The length of an array-like value.
+static unsigned long
+length_of(js_val *obj, eval_state *state)
+{
+  if (IS_ARR(obj) || IS_TYPED(obj)) return obj->object.length;
+  if (!IS_OBJ(obj)) return 0;
+  return to_index(fh_get_proto(obj, "length"), "array length", state);
+}
+
+static bool
+is_buffer(js_val *val)
+{
+  return IS_OBJ(val) && val->object.binary && !val->object.binary->buffer;
+}
+
+static js_val *
+buffer_create(unsigned long byte_length, eval_state *state)
+{
+  unsigned char *bytes = calloc(byte_length ? byte_length : 1, 1);
+  if (!bytes)
+    fh_throw(state, fh_new_error(E_RANGE, "Array buffer allocation failed"));
+
+  js_val *buf = JSOBJ();
+  buf->proto = fh_try_get_proto("ArrayBuffer");
+  fh_gc_barrier(buf, buf->proto);
+  fh_set_class(buf, "ArrayBuffer");
+
+  js_binary *bin = malloc(sizeof(js_binary));
+  bin->bytes = bytes;
+  bin->byte_length = byte_length;
+  bin->buffer = NULL;
+  bin->type = TA_NONE;
+  buf->object.binary = bin;
+
+  DEF2(buf, "byteLength", JSNUM(byte_length), P_NONE);
+  return buf;
+}
+
+// Make an object a view of some of a buffer's bytes.
+static void
+view_init(js_val *obj, js_elem_type type, js_val *buffer,
+          unsigned long offset, unsigned long byte_length)
+{
+  js_binary *bin = malloc(sizeof(js_binary));
+  bin->bytes = buffer->object.binary->bytes + offset;
+  bin->byte_length = byte_length;
+  bin->buffer = buffer;
+  bin->type = type;
+  obj->object.binary = bin;
+  fh_gc_barrier(obj, buffer);
+
+  DEF2(obj, "buffer", buffer, P_NONE);
+  DEF2(obj, "byteOffset", JSNUM(offset), P_NONE);
+  DEF2(obj, "byteLength", JSNUM(byte_length), P_NONE);
+}
+
+static js_val *
+typed_create(js_elem_type type, js_val *buffer, unsigned long offset,
+             unsigned long len)
+{
+  js_val *arr = JSOBJ();
+  arr->proto = fh_try_get_proto(type_names[type]);
+  fh_gc_barrier(arr, arr->proto);
+  fh_set_class(arr, type_names[type]);
+
+  view_init(arr, type, buffer, offset, len * fh_elem_size(type));
+  arr->object.length = len;
+  DEF2(arr, "length", JSNUM(len), P_NONE);
+  return arr;
+}
+
+static void
+check_typed(js_val *instance, eval_state *state)
+{
+  if (!IS_TYPED(instance))
+    fh_throw(state, fh_new_error(E_TYPE, "this is not a typed array"));
+}
+
+// Where a typed array's element is stored.
+static unsigned char *
+elem_ptr(js_val *arr, unsigned long i)
+{
+  js_binary *bin = arr->object.binary;
+  return bin->bytes + i * fh_elem_size(bin->type);
+}
+
+
+// ----------------------------------------------------------------------------
+// ArrayBuffer
+// ----------------------------------------------------------------------------
+
+// new ArrayBuffer(length)
+js_val *
+buf_new(js_val *instance, js_args *args, eval_state *state)
+{
+  return buffer_create(to_index(ARG(args, 0), "array buffer length", state), state);
+}
+
+// ArrayBuffer.isView(arg)
+js_val *
+buf_is_view(js_val *instance, js_args *args, eval_state *state)
+{
+  js_val *arg = ARG(args, 0);
+  return JSBOOL(IS_OBJ(arg) && arg->object.binary && arg->object.binary->buffer);
+}
+
+// ArrayBuffer.prototype.slice(begin[, end])
+js_val *
+buf_proto_slice(js_val *instance, js_args *args, eval_state *state)
+{
+  if (!is_buffer(instance))
+    fh_throw(state, fh_new_error(E_TYPE, "this is not an ArrayBuffer"));
+
+  unsigned long len = instance->object.binary->byte_length;
+  unsigned long begin = relative_index(ARG(args, 0), len, 0);
+  unsigned long end = relative_index(ARG(args, 1), len, len);
+  if (end < begin) end = begin;
+
+  js_val *slice = buffer_create(end - begin, state);
+  memcpy(slice->object.binary->bytes, instance->object.binary->bytes + begin,
+         end - begin);
+  return slice;
+}
+
+
+// ----------------------------------------------------------------------------
+// Typed Arrays
+// ----------------------------------------------------------------------------
+
+// [new] Int8Array(length|array|typedArray|buffer[, byteOffset[, length]]), and
+// likewise for the other element types.
+static js_val *
+typed_new(js_elem_type type, js_args *args, eval_state *state)
+{
+  js_val *arg = ARG(args, 0);
+  unsigned size = fh_elem_size(type);
+  unsigned long len;
+
+  // A view of an existing buffer
+  if (is_buffer(arg)) {
+    unsigned long byte_length = arg->object.binary->byte_length;
+    unsigned long offset = to_index(ARG(args, 1), "typed array offset", state);
+    if (offset % size != 0)
+      fh_throw(state, fh_new_error(E_RANGE,
+        "Start offset of %s should be a multiple of %u", type_names[type], size));
+    if (offset > byte_length)
+      fh_throw(state, fh_new_error(E_RANGE,
+        "Start offset %lu is outside the bounds of the buffer", offset));
+
+    if (IS_UNDEF(ARG(args, 2))) {
+      if ((byte_length - offset) % size != 0)
+        fh_throw(state, fh_new_error(E_RANGE,
+          "Byte length of %s should be a multiple of %u", type_names[type], size));
+      len = (byte_length - offset) / size;
+    }
+    else {
+      len = to_index(ARG(args, 2), "typed array length", state);
+      if (offset + len * size > byte_length)
+        fh_throw(state, fh_new_error(E_RANGE, "Invalid typed array length: %lu", len));
+    }
+    return typed_create(type, arg, offset, len);
+  }
+
+  // A copy of an array-like
+  if (IS_OBJ(arg)) {
+    len = length_of(arg, state);
+    js_val *arr = typed_create(type, buffer_create(len * size, state), 0, len);
+    unsigned long i;
+    for (i = 0; i < len; i++)
+      fh_write_elem(type, elem_ptr(arr, i), fh_get_index(arg, i));
+    return arr;
+  }
+
+  len = to_index(arg, "typed array length", state);
+  return typed_create(type, buffer_create(len * size, state), 0, len);
+}
+
+#define TYPED_NEW(name, type) \
+  js_val * \
+  typed_##name##_new(js_val *instance, js_args *args, eval_state *state) \
+  { \
+    return typed_new(type, args, state); \
+  }
+
+TYPED_NEW(int8, TA_INT8)
+TYPED_NEW(uint8, TA_UINT8)
+TYPED_NEW(uint8_clamped, TA_UINT8_CLAMPED)
+TYPED_NEW(int16, TA_INT16)
+TYPED_NEW(uint16, TA_UINT16)
+TYPED_NEW(int32, TA_INT32)
+TYPED_NEW(uint32, TA_UINT32)
+TYPED_NEW(float32, TA_FLOAT32)
+TYPED_NEW(float64, TA_FLOAT64)
+
+static js_native_function *typed_constructors[] = {
+  [TA_INT8] = typed_int8_new,
+  [TA_UINT8] = typed_uint8_new,
+  [TA_UINT8_CLAMPED] = typed_uint8_clamped_new,
+  [TA_INT16] = typed_int16_new,
+  [TA_UINT16] = typed_uint16_new,
+  [TA_INT32] = typed_int32_new,
+  [TA_UINT32] = typed_uint32_new,
+  [TA_FLOAT32] = typed_float32_new,
+  [TA_FLOAT64] = typed_float64_new
+};
+
+// TypedArray.prototype.fill(value[, begin[, end]])
+js_val *
+typed_proto_fill(js_val *instance, js_args *args, eval_state *state)
+{
+  check_typed(instance, state);
+  js_val *value = TO_NUM(ARG(args, 0));
+  unsigned long len = instance->object.length;
+  unsigned long i = relative_index(ARG(args, 1), len, 0);
+  unsigned long end = relative_index(ARG(args, 2), len, len);
+
+  js_elem_type type = instance->object.binary->type;
+  for (; i < end; i++)
+    fh_write_elem(type, elem_ptr(instance, i), value);
+  return instance;
+}
+
+// TypedArray.prototype.set(array[, offset])
+js_val *
+typed_proto_set(js_val *instance, js_args *args, eval_state *state)
+{
+  check_typed(instance, state);
+  js_val *src = ARG(args, 0);
+  unsigned long offset = to_index(ARG(args, 1), "offset", state);
+  unsigned long len = length_of(src, state);
+  if (offset + len > instance->object.length)
+    fh_throw(state, fh_new_error(E_RANGE, "Source is too large"));
+
+  js_elem_type type = instance->object.binary->type;
+  unsigned long i;
+  if (!IS_TYPED(src)) {
+    for (i = 0; i < len; i++)
+      fh_write_elem(type, elem_ptr(instance, offset + i), fh_get_index(src, i));
+    return JSUNDEF();
+  }
+
+  // The source may be another view of the same bytes, so take a copy of them
+  // unless they can be moved as they are.
+  js_elem_type src_type = src->object.binary->type;
+  unsigned src_size = fh_elem_size(src_type);
+  if (src_type == type) {
+    memmove(elem_ptr(instance, offset), elem_ptr(src, 0), len * src_size);
+    return JSUNDEF();
+  }
+
+  unsigned char *bytes = malloc(len * src_size + 1);
+  memcpy(bytes, elem_ptr(src, 0), len * src_size);
+  for (i = 0; i < len; i++) {
+    js_val *val = fh_read_elem(src_type, bytes + i * src_size);
+    fh_write_elem(type, elem_ptr(instance, offset + i), val);
+  }
+  free(bytes);
+  return JSUNDEF();
+}
+
+// TypedArray.prototype.slice([begin[, end]])
+js_val *
+typed_proto_slice(js_val *instance, js_args *args, eval_state *state)
+{
+  check_typed(instance, state);
+  unsigned long len = instance->object.length;
+  unsigned long begin = relative_index(ARG(args, 0), len, 0);
+  unsigned long end = relative_index(ARG(args, 1), len, len);
+  if (end < begin) end = begin;
+
+  js_elem_type type = instance->object.binary->type;
+  unsigned size = fh_elem_size(type);
+  js_val *buf = buffer_create((end - begin) * size, state);
+  js_val *slice = typed_create(type, buf, 0, end - begin);
+  memcpy(elem_ptr(slice, 0), elem_ptr(instance, begin), (end - begin) * size);
+  return slice;
+}
+
+// TypedArray.prototype.subarray([begin[, end]])
+js_val *
+typed_proto_subarray(js_val *instance, js_args *args, eval_state *state)
+{
+  check_typed(instance, state);
+  unsigned long len = instance->object.length;
+  unsigned long begin = relative_index(ARG(args, 0), len, 0);
+  unsigned long end = relative_index(ARG(args, 1), len, len);
+  if (end < begin) end = begin;
+
+  js_binary *bin = instance->object.binary;
+  js_val *buf = bin->buffer;
+  unsigned long offset = elem_ptr(instance, begin) - buf->object.binary->bytes;
+  return typed_create(bin->type, buf, offset, end - begin);
+}
+
+
+// ----------------------------------------------------------------------------
+// DataView
+// ----------------------------------------------------------------------------
+
+// new DataView(buffer[, byteOffset[, byteLength]])
+js_val *
+dv_new(js_val *instance, js_args *args, eval_state *state)
+{
+  js_val *buffer = ARG(args, 0);
+  if (!is_buffer(buffer))
+    fh_throw(state, fh_new_error(E_TYPE,
+      "First argument to DataView constructor must be an ArrayBuffer"));
+
+  unsigned long buf_length = buffer->object.binary->byte_length;
+  unsigned long offset = to_index(ARG(args, 1), "DataView offset", state);
+  if (offset > buf_length)
+    fh_throw(state, fh_new_error(E_RANGE,
+      "Start offset %lu is outside the bounds of the buffer", offset));
+
+  unsigned long byte_length = buf_length - offset;
+  if (!IS_UNDEF(ARG(args, 2))) {
+    byte_length = to_index(ARG(args, 2), "DataView length", state);
+    if (offset + byte_length > buf_length)
+      fh_throw(state, fh_new_error(E_RANGE, "Invalid DataView length %lu", byte_length));
+  }
+
+  js_val *view = JSOBJ();
+  view->proto = fh_try_get_proto("DataView");
+  fh_gc_barrier(view, view->proto);
+  fh_set_class(view, "DataView");
+  view_init(view, TA_NONE, buffer, offset, byte_length);
+  return view;
+}
+
+// Where a DataView access starts, once it's known to be in bounds.
+static unsigned char *
+view_bytes(js_val *view, js_elem_type type, js_val *offset, eval_state *state)
+{
+  if (!IS_OBJ(view) || !STREQ(view->object.class, "DataView"))
+    fh_throw(state, fh_new_error(E_TYPE, "this is not a DataView"));
+
+  unsigned long i = to_index(offset, "offset", state);
+  js_binary *bin = view->object.binary;
+  if (i + fh_elem_size(type) > bin->byte_length)
+    fh_throw(state, fh_new_error(E_RANGE, "Offset is outside the bounds of the DataView"));
+  return bin->bytes + i;
+}
+
+// Copy an element's bytes, reversing them when the byte order asked for isn't
+// the host's. DataViews are big-endian unless told otherwise.
+static void
+order_bytes(unsigned char *dst, unsigned char *src, unsigned size, bool little)
+{
+  static const uint16_t one = 1;
+  bool host_little = *(const unsigned char *)&one;
+
+  unsigned i;
+  for (i = 0; i < size; i++)
+    dst[i] = src[little == host_little ? i : size - 1 - i];
+}
+
+// DataView.prototype.getInt8(byteOffset[, littleEndian]), etc.
+static js_val *
+view_get(js_val *view, js_elem_type type, js_args *args, eval_state *state)
+{
+  unsigned char *bytes = view_bytes(view, type, ARG(args, 0), state);
+  unsigned char elem[8];
+  order_bytes(elem, bytes, fh_elem_size(type), BOOLVAL(TO_BOOL(ARG(args, 1))));
+  return fh_read_elem(type, elem);
+}
+
+// DataView.prototype.setInt8(byteOffset, value[, littleEndian]), etc.
+static js_val *
+view_set(js_val *view, js_elem_type type, js_args *args, eval_state *state)
+{
+  unsigned char *bytes = view_bytes(view, type, ARG(args, 0), state);
+  unsigned char elem[8];
+  fh_write_elem(type, elem, ARG(args, 1));
+  order_bytes(bytes, elem, fh_elem_size(type), BOOLVAL(TO_BOOL(ARG(args, 2))));
+  return JSUNDEF();
+}
+
+#define VIEW_ACCESSORS(name, type) \
+  js_val * \
+  dv_proto_get_##name(js_val *instance, js_args *args, eval_state *state) \
+  { \
+    return view_get(instance, type, args, state); \
+  } \
+  js_val * \
+  dv_proto_set_##name(js_val *instance, js_args *args, eval_state *state) \
+  { \
+    return view_set(instance, type, args, state); \
+  }
+
+VIEW_ACCESSORS(int8, TA_INT8)
+VIEW_ACCESSORS(uint8, TA_UINT8)
+VIEW_ACCESSORS(int16, TA_INT16)
+VIEW_ACCESSORS(uint16, TA_UINT16)
+VIEW_ACCESSORS(int32, TA_INT32)
+VIEW_ACCESSORS(uint32, TA_UINT32)
+VIEW_ACCESSORS(float32, TA_FLOAT32)
+VIEW_ACCESSORS(float64, TA_FLOAT64)
+
+
+void
+bootstrap_typed_arrays(js_val *global)
+{
+  // ArrayBuffer
+  // -----------
+
+  js_val *buffer = JSNFUNC(buf_new, 1);
+  js_val *buffer_proto = JSOBJ();
+  buffer_proto->proto = fh->object_proto;
+
+  DEF(buffer, "prototype", buffer_proto);
+  DEF(buffer, "isView", JSNFUNC(buf_is_view, 1));
+
+  DEF(buffer_proto, "constructor", JSNFUNC(buf_new, 1));
+  DEF(buffer_proto, "slice", JSNFUNC(buf_proto_slice, 2));
+
+  fh_attach_prototype(buffer_proto, fh->function_proto);
+  DEF(global, "ArrayBuffer", buffer);
+
+
+  // TypedArray.prototype
+  // --------------------
+  //
+  // Shared by every element type's prototype. The read-only Array methods
+  // work as they are, since they go through the index API.
+
+  js_val *typed_proto = JSOBJ();
+  typed_proto->proto = fh->object_proto;
+
+  DEF(typed_proto, "fill", JSNFUNC(typed_proto_fill, 1));
+  DEF(typed_proto, "set", JSNFUNC(typed_proto_set, 1));
+  DEF(typed_proto, "slice", JSNFUNC(typed_proto_slice, 2));
+  DEF(typed_proto, "subarray", JSNFUNC(typed_proto_subarray, 2));
+
+  DEF(typed_proto, "join", JSNFUNC(arr_proto_join, 1));
+  DEF(typed_proto, "toString", JSNFUNC(arr_proto_to_string, 0));
+  DEF(typed_proto, "indexOf", JSNFUNC(arr_proto_index_of, 1));
+  DEF(typed_proto, "lastIndexOf", JSNFUNC(arr_proto_last_index_of, 1));
+  DEF(typed_proto, "forEach", JSNFUNC(arr_proto_for_each, 1));
+  DEF(typed_proto, "every", JSNFUNC(arr_proto_every, 1));
+  DEF(typed_proto, "some", JSNFUNC(arr_proto_some, 1));
+  DEF(typed_proto, "reduce", JSNFUNC(arr_proto_reduce, 1));
+  DEF(typed_proto, "reduceRight", JSNFUNC(arr_proto_reduce_right, 1));
+
+  fh_attach_prototype(typed_proto, fh->function_proto);
+
+
+  // Int8Array, Uint8Array, etc.
+  // ---------------------------
+
+  js_elem_type type;
+  for (type = TA_INT8; type <= TA_FLOAT64; type++) {
+    js_val *cons = JSNFUNC(typed_constructors[type], 3);
+    js_val *proto = JSOBJ();
+    proto->proto = typed_proto;
+    js_val *size = JSNUM(fh_elem_size(type));
+
+    DEF(cons, "prototype", proto);
+    DEF2(cons, "BYTES_PER_ELEMENT", size, P_NONE);
+
+    DEF(proto, "constructor", JSNFUNC(typed_constructors[type], 3));
+    DEF2(proto, "BYTES_PER_ELEMENT", size, P_NONE);
+
+    fh_attach_prototype(proto, fh->function_proto);
+    DEF(global, type_names[type], cons);
+  }
+
+
+  // DataView
+  // --------
+
+  js_val *view = JSNFUNC(dv_new, 3);
+  js_val *view_proto = JSOBJ();
+  view_proto->proto = fh->object_proto;
+
+  DEF(view, "prototype", view_proto);
+
+  DEF(view_proto, "constructor", JSNFUNC(dv_new, 3));
+  DEF(view_proto, "getInt8", JSNFUNC(dv_proto_get_int8, 1));
+  DEF(view_proto, "getUint8", JSNFUNC(dv_proto_get_uint8, 1));
+  DEF(view_proto, "getInt16", JSNFUNC(dv_proto_get_int16, 1));
+  DEF(view_proto, "getUint16", JSNFUNC(dv_proto_get_uint16, 1));
+  DEF(view_proto, "getInt32", JSNFUNC(dv_proto_get_int32, 1));
+  DEF(view_proto, "getUint32", JSNFUNC(dv_proto_get_uint32, 1));
+  DEF(view_proto, "getFloat32", JSNFUNC(dv_proto_get_float32, 1));
+  DEF(view_proto, "getFloat64", JSNFUNC(dv_proto_get_float64, 1));
+  DEF(view_proto, "setInt8", JSNFUNC(dv_proto_set_int8, 2));
+  DEF(view_proto, "setUint8", JSNFUNC(dv_proto_set_uint8, 2));
+  DEF(view_proto, "setInt16", JSNFUNC(dv_proto_set_int16, 2));
+  DEF(view_proto, "setUint16", JSNFUNC(dv_proto_set_uint16, 2));
+  DEF(view_proto, "setInt32", JSNFUNC(dv_proto_set_int32, 2));
+  DEF(view_proto, "setUint32", JSNFUNC(dv_proto_set_uint32, 2));
+  DEF(view_proto, "setFloat32", JSNFUNC(dv_proto_set_float32, 2));
+  DEF(view_proto, "setFloat64", JSNFUNC(dv_proto_set_float64, 2));
+
+  fh_attach_prototype(view_proto, fh->function_proto);
+  DEF(global, "DataView", view);
+}
@@ -0,0 +1,49 @@
+// TypedArray.h
+// ------------
+// ArrayBuffer, typed array and DataView properties, methods, and prototypes
+
+#ifndef JS_TYPED_ARR_H
+#define JS_TYPED_ARR_H
+
+#include "../runtime.h"
+
+js_val * buf_new(js_val *, js_args *, eval_state *);
+js_val * buf_is_view(js_val *, js_args *, eval_state *);
+js_val * buf_proto_slice(js_val *, js_args *, eval_state *);
+
+js_val * typed_int8_new(js_val *, js_args *, eval_state *);
+js_val * typed_uint8_new(js_val *, js_args *, eval_state *);
+js_val * typed_uint8_clamped_new(js_val *, js_args *, eval_state *);
+js_val * typed_int16_new(js_val *, js_args *, eval_state *);
+js_val * typed_uint16_new(js_val *, js_args *, eval_state *);
+js_val * typed_int32_new(js_val *, js_args *, eval_state *);
+js_val * typed_uint32_new(js_val *, js_args *, eval_state *);
+js_val * typed_float32_new(js_val *, js_args *, eval_state *);
+js_val * typed_float64_new(js_val *, js_args *, eval_state *);
+
+js_val * typed_proto_fill(js_val *, js_args *, eval_state *);
+js_val * typed_proto_set(js_val *, js_args *, eval_state *);
+js_val * typed_proto_slice(js_val *, js_args *, eval_state *);
+js_val * typed_proto_subarray(js_val *, js_args *, eval_state *);
+
+js_val * dv_new(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_int8(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_uint8(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_int16(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_uint16(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_int32(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_uint32(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_float32(js_val *, js_args *, eval_state *);
+js_val * dv_proto_get_float64(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_int8(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_uint8(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_int16(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_uint16(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_int32(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_uint32(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_float32(js_val *, js_args *, eval_state *);
+js_val * dv_proto_set_float64(js_val *, js_args *, eval_state *);
+
+void bootstrap_typed_arrays(js_val *);
+
+#endif
@@ -42,7 +42,7 @@ js_val *
 console_assert(js_val *instance, js_args *args, eval_state *state)
 {
   // Non-standard, found in new Webkit builds and Firebug
-  if (TO_BOOL(ARG(args, 0))->boolean.val)
+  if (BOOLVAL(TO_BOOL(ARG(args, 0))))
     return JSUNDEF();
   fh_throw(state, fh_new_error("AssertionError", "assertion failed"));
   UNREACHABLE();
@@ -71,7 +71,7 @@ console_time_end(js_val *instance, js_args *args, eval_state *state)
   if (IS_OBJ(timers)) {
     js_val *timer = fh_get(timers, name->string.ptr);
     if (IS_NUM(timer)) {
-      long old = timer->number.val;
+      long old = NUMVAL(timer);
       long cur = utc_now();
       fprintf(stdout, "%s: %ldms\n", name->string.ptr, cur - old);
     }
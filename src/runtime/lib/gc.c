@@ -31,6 +31,13 @@ gc_info(js_val *instance, js_args *args, eval_state *state)
   js_val *info = JSOBJ();
   fh_set_prop(info, "arenas", JSNUM(fh->gc_num_arenas), P_DEFAULT);
   fh_set_prop(info, "arenaSize", JSNUM(SLOTS_PER_ARENA), P_DEFAULT);
+  fh_set_prop(info, "heapSize", JSNUM(fh->gc_heap_size), P_DEFAULT);
+  fh_set_prop(info, "maxHeapSize", JSNUM(fh->opt_max_heap), P_DEFAULT);
+  fh_set_prop(info, "bytesReclaimed", JSNUM(fh->gc_last_reclaimed), P_DEFAULT);
+  fh_set_prop(info, "totalBytesReclaimed", JSNUM(fh->gc_total_reclaimed), P_DEFAULT);
+  fh_set_prop(info, "minorRuns", JSNUM(fh->gc_minor_runs), P_DEFAULT);
+  fh_set_prop(info, "majorRuns", JSNUM(fh->gc_major_runs), P_DEFAULT);
+  fh_set_prop(info, "steps", JSNUM(fh->gc_steps), P_DEFAULT);
   fh_set_prop(info, "runs", JSNUM(fh->gc_runs), P_DEFAULT);
   fh_set_prop(info, "lastStart", JSNUM(fh->gc_last_start), P_DEFAULT);
   fh_set_prop(info, "time", JSNUM(fh->gc_time), P_DEFAULT);
@@ -47,7 +54,8 @@ gc_spy(js_val *instance, js_args *args, eval_state *state)
 {
   if (ARGLEN(args) >= 1) {
     js_val *val = ARG(args, 0);
-    val->flagged = true;
+    if (IS_HEAP(val))
+      val->flagged = true;
   }
   return JSUNDEF();
 }
@@ -33,6 +33,7 @@
 #include "lib/Date.h"
 #include "lib/RegExp.h"
 #include "lib/Error.h"
+#include "lib/TypedArray.h"
 
 
 // isNaN(value)
@@ -40,7 +41,7 @@ js_val *
 global_is_nan(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *num = TO_NUM(ARG(args, 0));
-  return JSBOOL(num->number.is_nan);
+  return JSBOOL(IS_NAN(num));
 }
 
 // isFinite(number)
@@ -48,7 +49,7 @@ js_val *
 global_is_finite(js_val *instance, js_args *args, eval_state *state)
 {
   js_val *num = TO_NUM(ARG(args, 0));
-  return JSBOOL(!(num->number.is_nan || num->number.is_inf));
+  return JSBOOL(!(IS_NAN(num) || IS_INF(num)));
 }
 
 /* Returns the numeric value (0-35) of a given alphanumeric character, or 36
@@ -95,12 +96,12 @@ global_parse_int(js_val *instance, js_args *args, eval_state *state)
 
   bool strip_prefix = true;
   unsigned r = 10;
-  if (radix->number.val != 0) {
-    if (radix->number.val < 2 || radix->number.val > 32)
+  if (NUMVAL(radix) != 0) {
+    if (NUMVAL(radix) < 2 || NUMVAL(radix) > 32)
       return JSNAN();
-    if (radix->number.val != 16)
+    if (NUMVAL(radix) != 16)
       strip_prefix = false;
-    r = radix->number.val;
+    r = NUMVAL(radix);
   }
 
   if (strip_prefix) {
@@ -207,14 +208,17 @@ fh_attach_prototype(js_val *obj, js_val *proto)
 {
   js_prop *prop;
   OBJ_ITER(obj, prop) {
-    if (prop->ptr && IS_FUNC(prop->ptr) && prop->ptr->object.native)
+    if (prop->ptr && IS_FUNC(prop->ptr) && prop->ptr->object.native) {
       prop->ptr->proto = proto;
+      fh_gc_barrier(prop->ptr, proto);
+    }
   }
 }
 
 js_val *
 fh_bootstrap()
 {
+  size_t scope = fh_open_scope();
   js_val *global = JSOBJ();
   js_val *object_cons = bootstrap_object();
 
@@ -227,6 +231,7 @@ fh_bootstrap()
   DEF(global, "Date",     bootstrap_date());
   DEF(global, "RegExp",   bootstrap_regexp());
   DEF(global, "Error",    bootstrap_error(global));
+  bootstrap_typed_arrays(global);
   DEF(global, "Math",     bootstrap_math());
   DEF(global, "console",  bootstrap_console());
 #ifdef FH_GC_EXPOSE
@@ -247,16 +252,6 @@ fh_bootstrap()
   DEF(global, "undefined", JSUNDEF());
   DEF(global, "this",      global);
 
-  // These aren't currently optimized, just here for compatibility's sake.
-  DEF(global, "Float32Array", JSNFUNC(arr_new, 1));
-  DEF(global, "Float64Array", JSNFUNC(arr_new, 1));
-  DEF(global, "Uint8Array",   JSNFUNC(arr_new, 1));
-  DEF(global, "Uint16Array",  JSNFUNC(arr_new, 1));
-  DEF(global, "Uint32Array",  JSNFUNC(arr_new, 1));
-  DEF(global, "Int8Array",    JSNFUNC(arr_new, 1));
-  DEF(global, "Int16Array",   JSNFUNC(arr_new, 1));
-  DEF(global, "Int32Array",   JSNFUNC(arr_new, 1));
-
   DEF(global, "isNaN",      JSNFUNC(global_is_nan, 1));
   DEF(global, "isFinite",   JSNFUNC(global_is_finite, 1));
   DEF(global, "parseInt",   JSNFUNC(global_parse_int, 2));
@@ -268,5 +263,7 @@ fh_bootstrap()
   DEF(global, "load",       JSNFUNC(global_load, 1));
   DEF(global, "print",      JSNFUNC(global_print, 1));
 
+  // Everything is reachable from the global object from here on.
+  fh_close_scope(scope);
   return global;
 }
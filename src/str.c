@@ -21,9 +21,30 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "str.h"
 
+// Atoms are unique, reference-counted copies of strings. Two atoms are equal
+// exactly when their pointers are, so property names and identifiers stored
+// as atoms can be compared without looking at their characters. Each atom
+// keeps its hash, and is freed when the last reference is released.
+
+typedef struct atom {
+  struct atom *next;                  // next in the same bucket
+  unsigned hash;
+  unsigned refs;
+  size_t len;
+  char str[];
+} atom;
+
+static atom **atoms = NULL;
+static unsigned atoms_size = 0;
+static unsigned atoms_count = 0;
+
+#define ATOMS_MIN 1024
+#define ATOM_OF(s) ((atom *)((s) - offsetof(atom, str)))
+
 
 /* Returns a newly allocated string that is the concatenation of the two
  * argument strings */
@@ -83,3 +104,133 @@ fh_str_replace(char *orig, char *repl, char *new, int limit)
   strcpy(tmp, orig);
   return result;
 }
+
+
+// ----------------------------------------------------------------------------
+// Atoms
+// ----------------------------------------------------------------------------
+
+/* FNV-1a */
+unsigned
+fh_str_hash(char *str)
+{
+  return fh_key(str).hash;
+}
+
+/* Returns the key for a string, hashing and measuring it in one pass. */
+js_key
+fh_key(char *str)
+{
+  unsigned hash = 2166136261u;
+  char *p;
+  for (p = str; *p; p++)
+    hash = (hash ^ (unsigned char)*p) * 16777619u;
+  return (js_key){.str = str, .len = p - str, .hash = hash, .atom = NULL};
+}
+
+/* Returns the key for an atom, which has everything a key needs already. */
+js_key
+fh_atom_key(char *str)
+{
+  atom *a = ATOM_OF(str);
+  return (js_key){.str = str, .len = a->len, .hash = a->hash, .atom = str};
+}
+
+static atom *
+find_atom(js_key key)
+{
+  if (key.atom) return ATOM_OF(key.atom);
+  if (atoms == NULL) return NULL;
+
+  atom *a;
+  for (a = atoms[key.hash & (atoms_size - 1)]; a != NULL; a = a->next)
+    if (a->hash == key.hash && a->len == key.len &&
+        memcmp(a->str, key.str, key.len) == 0)
+      return a;
+  return NULL;
+}
+
+static void
+grow_atoms()
+{
+  unsigned size = atoms_size ? atoms_size * 2 : ATOMS_MIN, i;
+  atom **table = calloc(size, sizeof(atom *)), *a, *next;
+
+  for (i = 0; i < atoms_size; i++) {
+    for (a = atoms[i]; a != NULL; a = next) {
+      next = a->next;
+      a->next = table[a->hash & (size - 1)];
+      table[a->hash & (size - 1)] = a;
+    }
+  }
+
+  free(atoms);
+  atoms = table;
+  atoms_size = size;
+}
+
+/* Returns the atom for the given string, creating it if need be, and takes a
+ * reference to it. */
+char *
+fh_intern(char *str)
+{
+  return fh_intern_key(fh_key(str));
+}
+
+/* Same as `fh_intern`, given the string's key. */
+char *
+fh_intern_key(js_key key)
+{
+  atom *a = find_atom(key);
+  if (a) {
+    a->refs++;
+    return a->str;
+  }
+
+  if (atoms_count >= atoms_size) grow_atoms();
+
+  a = malloc(sizeof(atom) + key.len + 1);
+  memcpy(a->str, key.str, key.len + 1);
+  a->hash = key.hash;
+  a->refs = 1;
+  a->len = key.len;
+  a->next = atoms[key.hash & (atoms_size - 1)];
+  atoms[key.hash & (atoms_size - 1)] = a;
+  atoms_count++;
+  return a->str;
+}
+
+/* Returns the atom for the given string if there is one, or NULL. No property
+ * can have a name that isn't an atom. */
+char *
+fh_find_atom(char *str)
+{
+  return fh_find_atom_key(fh_key(str));
+}
+
+/* Same as `fh_find_atom`, given the string's key. */
+char *
+fh_find_atom_key(js_key key)
+{
+  atom *a = find_atom(key);
+  return a ? a->str : NULL;
+}
+
+/* Drops a reference taken by `fh_intern`. */
+void
+fh_release_atom(char *str)
+{
+  atom *a = ATOM_OF(str), **link;
+  if (--a->refs > 0) return;
+
+  for (link = &atoms[a->hash & (atoms_size - 1)]; *link != a; link = &(*link)->next);
+  *link = a->next;
+  atoms_count--;
+  free(a);
+}
+
+unsigned
+fh_atom_hash(char *str)
+{
+  return ATOM_OF(str)->hash;
+}
@@ -19,8 +19,31 @@
 #ifndef STR_H
 #define STR_H
 
+#include <stddef.h>
+
 char * fh_str_concat(char *, char *);
 char * fh_str_slice(char *, unsigned, unsigned);
 char * fh_str_replace(char *, char *, char *, int);
 
+/* A name along with its length and hash, worked out once and carried along
+ * so that lookups further down needn't do it again. Keys made from atoms know
+ * their atom, and skip even the search for it.
+ */
+typedef struct {
+  char *str;
+  size_t len;
+  unsigned hash;
+  char *atom;                         // NULL if not known yet
+} js_key;
+
+unsigned fh_str_hash(char *);
+js_key fh_key(char *);
+js_key fh_atom_key(char *);
+char * fh_intern(char *);
+char * fh_intern_key(js_key);
+char * fh_find_atom(char *);
+char * fh_find_atom_key(js_key);
+void fh_release_atom(char *);
+unsigned fh_atom_hash(char *);
+
 #endif
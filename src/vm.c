@@ -0,0 +1,265 @@
+/*
+ * vm.c -- Bytecode virtual machine
+ *
+ * Copyright (c) 2012-2017 Nick Reynolds
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+
+#include "vm.h"
+#include "eval.h"
+#include "props.h"
+#include "gc.h"
+
+/* With GCC and Clang each instruction jumps straight to the next one's
+ * handler through a table of label addresses, rather than back to the top of
+ * a switch, which gives the branch predictor one indirect jump per handler to
+ * learn rather than a single shared one. Define FH_NO_COMPUTED_GOTO to use
+ * the switch anyway.
+ */
+#if defined(__GNUC__) && !defined(FH_NO_COMPUTED_GOTO)
+#define FH_COMPUTED_GOTO
+#endif
+
+#ifdef FH_COMPUTED_GOTO
+#define FH_OPCODE_LABEL(op, effect) __extension__ &&L_##op,
+#define CASE(op)        L_##op:
+#define DISPATCH()      __extension__ ({ goto *labels[pc->op]; })
+#define VM_LOOP         DISPATCH();
+#else
+#define CASE(op)        case op:
+#define DISPATCH()      continue
+#define VM_LOOP         for (;;) switch (pc->op)
+#endif
+
+#define NEXT()          { pc++; DISPATCH(); }
+#define JUMP(target)    { pc = code->instrs + (target); DISPATCH(); }
+
+// Everything pushed is rooted, as fh_eval roots what it returns, until the
+// statement using it is done.
+#define PUSH(v)         (*sp++ = fh_root(v))
+#define POP()           (*--sp)
+#define TOP()           (sp[-1])
+#define SET_TOP(v)      (sp[-1] = fh_root(v))
+
+// Arithmetic and comparisons on two numbers skip the general operators.
+#define NUM_OP(expr) { \
+  js_val *b = POP(), *a = TOP(); \
+  SET_TOP(IS_NUM(a) && IS_NUM(b) ? (expr) : fh_bin_op(pc->node->op, a, b)); \
+  NEXT(); \
+}
+#define X_ (NUMVAL(a))
+#define Y_ (NUMVAL(b))
+
+// Same as the `ident` lookup, which also raises the ReferenceError.
+static js_val *
+get_var(js_val *ctx, ast_node *id)
+{
+  js_prop *prop = fh_get_local(ctx, id->sval, id->slot, &id->ic);
+  return prop ? prop->ptr : fh_eval(ctx, id);
+}
+
+static js_args *
+pop_args(js_val **args, int count)
+{
+  js_args *head = args_new(), *tail = head;
+  int i;
+  for (i = 0; i < count; i++) {
+    if (i) tail = tail->next = args_new();
+    tail->arg = args[i];
+  }
+  return head;
+}
+
+/* Run a source list, compiling it the first time. Values and signals come
+ * out the same as from the AST walker.
+ */
+js_val *
+fh_run(js_val *ctx, ast_node *node)
+{
+  if (!node->code) node->code = fh_compile(node);
+
+  js_code *code = node->code;
+  js_instr *pc = code->instrs;
+  js_val *stack[code->max_depth + 1], **sp = stack;
+  js_val *result = JSUNDEF();
+  size_t scope = fh_open_scope();
+
+#ifdef FH_COMPUTED_GOTO
+  static void *const labels[] = {
+    FH_OPCODES(FH_OPCODE_LABEL)
+  };
+#endif
+
+  VM_LOOP {
+    CASE(OP_UNDEF) { PUSH(JSUNDEF()); NEXT(); }
+    CASE(OP_NULL)  { PUSH(JSNULL()); NEXT(); }
+    CASE(OP_BOOL)  { PUSH(JSBOOL(pc->node->val)); NEXT(); }
+    CASE(OP_NUM)   { PUSH(JSNUM(pc->node->val)); NEXT(); }
+    CASE(OP_STR)   { PUSH(JSSTR(pc->node->sval)); NEXT(); }
+    CASE(OP_FUNC)  { PUSH(JSFUNC(pc->node)); NEXT(); }
+    CASE(OP_EVAL)  { PUSH(fh_eval(ctx, pc->node)); NEXT(); }
+
+    CASE(OP_EXEC) {
+      // Each statement drops the values the one before it left rooted.
+      fh_close_scope(scope);
+      result = fh_eval(ctx, pc->node);
+      if (fh->signal == S_NONE) NEXT();
+      if (pc->arg >= 0 && fh->signal != S_RETURN) {
+        js_loop *loop = &code->loops[pc->arg];
+        int target = fh->signal == S_BREAK ? loop->brk : loop->cont;
+        fh->signal = S_NONE;
+        JUMP(target);
+      }
+      return result;
+    }
+
+    CASE(OP_POP) { sp--; NEXT(); }
+
+    CASE(OP_RESULT) {
+      result = POP();
+      fh_close_scope(scope);
+      fh_root(result);
+      NEXT();
+    }
+
+    CASE(OP_GET_VAR) { PUSH(get_var(ctx, pc->node)); NEXT(); }
+
+    CASE(OP_SET_VAR) {
+      ast_node *id = pc->node;
+      fh_set_local(ctx, id->sval, id->slot, TOP(), &id->ic);
+      NEXT();
+    }
+
+    CASE(OP_ASSIGN_VAR) {
+      if (IS_OBJ(ctx))
+        SET_TOP(fh_assign(ctx, pc->node->e1, TOP(), pc->node->op));
+      NEXT();
+    }
+
+    CASE(OP_INC_VAR) {
+      ast_node *id = pc->node->e1;
+      js_val *old_val = TO_NUM(get_var(ctx, id));
+      double x = NUMVAL(old_val) + (pc->arg & 2 ? -1 : 1);
+      js_val *new_val = JSNUM(x);
+      fh_set_local(ctx, id->sval, id->slot, new_val, &id->ic);
+      PUSH(pc->arg & 1 ? new_val : old_val);
+      NEXT();
+    }
+
+    CASE(OP_GET_NAMED) {
+      ast_node *member = pc->node;
+      SET_TOP(fh_get_proto_cached(TOP(), member->e1->sval, &member->ic));
+      NEXT();
+    }
+
+    CASE(OP_GET_MEMBER) {
+      js_val *key = POP();
+      SET_TOP(fh_get_member(TOP(), key));
+      NEXT();
+    }
+
+    CASE(OP_PUT_MEMBER) {
+      js_val *key = POP(), *obj = POP();
+      SET_TOP(fh_put_member(obj, key, TOP(), pc->node->op));
+      NEXT();
+    }
+
+    CASE(OP_PUT_NAMED) {
+      ast_node *assign = pc->node;
+      js_val *obj = POP();
+      SET_TOP(fh_put_named(obj, assign->e1, TOP(), assign->op, &assign->ic));
+      NEXT();
+    }
+
+    CASE(OP_ADD) NUM_OP(JSNUM(X_ + Y_))
+    CASE(OP_SUB) NUM_OP(JSNUM(X_ - Y_))
+    CASE(OP_MUL) NUM_OP(JSNUM(X_ * Y_))
+    CASE(OP_DIV) NUM_OP(JSNUM(X_ / Y_))
+    CASE(OP_MOD) NUM_OP(JSNUM(fmod(X_, Y_)))
+    CASE(OP_LT)  NUM_OP(JSBOOL(X_ < Y_))
+    CASE(OP_GT)  NUM_OP(JSBOOL(X_ > Y_))
+    CASE(OP_LE)  NUM_OP(JSBOOL(X_ <= Y_))
+    CASE(OP_GE)  NUM_OP(JSBOOL(X_ >= Y_))
+    CASE(OP_EQ)  NUM_OP(JSBOOL(X_ == Y_))
+    CASE(OP_NE)  NUM_OP(JSBOOL(X_ != Y_))
+    CASE(OP_STRICT_EQ) NUM_OP(JSBOOL(X_ == Y_))
+    CASE(OP_STRICT_NE) NUM_OP(JSBOOL(X_ != Y_))
+
+    CASE(OP_BINARY) {
+      js_val *b = POP();
+      SET_TOP(fh_bin_op(pc->node->op, TOP(), b));
+      NEXT();
+    }
+
+    CASE(OP_NOT) { SET_TOP(JSBOOL(!BOOLVAL(TO_BOOL(TOP())))); NEXT(); }
+    CASE(OP_UNARY) { SET_TOP(fh_unary_op(pc->node->op, TOP())); NEXT(); }
+
+    CASE(OP_JUMP) JUMP(pc->arg)
+
+    CASE(OP_BREAK) {
+      result = JSUNDEF();
+      JUMP(code->loops[pc->arg].brk);
+    }
+
+    CASE(OP_CONTINUE) {
+      result = JSUNDEF();
+      JUMP(code->loops[pc->arg].cont);
+    }
+
+    CASE(OP_JUMP_IF_FALSE) {
+      if (!BOOLVAL(TO_BOOL(POP()))) JUMP(pc->arg);
+      NEXT();
+    }
+
+    CASE(OP_AND) {
+      if (!BOOLVAL(TO_BOOL(TOP()))) JUMP(pc->arg);
+      sp--;
+      NEXT();
+    }
+
+    CASE(OP_OR) {
+      if (BOOLVAL(TO_BOOL(TOP()))) JUMP(pc->arg);
+      sp--;
+      NEXT();
+    }
+
+    CASE(OP_CALLEE) {
+      fh_check_callee(ctx, pc->node, TOP());
+      NEXT();
+    }
+
+    CASE(OP_CALL) {
+      sp -= pc->arg;
+      js_args *args = pop_args(sp, pc->arg);
+      SET_TOP(fh_call_node(ctx, pc->node, TOP(), args));
+      NEXT();
+    }
+
+    CASE(OP_RETURN) {
+      js_val *val = POP();
+      if (IS_FUNC(val)) {
+        val->object.scope = ctx;
+        fh_gc_barrier(val, ctx);
+      }
+      fh->signal = S_RETURN;
+      return val;
+    }
+
+    CASE(OP_END) return result;
+  }
+
+  UNREACHABLE();
+}
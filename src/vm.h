@@ -0,0 +1,113 @@
+/*
+ * vm.h -- Bytecode compiler and virtual machine
+ *
+ * Copyright (c) 2012-2017 Nick Reynolds
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include "flathead.h"
+#include "nodes.h"
+
+/* Programs and function bodies are compiled, the first time they run, to a
+ * flat sequence of instructions for a stack machine. Each instruction keeps
+ * the node it came from, for names, inline caches and error positions. Nodes
+ * the compiler doesn't handle become a single instruction that hands them to
+ * the AST walker, so anything that evaluates still runs.
+ *
+ * Statements leave the operand stack empty, putting their value in a result
+ * register instead, since a program's value is that of its last statement.
+ *
+ * Opcodes are listed with their effect on the depth of the operand stack.
+ */
+#define FH_OPCODES(X) \
+  X(OP_UNDEF, 1)         /* push undefined */ \
+  X(OP_NULL, 1)          /* push null */ \
+  X(OP_BOOL, 1)          /* push a boolean literal */ \
+  X(OP_NUM, 1)           /* push a number literal */ \
+  X(OP_STR, 1)           /* push a new string from the node's name */ \
+  X(OP_FUNC, 1)          /* push a function literal */ \
+  X(OP_EVAL, 1)          /* push the AST walker's value for an expression */ \
+  X(OP_EXEC, 0)          /* run a statement through the AST walker */ \
+  X(OP_POP, -1) \
+  X(OP_RESULT, -1)       /* pop into the result register */ \
+  X(OP_GET_VAR, 1)       /* push a variable */ \
+  X(OP_SET_VAR, 0)       /* assign the top of the stack to a variable */ \
+  X(OP_ASSIGN_VAR, 0)    /* ...with a compound operator, leaving the result */ \
+  X(OP_INC_VAR, 1)       /* ++ or -- on a variable */ \
+  X(OP_GET_NAMED, 0)     /* replace an object with its named prop */ \
+  X(OP_GET_MEMBER, -1)   /* object, key -> the object's prop */ \
+  X(OP_PUT_MEMBER, -2)   /* value, object, key -> the value assigned */ \
+  X(OP_PUT_NAMED, -1)    /* value, object -> the value assigned to its prop */ \
+  X(OP_ADD, -1) \
+  X(OP_SUB, -1) \
+  X(OP_MUL, -1) \
+  X(OP_DIV, -1) \
+  X(OP_MOD, -1) \
+  X(OP_LT, -1) \
+  X(OP_GT, -1) \
+  X(OP_LE, -1) \
+  X(OP_GE, -1) \
+  X(OP_EQ, -1) \
+  X(OP_NE, -1) \
+  X(OP_STRICT_EQ, -1) \
+  X(OP_STRICT_NE, -1) \
+  X(OP_BINARY, -1)       /* any other binary operator, by the node's operator */ \
+  X(OP_NOT, 0) \
+  X(OP_UNARY, 0)         /* any other unary operator, by the node's operator */ \
+  X(OP_JUMP, 0) \
+  X(OP_BREAK, 0)         /* leave a loop, by its index */ \
+  X(OP_CONTINUE, 0)      /* start a loop's next iteration */ \
+  X(OP_JUMP_IF_FALSE, -1) \
+  X(OP_AND, -1)          /* jump, keeping the operand, if it's false */ \
+  X(OP_OR, -1)           /* jump, keeping the operand, if it's true */ \
+  X(OP_CALLEE, 0)        /* throw unless the top of the stack is callable */ \
+  X(OP_CALL, 0)          /* function, args... -> result; pops arg more */ \
+  X(OP_RETURN, -1) \
+  X(OP_END, 0)
+
+#define FH_OPCODE_ENUM(op, effect) op,
+
+typedef enum {
+  FH_OPCODES(FH_OPCODE_ENUM)
+} js_opcode;
+
+typedef struct {
+  js_opcode op;
+  int arg;                            // a jump target, count or loop
+  ast_node *node;
+} js_instr;
+
+// Where break and continue go in a loop, also used for the signals raised by
+// statements the AST walker runs.
+typedef struct {
+  int brk;
+  int cont;
+} js_loop;
+
+typedef struct js_code {
+  js_instr *instrs;
+  unsigned count;
+  unsigned cap;
+  js_loop *loops;
+  unsigned num_loops;
+  unsigned max_depth;                 // of the operand stack
+} js_code;
+
+js_code * fh_compile(ast_node *);
+js_val * fh_run(js_val *, ast_node *);
+
+#endif
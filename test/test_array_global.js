@@ -60,6 +60,25 @@ assert(Array.prototype);
 assertEquals('object', typeof Array.prototype);
 assertEquals(0, Array.prototype.length);
 
+test('Array#length', function() {
+  var a = [1, 2, 3, 4];
+  a.length = 2;
+  assertEquals(2, a.length);
+  assertEquals(undefined, a[2]);
+  assertEquals('1,2', a.join());
+
+  a.length = 4;
+  assertEquals(4, a.length);
+  assertEquals('1,2,,', a.join());
+  assert(!(2 in a));
+  assert(!(3 in a));
+
+  var threw = false;
+  try { a.length = -1; } catch (e) { threw = e.name === 'RangeError'; }
+  assert(threw);
+  assertEquals(4, a.length);
+});
+
 test('Array#pop()', function() {
   var a = [1, 2, 3, 4];
   assertEquals(4, a.pop());
@@ -105,6 +124,15 @@ test('Array#reverse()', function() {
 
   a2.reverse();
   assertArrayEquals(['t', 'a', 'c'], a2);
+
+  // Empty arrays, and holes.
+  assertEquals(0, [].reverse().length);
+  var a3 = [1, 2, 3];
+  delete a3[0];
+  a3.reverse();
+  assertEquals(3, a3[0]);
+  assertEquals(2, a3[1]);
+  assert(!(2 in a3));
 });
 
 var concat;
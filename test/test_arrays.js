@@ -75,3 +75,33 @@ test('big arrays', function() {
   arr[Math.pow(2, 31) - 1] = 42;
   assertEquals(Math.pow(2, 31), arr.length);
 });
+
+test('holes and sparse indices', function() {
+  var arr = [1, 2, 3];
+  delete arr[1];
+  assertEquals(undefined, arr[1]);
+  assert(!(1 in arr));
+  assertEquals(3, arr.length);
+
+  arr[100000] = 'far';
+  for (var i = 3; i < 64; i++) arr[i] = i;
+  assertEquals('far', arr[100000]);
+  assertEquals(63, arr[63]);
+  assertEquals(100001, arr.length);
+
+  var keys = [];
+  for (var k in [7, 8, 9]) keys.push(k);
+  assertEquals('0,1,2', keys.join(','));
+});
+
+test('element updates', function() {
+  var arr = [1, 2, 3], i = 1;
+  arr[i]++;
+  arr[2] += 10;
+  arr['0'] = 'zero';
+  assertEquals('zero,3,13', arr.join(','));
+
+  arr[3] = arr;
+  assertEquals(arr, arr[3]);
+  assertEquals(4, arr.length);
+});
@@ -51,3 +51,57 @@ test('Assignment with member expressions', function() {
   z.a.b.c.d.e = 42;
   assertEquals(42, z.a.b.c.d.e);
 });
+
+test('Assignment to a member from one site, across objects', function() {
+  var P = function() {};
+  P.prototype.x = 'proto';
+  var ro = {};
+  Object.defineProperty(ro, 'x', {value: 'ro', writable: false});
+  var objs = [{}, {a: 1}, new P(), ro, {x: 0}, {}];
+
+  var i, k;
+  for (k = 0; k < 3; k++)
+    for (i = 0; i < objs.length; i++)
+      objs[i].x = i + k;
+
+  assertEquals(2, objs[0].x);
+  assertEquals(3, objs[1].x);
+  assertEquals(4, objs[2].x);
+  assertEquals('ro', objs[3].x);
+  assertEquals(6, objs[4].x);
+  assertEquals(7, objs[5].x);
+  assertEquals('proto', P.prototype.x);
+});
+
+test('Compound assignment operators', function() {
+  var x = 23;
+  assert((x %= 5) === 3);
+  assert((x <<= 4) === 48);
+  assert((x >>= 2) === 12);
+  assert((x |= 3) === 15);
+  assert((x &= 9) === 9);
+  assert((x ^= 12) === 5);
+  x = -8;
+  assert((x >>>= 28) === 15);
+
+  var a = [1, 2];
+  a[1] -= 5;
+  a[2] = a[2] | 4;
+  assert(a[1] === -3);
+  assert(a[2] === 4);
+
+  // The current value of a member may come from its prototype.
+  var P = function() {};
+  P.prototype.n = 10;
+  var p = new P();
+  p.n += 1;
+  assert(p.n === 11);
+  assert(P.prototype.n === 10);
+});
+
+test('Comma expressions', function() {
+  var x = 0, y;
+  y = (x++, x += 2, x * 2);
+  assert(x === 3);
+  assert(y === 6);
+});
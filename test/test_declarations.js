@@ -9,3 +9,24 @@ var b = 42, c = 'foobar', d;
 assert(b === 42);
 assert(c === 'foobar');
 assert(d === undefined);
+
+// Declarations are hoisted without running their initializers, and without
+// clobbering params or functions of the same name, on every call.
+var calls = 0;
+var count = function() { return ++calls; };
+var init = function() { var x = count(); return x; };
+init();
+init();
+assert(calls === 2);
+
+var param = function(p) { var p; return p; };
+assert(param(5) === 5);
+assert(param(6) === 6);
+
+var func = function() { var f; function f() {} return typeof f; };
+assert(func() === 'function');
+assert(func() === 'function');
+
+var later = function() { var before = v; var v = 1; return before; };
+assert(later() === undefined);
+assert(later() === undefined);
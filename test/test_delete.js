@@ -27,3 +27,12 @@ assertEquals(true, delete c);
 function d() {}
 assertEquals(false, delete d);
 assertEquals('function', typeof d);
+
+var p = { e: 1, f: 2, g: 3 };
+assertEquals(true, delete p.g);
+assertEquals(true, delete p.e);
+assertEquals(undefined, p.e);
+assertEquals(2, p.f);
+p.e = 4;
+assertEquals('f,e', Object.keys(p).join(','));
+assertEquals(4, p.e);
@@ -82,3 +82,30 @@ for (;;) {
   stop = true;
 }
 assert(stop);
+
+
+// break, continue and return from inside other statements
+
+var log = [];
+for (i = 0; i < 6; i++) {
+  if (i === 1) { continue; }
+  try {
+    if (i === 4) break;
+  } catch (e) {}
+  while (true) {
+    log.push(i);
+    break;
+  }
+}
+assert(log.join() === '0,2,3');
+
+var find = function(xs, x) {
+  for (var j = 0; j < xs.length; j++) {
+    for (var k in xs[j]) {
+      if (xs[j][k] === x) return j;
+    }
+  }
+  return -1;
+};
+assert(find([{a: 1}, {b: 2}, {c: 3}], 2) === 1);
+assert(find([{a: 1}], 2) === -1);
@@ -34,6 +34,20 @@ test('for-in with variable declaration on array', function() {
   assertEquals('8', i);
 });
 
+test('for-in with break', function() {
+  var Obj = function() { this.a = 1; this.b = 2; };
+  Obj.prototype.c = 3;
+  var visited = 0;
+
+  // Breaks out of the walk up the prototype chain too.
+  for (var x in new Obj()) {
+    visited++;
+    if (x === 'b') break;
+  }
+  assertEquals('b', x);
+  assertEquals(2, visited);
+});
+
 test('for-in with lhs expression on object', function() {
   var obj = { a: 1, b: 2, c: 3 };
 
@@ -63,3 +77,72 @@ test('for-in with crazy lhs member expression on object', function() {
   }
   assertEquals('c', x.y.z.key);
 });
+
+test('for-in deleting each property as it goes', function() {
+  var obj = { a: 1, b: 2, c: 3, d: 4 };
+  var seen = '';
+
+  for (var k in obj) {
+    seen += k;
+    delete obj[k];
+  }
+  assertEquals('abcd', seen);
+  assertEquals(0, Object.keys(obj).length);
+});
+
+var keys = function(obj) {
+  var seen = [];
+  for (var k in obj) seen.push(k);
+  return seen.join();
+};
+
+test('for-in visits prototype props once', function() {
+  var Point = function(x, y) { this.x = x; this.y = y; };
+  Point.prototype.y = 0;
+  Point.prototype.z = 0;
+
+  // Repeat, to go through the names cached for the shape.
+  for (var i = 0; i < 3; i++)
+    assertEquals('x,y,z', keys(new Point(1, 2)));
+
+  var base = { a: 1, b: 2 };
+  var derived = Object.create(base);
+  derived.b = 3;
+  derived.c = 4;
+  assertEquals('b,c,a', keys(derived));
+
+  // Same receiver shape, different prototype shapes.
+  var other = Object.create({ d: 1 });
+  other.b = 3;
+  other.c = 4;
+  assertEquals('b,c,d', keys(other));
+  assertEquals('b,c,a', keys(derived));
+});
+
+test('for-in skips names shadowed by non-enumerable props', function() {
+  var proto = { a: 1, b: 2 };
+  var obj = Object.create(proto);
+  Object.defineProperty(obj, 'a', { value: 3, enumerable: false });
+  assertEquals('b', keys(obj));
+
+  var arr = [1, 2];
+  arr.extra = true;
+  assertEquals('0,1,extra', keys(arr));
+});
+
+test('for-in notices attribute changes and deletions', function() {
+  var make = function() { var o = {}; o.p = 1; o.q = 2; o.r = 3; return o; };
+  assertEquals('p,q,r', keys(make()));
+
+  var obj = make();
+  Object.defineProperty(obj, 'q', { enumerable: false });
+  assertEquals('p,r', keys(obj));
+
+  obj = make();
+  var seen = '';
+  for (var k in obj) {
+    seen += k;
+    if (k === 'p') delete obj.r;
+  }
+  assertEquals('pq', seen);
+});
@@ -100,6 +100,10 @@ test('Function#apply(thisValue[, argsArray])', function() {
   assertEquals(99, getY.apply(thisValue));
   assertThis.apply(this, [this]);
   assertThis.apply(thisValue, [thisValue]);
+
+  // Arguments objects are array-like too.
+  var passThrough = function() { return add.apply(null, arguments); };
+  assertEquals(6, passThrough(1, 2, 3));
 });
 
 test('Function#bind(thisValue[, arg1[, arg2[, ...]]])', function() {
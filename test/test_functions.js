@@ -95,3 +95,41 @@ var recursive2 = function(x) {
 };
 
 assertEquals(10, recursive2(1));
+
+// Re-entrant calls, where a list is evaluated again before the first
+// evaluation of it is done
+
+var nest = function(depth, a, b) {
+  if (depth === 0) return [a, b];
+  return nest(depth - 1, nest(0, a, b).length + a, [depth, b][0]);
+};
+
+assertEquals('5,1', nest(2, 1, 5).join(','));
+
+var sum = function(n) {
+  var parts = [n, n > 0 ? sum(n - 1) : 0];
+  return parts[0] + parts[1];
+};
+
+assertEquals(55, sum(10));
+assertEquals(3, (function(a, b, c) { return arguments.length; })(1, sum(2), 3));
+
+// A named function expression sees its own name, read-only, but a
+// declaration's name is the binding it was declared with.
+
+function reassign() { reassign = 5; return typeof reassign; }
+assertEquals('number', reassign());
+assertEquals('number', typeof reassign);
+
+var lazy = function() {
+  lazy = function() { return 'cached'; };
+  return 'first';
+};
+assertEquals('first', lazy());
+assertEquals('cached', lazy());
+
+var fact = function f(n) { return n <= 1 ? 1 : n * f(n - 1); };
+assertEquals(120, fact(5));
+assertEquals('function', (function self() { self = 3; return typeof self; })());
+assertEquals(4, (function self(self) { return self; })(4));
+assertEquals(2, (function self() { var self = 2; return self; })());
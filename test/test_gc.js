@@ -39,3 +39,120 @@ assertEquals('Still here', f());
 assertEquals(12, x.a);
 assertEquals(99, y);
 assertEquals('99 Luftballons', z);
+
+
+// The heap grows to hold more live values than fit in a single arena.
+
+var many = [];
+while (many.length < 25000)
+  many.push({});
+assertEquals(25000, many.length);
+
+
+// Collections report how much memory they gave back.
+
+if (typeof gc !== 'undefined') {
+  many = null;
+  gc.run();
+  assert(gc.info().bytesReclaimed > 0);
+  assert(gc.info().totalBytesReclaimed >= gc.info().bytesReclaimed);
+}
+
+
+// Long chains of references don't exhaust the stack while marking.
+
+var chain = null;
+for (var k = 0; k < 100000; k++)
+  chain = {next: chain};
+if (typeof gc !== 'undefined')
+  gc.run();
+var length = 0;
+for (var link = chain; link !== null; link = link.next)
+  length++;
+assertEquals(100000, length);
+
+
+// Young values stored only in old objects survive minor collections.
+
+var holder = {items: []};
+if (typeof gc !== 'undefined')
+  gc.run();
+for (var n = 0; n < 30000; n++) {
+  holder.items.push({n: n});
+  holder.last = {n: n};
+}
+assertEquals(30000, holder.items.length);
+assertEquals(29999, holder.items[29999].n);
+assertEquals(12345, holder.items[12345].n);
+assertEquals(29999, holder.last.n);
+if (typeof gc !== 'undefined')
+  assert(gc.info().minorRuns > 0);
+
+
+// References moved between objects while a collection is in progress aren't
+// lost.
+
+var left = [], right = [];
+for (var i = 0; i < 20000; i++) {
+  var lp = {id: i}, lh = {};
+  lh.p = lp;
+  left.push(lh);
+  var rp = {id: i + 20000}, rh = {};
+  rh.p = rp;
+  right.push(rh);
+}
+for (var r = 0; r < 100000; r++) {
+  var k = (r * 7919) % 20000;
+  var h1 = left[k], h2 = right[(k * 31) % 20000];
+  var tmp = h1.p;
+  h1.p = h2.p;
+  h2.p = tmp;
+  tmp = null;
+}
+var sum = 0;
+for (var i = 0; i < 20000; i++)
+  sum += left[i].p.id + right[i].p.id;
+assertEquals(39999 * 40000 / 2, sum);
+
+
+// Garbage is reclaimed as allocation goes on, without an explicit run.
+
+if (typeof gc !== 'undefined') {
+  var reclaimed = gc.info().totalBytesReclaimed;
+  for (var n = 0; n < 50000; n++)
+    var garbage = {n: n};
+  assert(gc.info().totalBytesReclaimed > reclaimed);
+}
+
+
+// Temporaries that are only held by the interpreter partway through an
+// expression survive collections triggered while building it.
+
+var words = {};
+for (var n = 0; n < 30000; n++)
+  words['k' + (n % 100)] = 'v' + n + '-' + (n + 1);
+assertEquals('v29999-30000', words.k99);
+assertEquals('v29900-29901', words.k0);
+var sorted = [];
+for (var n = 0; n < 300; n++)
+  sorted.push('s' + ((n * 37) % 300));
+sorted.sort(function(a, b) { return ('' + a).length - ('' + b).length; });
+assertEquals(300, sorted.length);
+assertEquals(2, sorted[0].length);
+assertEquals(4, sorted[299].length);
+
+
+// Cells freed by one collection are reused for objects of another kind
+// without any of their old contents showing through.
+
+var wrappers = [];
+for (var i = 0; i < 40000; i++)
+  wrappers.push(new String('w' + i));
+wrappers = null;
+if (typeof gc !== 'undefined') gc.run();
+var regexps = [];
+for (var i = 0; i < 40000; i++)
+  regexps.push(/ab+c/);
+if (typeof gc !== 'undefined') gc.run();
+assertEquals(40000, regexps.length);
+assertEquals('ab+c', regexps[39999].source);
@@ -26,3 +26,42 @@ assert(o['e'] === 4);
 assert(o.e === 4);
 assert(o['---;?"'] === 1);
 assert(o[''] === 5);
+
+
+// -----------------------------------------------------------------------------
+// Many properties
+// -----------------------------------------------------------------------------
+
+var many = {};
+for (var i = 0; i < 100; i++)
+  many['p' + i] = i;
+assertEquals(100, Object.keys(many).length);
+assertEquals('p0', Object.keys(many)[0]);
+assertEquals('p99', Object.keys(many)[99]);
+assertEquals(0, many.p0);
+assertEquals(57, many.p57);
+assertEquals(undefined, many.p100);
+
+var objs = [];
+for (var i = 0; i < 200; i++) {
+  var obj = {};
+  obj['k' + i] = i;
+  obj.shared = -i;
+  objs.push(obj);
+}
+assertEquals(150, objs[150].k150);
+assertEquals(-150, objs[150].shared);
+assertEquals(undefined, objs[150].k149);
+
+// Names come and go as properties are added and deleted.
+var churn = {};
+for (var round = 0; round < 3; round++) {
+  for (var i = 0; i < 100; i++)
+    churn['c' + round + '_' + i] = i;
+  for (var i = 0; i < 100; i++)
+    delete churn['c' + round + '_' + i];
+}
+assertEquals(0, Object.keys(churn).length);
+churn.c0_5 = 'again';
+assertEquals('again', churn['c0_' + 5]);
+assertEquals(undefined, churn.c1_5);
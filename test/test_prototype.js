@@ -5,3 +5,45 @@ var assert = console.assert;
 
 var x = {a: 42, b: [1,2,3]};
 assert(x.toString() === '[object Object]');
+
+// Lookups from the same expression see objects of different layouts, and
+// changes to the objects and their prototypes.
+var P = {v: 'proto'};
+var C = function() {};
+C.prototype = P;
+var getV = function(o) { return o.v; };
+var objs = [{v: 1}, {a: 0, v: 2}, new C(), {b: 1, c: 2, v: 3}, {d: 1, v: 4}];
+var seen = [];
+for (var r = 0; r < 2; r++)
+  for (var i = 0; i < objs.length; i++)
+    seen.push(getV(objs[i]));
+assert(seen.join(',') === '1,2,proto,3,4,1,2,proto,3,4');
+var c = new C();
+assert(getV(c) === 'proto');
+P.v = 'changed';
+assert(getV(c) === 'changed');
+c.v = 'own';
+assert(getV(c) === 'own');
+delete c.v;
+assert(getV(c) === 'changed');
+
+// Computed lookups, and the runtime's own, go through the shared method cache.
+var D = function() {};
+D.prototype = new C();
+var d = new D(), key = 'v';
+assert(d[key] === 'changed');
+P.v = 'again';
+assert(d[key] === 'again');
+D.prototype.v = 'nearer';
+assert(d[key] === 'nearer');
+delete D.prototype.v;
+assert(d[key] === 'again');
+d.v = 'own';
+assert(d[key] === 'own');
+
+P.valueOf = function() { return 5; };
+assert(new C() * 2 === 10);
+P.valueOf = function() { return 6; };
+assert(new C() * 2 === 12);
+delete P.valueOf;
+assert(isNaN(new C() * 2));
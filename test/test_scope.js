@@ -76,3 +76,85 @@ function b() {
 }
 b();
 assert(a === 1);
+
+// A name that turns up in a nearer scope partway through shadows the outer
+// one from then on, even for lookups that already ran.
+var s = 'outer';
+function shadow() {
+  var seen = [];
+  for (var i = 0; i < 3; i++) {
+    seen.push(s);
+    try { throw 'inner'; } catch (s) {}
+  }
+  return seen.join(',');
+}
+assert(shadow() === 'outer,inner,inner');
+
+
+// ------------------------------------------------------------------
+// Locals
+// ------------------------------------------------------------------
+
+// Every call declares the function's vars afresh, rather than assigning to
+// whatever the caller has by the same name.
+var count = 0;
+function local() {
+  var count;
+  count = (count || 0) + 1;
+  return count;
+}
+assert(local() === 1);
+assert(local() === 1);
+assert(count === 0);
+
+// Params are matched by position with args, and the last of repeated params
+// wins.
+function params(a, b, a) {
+  return a;
+}
+assert(params(1, 2, 3) === 3);
+assert(params(1, 2) === undefined);
+
+// Named function expressions see themselves, unless something shadows them.
+var fact = function f(n) { return n < 2 ? 1 : n * f(n - 1); };
+assert(fact(5) === 120);
+var shadowed = function g(g) { return g; };
+assert(shadowed(7) === 7);
+
+// Code run by eval sees the locals of the function calling it.
+function evaluated(x) {
+  var y = 2;
+  eval('var z = x + y + arguments.length;');
+  return z;
+}
+assert(evaluated(1) === 4);
+assert(evaluated(1, 1) === 5);
+
+// Only functions that mention `arguments`, or eval, get an arguments object,
+// wherever in their body they mention it. Code run by an aliased eval isn't
+// the caller's, as in the global scope.
+function nested(a) {
+  var o = {first: arguments[0]};
+  try { throw arguments.length; } catch (e) { o.total = e; }
+  return o.first + o.total;
+}
+assert(nested(5, 6) === 7);
+var indirect = eval;
+function unmentioned(a) {
+  return indirect('typeof arguments;');
+}
+assert(unmentioned(1) === 'undefined');
+
+// Unlike in the spec, scopes are dynamic here: a function sees the scope of
+// its caller. A caller's vars are there, undefined, from the start of every
+// call, before their declarations run.
+var pending = 'outer';
+function peek() { return typeof pending; }
+function early() {
+  var seen = peek();
+  var pending = 'inner';
+  return seen;
+}
+assert(early() === 'undefined');
+assert(early() === 'undefined');
+assert(pending === 'outer');
@@ -111,6 +111,11 @@ test('String#lastIndexOf(searchValue[, fromIndex])', function() {
   assertEquals(-1, s.lastIndexOf('notpresent'));
   assertEquals(-1, s.lastIndexOf());
   assertEquals(10, s.lastIndexOf('test', 'not a number'));
+  assertEquals(10, s.lastIndexOf('test', NaN));
+  assertEquals(s.length, s.lastIndexOf(''));
+  assertEquals(2,  s.lastIndexOf('', 2));
+  assertEquals(0,  'abab'.lastIndexOf('ab', 1));
+  assertEquals(-1, 'ab'.lastIndexOf('abc'));
 });
 
 test('String#localeCompare(compareString)', function() {
@@ -174,6 +179,10 @@ test('String#search(regexp)', function() {
 
   assertEquals(1,  'baz'.search('a'));
   assertEquals(-1, 'baz'.search('k'));
+
+  // Without a pattern there are no options to scan for.
+  assertEquals('number', typeof 'baz'.search());
+  assert(Array.isArray('baz'.match()));
 });
 
 test('String#slice(beginSlice[, endSlice])', function() {
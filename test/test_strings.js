@@ -18,6 +18,10 @@ assert(s1[11] === '!');
 assert(s1[12] === undefined);
 assert(s1[1000] === undefined);
 
+var last = s1.length - 1;
+assert(s1[last] === '!');
+assert(s1[last + 1] === undefined);
+
 // Direct operations on strings
 
 assert('abc'[1] === 'b');
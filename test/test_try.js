@@ -97,6 +97,18 @@ test('try statement', function() {
     });
   });
 
+  test('repeatedly caught after unwinding calls', function() {
+    var caught = 0;
+    for (var i = 0; i < 100; i++) {
+      try {
+        nestedThrow();
+      } catch (e) {
+        caught++;
+      }
+    }
+    assertEquals(100, caught);
+  });
+
   test('finally runs last', function() {
     var final_ran = false;
 
@@ -126,4 +138,27 @@ test('try statement', function() {
 
     console.assert(final_ran);
   });
+
+  test('return from try and finally', function() {
+    var f = function() {
+      try {
+        return 1;
+      } finally {
+        final_ran = true;
+      }
+      return 2;
+    };
+    var g = function() {
+      try {
+        return 1;
+      } finally {
+        return 2;
+      }
+    };
+
+    final_ran = false;
+    assertEquals(1, f());
+    console.assert(final_ran);
+    assertEquals(2, g());
+  });
 });
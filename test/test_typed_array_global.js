@@ -0,0 +1,265 @@
+// test_typed_array_global.js
+// --------------------------
+
+(this.load || require)((this.load ? 'test' : '.') + '/tools/assertions.js');
+
+var throwsRangeError = function(f) {
+  try {
+    f();
+  } catch (e) {
+    return e.name === 'RangeError';
+  }
+  return false;
+};
+
+
+// ----------------------------------------------------------------------------
+// ArrayBuffer
+// ----------------------------------------------------------------------------
+
+assert(ArrayBuffer);
+assert(typeof ArrayBuffer === 'function');
+
+test('ArrayBuffer', function() {
+  var buf = new ArrayBuffer(8);
+  assertEquals(8, buf.byteLength);
+  assertEquals(0, new ArrayBuffer(0).byteLength);
+  assertEquals(3, buf.slice(2, 5).byteLength);
+  assertEquals(2, buf.slice(-2).byteLength);
+  assert(throwsRangeError(function() { new ArrayBuffer(-1); }));
+
+  assert(ArrayBuffer.isView(new Uint8Array(buf)));
+  assert(ArrayBuffer.isView(new DataView(buf)));
+  assert(!ArrayBuffer.isView(buf));
+  assert(!ArrayBuffer.isView([]));
+
+  var bytes = new Uint8Array(buf);
+  bytes[3] = 7;
+  var copy = new Uint8Array(buf.slice(2, 5));
+  assertArrayEquals([0, 7, 0], copy);
+  copy[1] = 9;
+  assertEquals(7, bytes[3]);
+});
+
+
+// ----------------------------------------------------------------------------
+// Typed Arrays
+// ----------------------------------------------------------------------------
+
+test('Constructors', function() {
+  assertEquals(1, Int8Array.BYTES_PER_ELEMENT);
+  assertEquals(1, Uint8ClampedArray.BYTES_PER_ELEMENT);
+  assertEquals(2, Uint16Array.BYTES_PER_ELEMENT);
+  assertEquals(4, Float32Array.BYTES_PER_ELEMENT);
+  assertEquals(8, Float64Array.prototype.BYTES_PER_ELEMENT);
+
+  var a = new Float64Array(3);
+  assertEquals(3, a.length);
+  assertEquals(24, a.byteLength);
+  assertEquals(0, a.byteOffset);
+  assertEquals(24, a.buffer.byteLength);
+  assertArrayEquals([0, 0, 0], a);
+  assert(a instanceof Float64Array);
+  assert(!Array.isArray(a));
+  assert(throwsRangeError(function() { new Int32Array(-1); }));
+
+  assertArrayEquals([1, 2, 3], new Int16Array([1, 2, 3]));
+  var arrayLike = {length: 2};
+  arrayLike[0] = 1;
+  arrayLike[1] = 2;
+  assertArrayEquals([1, 2], new Int16Array(arrayLike));
+  assertArrayEquals([1, 0], new Uint8Array(new Float32Array([1.5, -0.5])));
+
+  var buf = new ArrayBuffer(16);
+  var view = new Int32Array(buf, 4, 2);
+  assertEquals(2, view.length);
+  assertEquals(4, view.byteOffset);
+  assertEquals(buf, view.buffer);
+  assertEquals(3, new Int32Array(buf, 4).length);
+  assert(throwsRangeError(function() { new Int32Array(buf, 2); }));
+  assert(throwsRangeError(function() { new Int32Array(buf, 8, 3); }));
+  assert(throwsRangeError(function() { new Float64Array(new ArrayBuffer(12)); }));
+});
+
+test('Element conversion', function() {
+  var i8 = new Int8Array(3);
+  i8[0] = 127;
+  i8[1] = 128;
+  i8[2] = -129;
+  assertArrayEquals([127, -128, 127], i8);
+
+  var u8 = new Uint8Array(3);
+  u8[0] = 256;
+  u8[1] = -1;
+  u8[2] = 3.9;
+  assertArrayEquals([0, 255, 3], u8);
+
+  var c = new Uint8ClampedArray(5);
+  c[0] = 300;
+  c[1] = -5;
+  c[2] = 1.5;
+  c[3] = 2.5;
+  c[4] = NaN;
+  assertArrayEquals([255, 0, 2, 2, 0], c);
+
+  var u32 = new Uint32Array(2);
+  u32[0] = -1;
+  u32[1] = '12';
+  assertArrayEquals([4294967295, 12], u32);
+
+  var f32 = new Float32Array(1);
+  f32[0] = 0.1;
+  assert(f32[0] !== 0.1);
+  assertClose(0.1, f32[0], 1e-7);
+
+  var f64 = new Float64Array(2);
+  f64[0] = 0.1;
+  f64[1] = 'x';
+  assertEquals(0.1, f64[0]);
+  assertNaN(f64[1]);
+});
+
+test('Indices', function() {
+  var a = new Int32Array(4);
+  var i;
+  for (i = 0; i < a.length; i++)
+    a[i] = i * i;
+  assertArrayEquals([0, 1, 4, 9], a);
+
+  a[1] += 10;
+  a[2]++;
+  assertArrayEquals([0, 11, 5, 9], a);
+
+  // Out of bounds elements are neither stored nor found.
+  a[4] = 1;
+  assertEquals(4, a.length);
+  assertEquals(undefined, a[4]);
+
+  assert(2 in a);
+  assert(!(4 in a));
+  assert(!delete a[0]);
+  assertEquals(0, a[0]);
+
+  var keys = [];
+  for (var k in a) keys.push(k);
+  assertArrayEquals(['0', '1', '2', '3'], keys);
+  assertArrayEquals(['0', '1', '2', '3'], Object.keys(a));
+});
+
+test('Shared buffers', function() {
+  var buf = new ArrayBuffer(8);
+  var bytes = new Uint8Array(buf);
+  var words = new Uint16Array(buf);
+  var floats = new Float64Array(buf);
+
+  words[0] = 0x0102;
+  assert(bytes[0] + bytes[1] === 3);
+  floats[0] = 1;
+  assertEquals(63, bytes[7] | bytes[0]);
+});
+
+test('TypedArray.prototype.fill(value[, begin[, end]])', function() {
+  var a = new Int8Array(5);
+  assertEquals(a, a.fill(3));
+  assertArrayEquals([3, 3, 3, 3, 3], a);
+  assertArrayEquals([3, 1, 1, 3, 3], a.fill(1, 1, 3));
+  assertArrayEquals([3, 1, 1, 2, 2], a.fill(2, -2));
+});
+
+test('TypedArray.prototype.set(array[, offset])', function() {
+  var a = new Uint8Array(5);
+  a.set([1, 2]);
+  a.set(new Float32Array([3.5, 4]), 3);
+  assertArrayEquals([1, 2, 0, 3, 4], a);
+  assert(throwsRangeError(function() { a.set([1, 2], 4); }));
+
+  // Overlapping views of one buffer
+  a.set(a.subarray(0, 3), 2);
+  assertArrayEquals([1, 2, 1, 2, 0], a);
+
+  var buf = new ArrayBuffer(8);
+  var bytes = new Uint8Array(buf);
+  var shorts = new Uint16Array(buf, 0, 2);
+  bytes.set([1, 2, 3, 4]);
+  var little = shorts[0] === 0x0201;
+  bytes.set(shorts, 1);
+  assertArrayEquals(little ? [1, 1, 3, 4] : [1, 2, 4, 4], bytes.subarray(0, 4));
+});
+
+test('TypedArray.prototype.slice([begin[, end]])', function() {
+  var a = new Int16Array([1, 2, 3, 4]);
+  var s = a.slice(1, -1);
+  assert(s instanceof Int16Array);
+  assertArrayEquals([2, 3], s);
+  s[0] = 9;
+  assertEquals(2, a[1]);
+  assertArrayEquals([], a.slice(3, 1));
+});
+
+test('TypedArray.prototype.subarray([begin[, end]])', function() {
+  var a = new Int16Array([1, 2, 3, 4]);
+  var s = a.subarray(1, 3);
+  assert(s instanceof Int16Array);
+  assertArrayEquals([2, 3], s);
+  assertEquals(2, s.byteOffset);
+  assertEquals(a.buffer, s.buffer);
+  s[0] = 9;
+  assertEquals(9, a[1]);
+  assertArrayEquals([3, 4], a.subarray(-2));
+});
+
+test('Array methods', function() {
+  assertEquals('1,2,3', new Int8Array([1, 2, 3]).join());
+  assertEquals('1-2-3', new Int8Array([1, 2, 3]).join('-'));
+  assertEquals('1,2,3', new Int8Array([1, 2, 3]).toString());
+
+  var a = new Float64Array([1, 2.5, 3]);
+  assertEquals(1, a.indexOf(2.5));
+  assertEquals(-1, a.lastIndexOf(4));
+  assertEquals(6.5, a.reduce(function(x, y) { return x + y; }));
+  assert(a.every(function(x) { return x > 0; }));
+  assert(!a.some(function(x) { return x > 3; }));
+
+  var sum = 0;
+  a.forEach(function(x, i) { sum += x * i; });
+  assertEquals(8.5, sum);
+});
+
+
+// ----------------------------------------------------------------------------
+// DataView
+// ----------------------------------------------------------------------------
+
+test('DataView', function() {
+  var buf = new ArrayBuffer(8);
+  var view = new DataView(buf, 2);
+  assertEquals(6, view.byteLength);
+  assertEquals(2, view.byteOffset);
+  assertEquals(buf, view.buffer);
+
+  view.setUint16(0, 0x0102);
+  assertEquals(0x0102, view.getUint16(0));
+  assertEquals(0x0201, view.getUint16(0, true));
+  assertEquals(1, view.getUint8(0));
+  assertEquals(2, view.getUint8(1));
+  assertEquals(1, new Uint8Array(buf)[2]);
+
+  view.setInt32(0, -2, true);
+  assertEquals(-2, view.getInt32(0, true));
+  assertEquals(4294967294, view.getUint32(0, true));
+  assertEquals(-2, view.getInt8(0));
+  assertEquals(255, view.getUint8(3));
+
+  view.setFloat32(2, 1.5);
+  assertEquals(1.5, view.getFloat32(2));
+  assertEquals(0x3f, view.getUint8(2));
+
+  var whole = new DataView(buf);
+  whole.setFloat64(0, Math.PI, true);
+  assertEquals(Math.PI, whole.getFloat64(0, true));
+  assertEquals(Math.PI, new Float64Array(buf)[0]);
+
+  assert(throwsRangeError(function() { view.getUint32(4); }));
+  assert(throwsRangeError(function() { view.setInt16(5, 1); }));
+  assert(throwsRangeError(function() { new DataView(buf, 9); }));
+});
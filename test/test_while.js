@@ -30,3 +30,40 @@ while (i < 10) {
 
 assert(i === 10);
 assert(j === 0);
+
+
+// Calls in the loop body don't end the loop
+
+var noop = function() { return 1; };
+var k = 0;
+while (k < 3) {
+  k++;
+  noop();
+}
+assert(k === 3);
+
+
+// Returning from within a loop
+
+var firstOver = function(n) {
+  var m = 0;
+  while (true) {
+    if (m > n) return m;
+    m++;
+  }
+};
+assert(firstOver(4) === 5);
+
+
+// Continue from a nested block
+
+var evens = 0;
+k = 0;
+while (k < 10) {
+  k++;
+  if (k % 2) {
+    continue;
+  }
+  evens++;
+}
+assert(evens === 5);